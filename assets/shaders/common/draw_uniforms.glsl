@@ -0,0 +1,25 @@
+#ifndef DRAW_UNIFORMS_GLSL
+#define DRAW_UNIFORMS_GLSL
+
+// Bound per draw. Packed vertex layouts store positions and texcoords
+// normalized to the model's bounds, offset and scale map them back; full
+// layout draws get offset 0 and scale 1.
+layout (std140) uniform DrawUniforms {
+    mat4 model;
+    vec4 positionOffset;
+    vec4 positionScale;
+    // Offset in xy, scale in zw
+    vec4 texCoordTransform;
+};
+
+vec3 DequantizePosition(vec3 position)
+{
+    return positionOffset.xyz + position * positionScale.xyz;
+}
+
+vec2 DequantizeTexCoords(vec2 texCoords)
+{
+    return texCoordTransform.xy + texCoords * texCoordTransform.zw;
+}
+
+#endif // DRAW_UNIFORMS_GLSL
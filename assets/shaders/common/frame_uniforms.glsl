@@ -0,0 +1,20 @@
+#ifndef FRAME_UNIFORMS_GLSL
+#define FRAME_UNIFORMS_GLSL
+
+struct DirLight {
+    vec3 direction;
+
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+};
+
+// Shared by all programs, bound once per frame
+layout (std140) uniform FrameUniforms {
+    mat4 view;
+    mat4 projection;
+    vec3 viewPos;
+    DirLight dirLight;
+};
+
+#endif // FRAME_UNIFORMS_GLSL
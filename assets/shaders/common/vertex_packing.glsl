@@ -0,0 +1,32 @@
+#ifndef VERTEX_PACKING_GLSL
+#define VERTEX_PACKING_GLSL
+
+// Inverse of OctahedralEncode in packing.h, folded around the y axis
+vec3 DecodeOctahedral(vec2 p)
+{
+    vec3 n = vec3(p.x, 1.0 - abs(p.x) - abs(p.y), p.y);
+    float t = max(-n.y, 0.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.z += n.z >= 0.0 ? -t : t;
+    return normalize(n);
+}
+
+// Tangent frame of the packed vertex layouts, see PackTangentFrame
+void DecodeTangentFrame(uint packed, out vec3 normal, out vec3 tangent, out vec3 bitangent)
+{
+    vec2 octahedral = vec2(int(packed << 22u) >> 22, int(packed << 12u) >> 22) / 511.0;
+    normal = DecodeOctahedral(max(octahedral, vec2(-1.0)));
+
+    // Same basis as TangentBasis in vertex_layouts.cpp
+    float s = normal.z >= 0.0 ? 1.0 : -1.0;
+    float a = -1.0 / (s + normal.z);
+    float b = normal.x * normal.y * a;
+    vec3 b1 = vec3(1.0 + s * normal.x * normal.x * a, s * b, -s * normal.x);
+    vec3 b2 = vec3(b, s + normal.y * normal.y * a, -normal.y);
+
+    float angle = float((packed >> 20u) & 0x7FFu) / 2047.0 * 6.28318531 - 3.14159265;
+    tangent = b1 * cos(angle) + b2 * sin(angle);
+    bitangent = cross(normal, tangent) * ((packed >> 31u) != 0u ? -1.0 : 1.0);
+}
+
+#endif // VERTEX_PACKING_GLSL
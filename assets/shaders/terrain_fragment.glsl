@@ -6,16 +6,8 @@ layout (location = 0) out vec4 FragColor;
 in vec3 FragPos;
 in vec3 Normal;
 
-struct DirLight {
-    vec3 direction;
-	
-    vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;
-};
+#include "common/frame_uniforms.glsl"
 
-uniform vec3 viewPos;
-uniform DirLight dirLight;
 uniform float maxHeight;
 uniform float minHeight;
 
@@ -1,24 +1,67 @@
 // Vertex Shader
 #version 410 core
 
-layout (location = 0) in vec3 aPos;
-layout (location = 1) in vec3 aNormal;
-layout (location = 2) in vec3 aOffset;
-
 out vec3 FragPos;
 out vec3 Normal;
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+#include "common/frame_uniforms.glsl"
+#include "common/draw_uniforms.glsl"
+#include "common/vertex_packing.glsl"
 
 uniform float scale;
 
+// Packed chunk vertices: unorm16 height, snorm8 octahedral normal
+uniform usamplerBuffer heightmap;
+uniform float heightScale;
+uniform int chunkWidth;
+uniform vec2 chunkOffset;
+
+// LOD node, drawn with a patch of patchWidth x patchWidth vertices
+uniform int patchWidth;
+uniform vec2 nodeOrigin;
+uniform float nodeStep;
+uniform vec2 morphConstants;
+
+void FetchVertex(vec2 gridPos, out float height, out vec3 normal)
+{
+    ivec2 texel = ivec2(gridPos);
+    uint packed = texelFetch(heightmap, texel.x + texel.y * chunkWidth).r;
+
+    height = float(packed & 0xFFFFu) / 65535.0 * heightScale;
+    vec2 octahedral = vec2(int(packed << 8u) >> 24, int(packed) >> 24) / 127.0;
+    normal = DecodeOctahedral(max(octahedral, vec2(-1.0)));
+}
+
 void main()
-{   
-    FragPos = vec3(model * vec4(aPos + aOffset, 1.0));
+{
+    vec2 patchPos = vec2(gl_VertexID % patchWidth, gl_VertexID / patchWidth);
+    vec2 gridPos = nodeOrigin + patchPos * nodeStep;
+
+    float height;
+    vec3 normal;
+    FetchVertex(gridPos, height, normal);
+
+    // Odd patch vertices slide onto their even neighbour towards the end of the
+    // node's range, which turns the patch into the next coarser level's grid
+    vec3 worldPos = vec3(chunkOffset.x + gridPos.x, height, chunkOffset.y + gridPos.y);
+    float morph = 1.0 - clamp(morphConstants.x - distance(worldPos, viewPos) * morphConstants.y, 0.0, 1.0);
+
+    vec2 morphOffset = mod(patchPos, 2.0) * nodeStep;
+    if(morph > 0.0 && (morphOffset.x > 0.0 || morphOffset.y > 0.0)) {
+        float coarseHeight;
+        vec3 coarseNormal;
+        FetchVertex(gridPos - morphOffset, coarseHeight, coarseNormal);
+
+        gridPos -= morphOffset * morph;
+        height = mix(height, coarseHeight, morph);
+        normal = normalize(mix(normal, coarseNormal, morph));
+    }
+
+    vec3 position = vec3(chunkOffset.x + gridPos.x, height, chunkOffset.y + gridPos.y);
+
+    FragPos = vec3(model * vec4(position, 1.0));
     FragPos.y *= scale;
-    gl_Position = projection * view * model * vec4(FragPos, 1.0);
+    gl_Position = projection * view * vec4(FragPos, 1.0);
     gl_Position *= scale;
-    Normal = aNormal;
-}
\ No newline at end of file
+    Normal = normal;
+}
@@ -3,14 +3,6 @@
 
 out vec4 FragColor;
 
-struct DirLight {
-    vec3 direction;
-	
-    vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;
-};
-
 struct PointLight {
     vec3 position;
     
@@ -26,11 +18,12 @@ struct PointLight {
 in vec3 FragPos;
 in vec3 Normal;
 in vec2 TexCoords;
+in vec4 Tint;
 
 uniform sampler2D texture_diffuse1;
 uniform sampler2D texture_normal;
-uniform vec3 viewPos;
-uniform DirLight dirLight;
+
+#include "common/frame_uniforms.glsl"
 
 // function prototypes
 vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir);
@@ -43,7 +36,7 @@ void main()
     
     vec3 result = CalcDirLight(dirLight, norm, viewDir);
 
-    FragColor = texture(texture_diffuse1, TexCoords) * vec4(result, 1.0);
+    FragColor = texture(texture_diffuse1, TexCoords) * vec4(result, 1.0) * Tint;
 }
 
 // calculates the color when using a directional light.
@@ -0,0 +1,23 @@
+#version 410 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aTexCoords;
+// Per instance, see InstanceData
+layout (location = 7) in mat4 aInstanceModel;
+layout (location = 11) in vec4 aInstanceTint;
+
+out vec3 FragPos;
+out vec2 TexCoords;
+out vec4 Tint;
+
+#include "common/frame_uniforms.glsl"
+#include "common/draw_uniforms.glsl"
+
+void main()
+{
+    // The draw block's model matrix is unused, instances bring their own
+    FragPos = vec3(aInstanceModel * vec4(DequantizePosition(aPos), 1.0));
+    TexCoords = DequantizeTexCoords(aTexCoords);
+    Tint = aInstanceTint;
+    gl_Position = projection * view * vec4(FragPos, 1.0);
+}
\ No newline at end of file
@@ -5,14 +5,15 @@ layout (location = 2) in vec2 aTexCoords;
 
 out vec3 FragPos;
 out vec2 TexCoords;
+out vec4 Tint;
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+#include "common/frame_uniforms.glsl"
+#include "common/draw_uniforms.glsl"
 
 void main()
 {
-    FragPos = vec3(model * vec4(aPos, 1.0));
-    TexCoords = aTexCoords;    
-    gl_Position = projection * view * model * vec4(aPos, 1.0);
+    FragPos = vec3(model * vec4(DequantizePosition(aPos), 1.0));
+    TexCoords = DequantizeTexCoords(aTexCoords);
+    Tint = vec4(1.0);
+    gl_Position = projection * view * vec4(FragPos, 1.0);
 }
\ No newline at end of file
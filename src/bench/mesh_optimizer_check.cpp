@@ -0,0 +1,82 @@
+// Checks the mesh optimizer passes on shuffled spheres: the triangles, their
+// winding included, have to survive every pass, and the vertex cache pass has
+// to reach a cache miss ratio close to the best a mesh can do. Exits with 1
+// on the first sphere that fails.
+
+#include "shuffled_sphere.h"
+#include "../rendering/mesh_optimizer.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+namespace {
+
+// The spheres steel_bench runs by default
+constexpr int kSphereSegments[] = {32, 128};
+// Tipsify reaches about 0.6 on these spheres, shuffled they are near 3
+constexpr float kMaxVertexCacheAcmr = 0.75f;
+
+// Triangles by their original vertices, rotated to start at the lowest one so winding is kept
+std::vector<std::array<uint32_t, 3>> CanonicalTriangles(const std::vector<uint32_t> &indices, const std::vector<uint32_t> &original_vertex)
+{
+    std::vector<std::array<uint32_t, 3>> triangles;
+    for(size_t i = 0; i < indices.size(); i += 3) {
+        std::array<uint32_t, 3> triangle {original_vertex[indices[i]], original_vertex[indices[i + 1]], original_vertex[indices[i + 2]]};
+        std::rotate(triangle.begin(), std::min_element(triangle.begin(), triangle.end()), triangle.end());
+        triangles.push_back(triangle);
+    }
+    std::sort(triangles.begin(), triangles.end());
+    return triangles;
+}
+
+bool CheckSphere(int segments)
+{
+    SphereMesh sphere = MakeShuffledSphere(segments);
+    size_t vertex_count = sphere.positions.size();
+
+    std::vector<uint32_t> indices = sphere.indices;
+    std::vector<uint32_t> clusters = OptimizeVertexCache(indices.data(), indices.size(), vertex_count);
+    float cache_acmr = AverageCacheMissRatio(indices.data(), indices.size(), vertex_count);
+
+    OptimizeOverdraw(indices.data(), indices.size(), clusters, sphere.positions.data(), sizeof(glm::vec3), vertex_count);
+    float overdraw_acmr = AverageCacheMissRatio(indices.data(), indices.size(), vertex_count);
+
+    std::vector<uint32_t> remap = OptimizeVertexFetch(indices.data(), indices.size(), vertex_count);
+
+    std::vector<uint32_t> identity(vertex_count);
+    std::vector<uint32_t> original_vertex(vertex_count);
+    for(size_t i = 0; i < vertex_count; i++) {
+        identity[i] = static_cast<uint32_t>(i);
+        if(remap[i] != UINT32_MAX) {
+            original_vertex[remap[i]] = static_cast<uint32_t>(i);
+        }
+    }
+
+    std::printf("sphere %d segments: ACMR vertex cache %.3f, overdraw %.3f\n", segments, cache_acmr, overdraw_acmr);
+
+    if(CanonicalTriangles(sphere.indices, identity) != CanonicalTriangles(indices, original_vertex)) {
+        std::fprintf(stderr, "Mesh optimizer changed the triangles of the %d segment sphere\n", segments);
+        return false;
+    }
+    if(cache_acmr > kMaxVertexCacheAcmr) {
+        std::fprintf(stderr, "Vertex cache ACMR %.3f of the %d segment sphere is above %.3f\n",
+                     cache_acmr, segments, kMaxVertexCacheAcmr);
+        return false;
+    }
+    return true;
+}
+
+} // namespace
+
+int main()
+{
+    for(int segments : kSphereSegments) {
+        if(!CheckSphere(segments)) {
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,42 @@
+#include "shuffled_sphere.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <random>
+
+SphereMesh MakeShuffledSphere(int segments)
+{
+    int rings = segments;
+    int sectors = 2 * segments;
+    const float pi = 3.14159265358979f;
+
+    SphereMesh sphere;
+    for(int ring = 0; ring <= rings; ring++) {
+        float theta = pi * ring / rings;
+        for(int sector = 0; sector <= sectors; sector++) {
+            float phi = 2.f * pi * sector / sectors;
+            sphere.positions.push_back(glm::vec3(std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi)));
+        }
+    }
+
+    std::vector<std::array<uint32_t, 3>> triangles;
+    for(int ring = 0; ring < rings; ring++) {
+        for(int sector = 0; sector < sectors; sector++) {
+            uint32_t a = ring * (sectors + 1) + sector;
+            uint32_t b = a + sectors + 1;
+            if(ring != 0) {
+                triangles.push_back({a, b, a + 1});
+            }
+            if(ring != rings - 1) {
+                triangles.push_back({a + 1, b, b + 1});
+            }
+        }
+    }
+
+    std::shuffle(triangles.begin(), triangles.end(), std::mt19937(1));
+    for(const std::array<uint32_t, 3> &triangle : triangles) {
+        sphere.indices.insert(sphere.indices.end(), triangle.begin(), triangle.end());
+    }
+    return sphere;
+}
@@ -0,0 +1,18 @@
+#ifndef SHUFFLED_SPHERE_H
+#define SHUFFLED_SPHERE_H
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+// Test mesh of the mesh optimizer bench and check
+struct SphereMesh {
+    std::vector<glm::vec3> positions;
+    std::vector<uint32_t> indices;
+};
+
+// UV sphere with its triangles in a fixed random order, the worst order an exporter can hand over
+SphereMesh MakeShuffledSphere(int segments);
+
+#endif // SHUFFLED_SPHERE_H
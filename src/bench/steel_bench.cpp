@@ -0,0 +1,459 @@
+// Headless benchmark of the CPU side of terrain generation and mesh import.
+// Never creates a GL context, so it runs on machines without a GPU.
+//
+// steel_bench [--chunk-sizes=65,129,257] [--octaves=4,8] [--iterations=20] [--chunks=64]
+//             [--diamond-square-details=9,11] [--sphere-segments=32,128]
+
+#include "shuffled_sphere.h"
+#include "../math/batched_noise.h"
+#include "../rendering/mesh_optimizer.h"
+#include "../terrain/chunk_mesh_builder.h"
+#include "../terrain/diamond_square.h"
+#include "../terrain/terrain_lod.h"
+#include "../utils/thread_pool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#endif
+
+#include "../math/noise.h"
+
+namespace {
+std::atomic<uint64_t> allocation_count {0};
+std::atomic<uint64_t> allocated_bytes {0};
+}
+
+void *operator new(size_t size)
+{
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+    allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+
+    if(void *pointer = std::malloc(size ? size : 1)) {
+        return pointer;
+    }
+    throw std::bad_alloc();
+}
+
+void *operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void *pointer) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete[](void *pointer) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete(void *pointer, size_t) noexcept
+{
+    operator delete(pointer);
+}
+
+void operator delete[](void *pointer, size_t) noexcept
+{
+    operator delete(pointer);
+}
+
+namespace {
+
+struct BenchOptions {
+    std::vector<int> chunk_sizes {65, 129, 257};
+    std::vector<int> octaves {4, 8};
+    int iterations = 20;
+    // Chunks built on the thread pool for the throughput measurement
+    int chunks = 64;
+    // Diamond-square maps of 2^detail + 1 samples per side
+    std::vector<int> diamond_square_details {9, 11};
+    // Mesh optimizer runs on UV spheres of n rings and 2n sectors
+    std::vector<int> sphere_segments {32, 128};
+};
+
+struct StageResult {
+    double ns_per_sample;
+    double allocations_per_call;
+    double kib_per_call;
+};
+
+// Keeps results alive so the measured work can't be optimized out
+volatile float sink = 0.f;
+
+template <typename T>
+void Consume(const std::vector<T> &values)
+{
+    if(!values.empty()) {
+        sink = sink + static_cast<float>(sizeof(values[0]) + values.size());
+    }
+}
+
+template <typename Function>
+StageResult MeasureStage(int iterations, size_t samples, Function &&function)
+{
+    // One untimed run, so first touch page faults don't end up in the numbers
+    function();
+
+    uint64_t allocations = allocation_count.load();
+    uint64_t bytes = allocated_bytes.load();
+    auto start = std::chrono::steady_clock::now();
+
+    for(int i = 0; i < iterations; i++) {
+        function();
+    }
+
+    auto end = std::chrono::steady_clock::now();
+    double nanoseconds = std::chrono::duration<double, std::nano>(end - start).count();
+
+    return StageResult {
+        nanoseconds / (static_cast<double>(iterations) * samples),
+        static_cast<double>(allocation_count.load() - allocations) / iterations,
+        static_cast<double>(allocated_bytes.load() - bytes) / iterations / 1024.0,
+    };
+}
+
+void PrintStage(const char *name, const StageResult &result)
+{
+    std::printf("  %-28s %10.2f ns/sample %8.1f allocs %10.1f KiB\n",
+                name, result.ns_per_sample, result.allocations_per_call, result.kib_per_call);
+}
+
+long PeakResidentKiB()
+{
+#if defined(__APPLE__)
+    rusage usage {};
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss / 1024;
+#elif defined(__unix__)
+    rusage usage {};
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+#else
+    return -1;
+#endif
+}
+
+std::vector<int> ParseList(const char *text)
+{
+    std::vector<int> values;
+    std::string list(text);
+    size_t start = 0;
+
+    while(start <= list.size()) {
+        size_t end = list.find(',', start);
+        if(end == std::string::npos) end = list.size();
+        if(end > start) values.push_back(std::atoi(list.substr(start, end - start).c_str()));
+        start = end + 1;
+    }
+
+    return values;
+}
+
+bool ParseOptions(int argc, char **argv, BenchOptions &options)
+{
+    for(int i = 1; i < argc; i++) {
+        const char *argument = argv[i];
+        const char *value = std::strchr(argument, '=');
+        if(!value) {
+            std::fprintf(stderr, "Unknown argument %s\n", argument);
+            return false;
+        }
+        value++;
+
+        if(std::strncmp(argument, "--chunk-sizes=", 14) == 0) {
+            options.chunk_sizes = ParseList(value);
+        } else if(std::strncmp(argument, "--octaves=", 10) == 0) {
+            options.octaves = ParseList(value);
+        } else if(std::strncmp(argument, "--iterations=", 13) == 0) {
+            options.iterations = std::max(1, std::atoi(value));
+        } else if(std::strncmp(argument, "--chunks=", 9) == 0) {
+            options.chunks = std::max(1, std::atoi(value));
+        } else if(std::strncmp(argument, "--diamond-square-details=", 25) == 0) {
+            options.diamond_square_details = ParseList(value);
+        } else if(std::strncmp(argument, "--sphere-segments=", 18) == 0) {
+            options.sphere_segments = ParseList(value);
+        } else {
+            std::fprintf(stderr, "Unknown argument %s\n", argument);
+            return false;
+        }
+    }
+
+    // The LOD quadtree needs 2^n + 1 vertices of at least one patch per side
+    for(int chunk_size : options.chunk_sizes) {
+        int quads = chunk_size - 1;
+        if(quads < kLodPatchSize || (quads & (quads - 1)) != 0) {
+            std::fprintf(stderr, "Chunk size %d is not 2^n + 1 with 2^n >= %d\n", chunk_size, kLodPatchSize);
+            return false;
+        }
+    }
+
+    for(int octaves : options.octaves) {
+        if(octaves < 1 || octaves > kMaxNoiseOctaves) {
+            std::fprintf(stderr, "Octave count %d is not in [1, %d]\n", octaves, kMaxNoiseOctaves);
+            return false;
+        }
+    }
+
+    for(int detail : options.diamond_square_details) {
+        if(detail < 1 || detail > 14) {
+            std::fprintf(stderr, "Diamond-square detail %d is not in [1, 14]\n", detail);
+            return false;
+        }
+    }
+
+    for(int segments : options.sphere_segments) {
+        if(segments < 3 || segments > 1024) {
+            std::fprintf(stderr, "Sphere segment count %d is not in [3, 1024]\n", segments);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+TerrainParameters MakeParameters(int chunk_size, int octaves)
+{
+    // The generator's default sliders, it can't be constructed without a GL context
+    return TerrainParameters {
+        octaves, 64.f, 128.f, 0.5f, 2.f,
+        0.1f, chunk_size, chunk_size
+    };
+}
+
+// The scalar noise.h implementation the batched kernels replaced, for comparison
+void BenchScalarNoise(const TerrainParameters &params, int iterations)
+{
+    std::vector<int> permutation = GetPermutationVector();
+    std::vector<float> out(params.chunk_width * params.chunk_height);
+    size_t samples = out.size();
+
+    StageResult result = MeasureStage(iterations, samples, [&] () {
+        for(int z = 0; z < params.chunk_height; z++) {
+            for(int x = 0; x < params.chunk_width; x++) {
+                float amplitude = 1.f;
+                float frequency = 1.f;
+                float sum = 0.f;
+
+                for(int octave = 0; octave < params.octaves; octave++) {
+                    float x_sample = x / params.noise_scale * frequency;
+                    float z_sample = z / params.noise_scale * frequency;
+                    sum += PerlinNoise(x_sample, z_sample, permutation) * amplitude;
+
+                    amplitude *= params.persistence;
+                    frequency *= params.lacunarity;
+                }
+
+                out[x + z * params.chunk_width] = sum;
+            }
+        }
+        Consume(out);
+    });
+
+    PrintStage("noise.h PerlinNoise", result);
+}
+
+void BenchBatchedNoise(const TerrainParameters &params, int iterations)
+{
+    FractalNoiseParameters noise_params {params.octaves, params.noise_scale, params.persistence, params.lacunarity};
+    std::vector<float> out(params.chunk_width * params.chunk_height);
+
+    for(int backend = 0; backend <= static_cast<int>(DetectNoiseBackend()); backend++) {
+        NoiseBackend noise_backend = static_cast<NoiseBackend>(backend);
+
+        StageResult result = MeasureStage(iterations, out.size(), [&] () {
+            for(int z = 0; z < params.chunk_height; z++) {
+                FractalNoiseRow(noise_params, 0, z, params.chunk_width, &out[z * params.chunk_width], noise_backend);
+            }
+            Consume(out);
+        });
+
+        std::string name = std::string("FractalNoiseRow ") + NoiseBackendName(noise_backend);
+        PrintStage(name.c_str(), result);
+    }
+}
+
+void BenchChunkStages(const TerrainParameters &params, int iterations)
+{
+    size_t samples = params.chunk_width * params.chunk_height;
+
+    std::vector<float> noise_sum = GenerateNoiseSum(params, 0, 0);
+    std::vector<float> bordered_heights = GenerateHeights(params, noise_sum);
+    std::vector<glm::vec3> normals = GenerateNormals(params, bordered_heights);
+    std::vector<float> heights = RemoveBorder(params, bordered_heights);
+    std::vector<TerrainVertex> vertices(samples);
+
+    PrintStage("GenerateNoiseSum", MeasureStage(iterations, samples, [&] () {
+        Consume(GenerateNoiseSum(params, 0, 0));
+    }));
+
+    // One octave added and removed again, what dragging the octave slider costs
+    TerrainParameters more_octaves = params;
+    more_octaves.octaves = std::min(params.octaves + 1, kMaxNoiseOctaves);
+    std::vector<float> updated_sum = noise_sum;
+    PrintStage("UpdateNoiseOctaves +1/-1", MeasureStage(iterations, samples, [&] () {
+        UpdateNoiseOctaves(more_octaves, params.octaves, 0, 0, updated_sum);
+        UpdateNoiseOctaves(params, more_octaves.octaves, 0, 0, updated_sum);
+        Consume(updated_sum);
+    }));
+
+    PrintStage("GenerateHeights", MeasureStage(iterations, samples, [&] () {
+        Consume(GenerateHeights(params, noise_sum));
+    }));
+
+    PrintStage("GenerateNormals", MeasureStage(iterations, samples, [&] () {
+        Consume(GenerateNormals(params, bordered_heights));
+    }));
+
+    PrintStage("RemoveBorder", MeasureStage(iterations, samples, [&] () {
+        Consume(RemoveBorder(params, bordered_heights));
+    }));
+
+    PrintStage("PackVertices", MeasureStage(iterations, samples, [&] () {
+        PackVertices(heights, normals, vertices.data());
+        Consume(vertices);
+    }));
+
+    PrintStage("BuildHeightBounds", MeasureStage(iterations, samples, [&] () {
+        Consume(TerrainLod::BuildHeightBounds(params.chunk_width - 1, heights));
+    }));
+
+    StageResult full = MeasureStage(iterations, samples, [&] () {
+        Consume(BuildChunkMesh(params, 0, 0).vertices);
+    });
+    PrintStage("BuildChunkMesh", full);
+
+    // Mesh height only changes reuse the whole noise sum
+    ChunkMesh previous = BuildChunkMesh(params, 0, 0);
+    TerrainParameters reshaped = params;
+    reshaped.mesh_height *= 0.5f;
+    PrintStage("BuildChunkMesh cached noise", MeasureStage(iterations, samples, [&] () {
+        Consume(BuildChunkMesh(reshaped, 0, 0, previous.cache.get()).vertices);
+    }));
+
+    std::printf("  %-28s %10.1f chunks/s\n", "single thread", 1e9 / (full.ns_per_sample * samples));
+}
+
+void BenchThreadedChunks(const TerrainParameters &params, int chunk_count)
+{
+    ThreadPool *pool = ThreadPool::Instance();
+    int side = static_cast<int>(std::ceil(std::sqrt(static_cast<double>(chunk_count))));
+
+    auto start = std::chrono::steady_clock::now();
+    for(int i = 0; i < chunk_count; i++) {
+        pool->Submit([params, i, side] () {
+            Consume(BuildChunkMesh(params, i % side, i / side).vertices);
+        });
+    }
+    pool->WaitIdle();
+    auto end = std::chrono::steady_clock::now();
+
+    double seconds = std::chrono::duration<double>(end - start).count();
+    std::printf("  %-28s %10.1f chunks/s on %u threads\n", "thread pool", chunk_count / seconds, pool->GetThreadCount());
+}
+
+void BenchDiamondSquare(int detail, int iterations)
+{
+    DiamondSquareParameters params;
+    params.detail = detail;
+    params.seed = 1;
+
+    int size = (1 << detail) + 1;
+    size_t samples = static_cast<size_t>(size) * size;
+
+    StageResult result = MeasureStage(iterations, samples, [&] () {
+        Consume(GenerateDiamondSquare(params).heights);
+    });
+
+    std::string name = "GenerateDiamondSquare " + std::to_string(size);
+    PrintStage(name.c_str(), result);
+    std::printf("  %-28s %10.1f ms/map\n", "", result.ns_per_sample * samples * 1e-6);
+}
+
+void BenchMeshOptimizer(int segments, int iterations)
+{
+    SphereMesh sphere = MakeShuffledSphere(segments);
+    size_t vertex_count = sphere.positions.size();
+    size_t triangle_count = sphere.indices.size() / 3;
+
+    // Timings include copying the shuffled indices
+    std::vector<uint32_t> cache_indices;
+    std::vector<uint32_t> clusters;
+    StageResult cache_result = MeasureStage(iterations, triangle_count, [&] () {
+        cache_indices = sphere.indices;
+        clusters = OptimizeVertexCache(cache_indices.data(), cache_indices.size(), vertex_count);
+    });
+
+    std::vector<uint32_t> overdraw_indices;
+    StageResult overdraw_result = MeasureStage(iterations, triangle_count, [&] () {
+        overdraw_indices = cache_indices;
+        OptimizeOverdraw(overdraw_indices.data(), overdraw_indices.size(), clusters,
+                         sphere.positions.data(), sizeof(glm::vec3), vertex_count);
+    });
+
+    std::vector<uint32_t> fetch_indices = overdraw_indices;
+    OptimizeVertexFetch(fetch_indices.data(), fetch_indices.size(), vertex_count);
+
+    std::string name = "sphere " + std::to_string(triangle_count) + " tris";
+    std::printf("  %-28s ACMR shuffled %.3f, vertex cache %.3f, overdraw %.3f, vertex fetch %.3f\n", name.c_str(),
+                AverageCacheMissRatio(sphere.indices.data(), sphere.indices.size(), vertex_count),
+                AverageCacheMissRatio(cache_indices.data(), cache_indices.size(), vertex_count),
+                AverageCacheMissRatio(overdraw_indices.data(), overdraw_indices.size(), vertex_count),
+                AverageCacheMissRatio(fetch_indices.data(), fetch_indices.size(), vertex_count));
+    PrintStage("OptimizeVertexCache", cache_result);
+    PrintStage("OptimizeOverdraw", overdraw_result);
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    BenchOptions options;
+    if(!ParseOptions(argc, argv, options)) {
+        return 1;
+    }
+
+    std::printf("steel_bench: %d iterations per stage, noise backend %s\n",
+                options.iterations, NoiseBackendName(GetNoiseBackend()));
+
+    for(int chunk_size : options.chunk_sizes) {
+        for(int octaves : options.octaves) {
+            TerrainParameters params = MakeParameters(chunk_size, octaves);
+            std::printf("\nchunk %dx%d, %d octaves\n", chunk_size, chunk_size, octaves);
+
+            BenchScalarNoise(params, options.iterations);
+            BenchBatchedNoise(params, options.iterations);
+            BenchChunkStages(params, options.iterations);
+            BenchThreadedChunks(params, options.chunks);
+        }
+    }
+
+    if(!options.diamond_square_details.empty()) {
+        std::printf("\ndiamond-square\n");
+    }
+    for(int detail : options.diamond_square_details) {
+        BenchDiamondSquare(detail, options.iterations);
+    }
+
+    if(!options.sphere_segments.empty()) {
+        std::printf("\nmesh optimizer\n");
+    }
+    for(int segments : options.sphere_segments) {
+        BenchMeshOptimizer(segments, options.iterations);
+    }
+
+    std::printf("\npeak RSS %ld KiB\n", PeakResidentKiB());
+    return 0;
+}
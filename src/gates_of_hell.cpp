@@ -1,42 +1,184 @@
 #include <GL/gl3w.h>
 #include <GLFW/glfw3.h>
 
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <memory>
+#include <string>
 
 #include "scenes/terrain_generation_scene.cpp"
 #include "scenes/fat_orc_scene.cpp"
+#include "rendering/gl_state_cache.h"
+#include "rendering/texture_cache.h"
+#include "rendering/uniform_buffers.h"
 #include "ui/display.h"
+#include "ui/profiler_panel.h"
+#include "utils/frame_timing_log.h"
+#include "utils/profiler.h"
 #include "utils/scene_manager.h"
+#include "utils/shader.h"
+#include "utils/thread_pool.h"
+#include "utils/trace_writer.h"
 
 
 
-int main() {    
+// gates_of_hell [--trace=<file.json>] [--scene=terrain|fat_orc]
+//               [--headless] [--frames=600] [--camera-path=<file>] [--timings=<file.csv>]
+// Headless runs render a fixed number of frames offscreen at a fixed time
+// step, fly the scene's camera path and log per-frame timings (CSV on stdout
+// unless --timings is given). --frames, --camera-path and --timings are
+// rejected without --headless.
+int main(int argc, char **argv) {    
+
+    const char *trace_path = nullptr;
+    const char *camera_path_file = nullptr;
+    const char *timings_path = nullptr;
+    std::string scene_name = "terrain";
+    bool headless = false;
+    int frame_count = 600;
+    // First argument that only applies to headless runs
+    const char *headless_argument = nullptr;
+
+    for(int i = 1; i < argc; i++) {
+        const char *argument = argv[i];
+        if(std::strncmp(argument, "--trace=", 8) == 0) {
+            trace_path = argument + 8;
+        } else if(std::strncmp(argument, "--scene=", 8) == 0) {
+            scene_name = argument + 8;
+        } else if(std::strcmp(argument, "--headless") == 0) {
+            headless = true;
+        } else if(std::strncmp(argument, "--frames=", 9) == 0) {
+            frame_count = std::atoi(argument + 9);
+            headless_argument = headless_argument ? headless_argument : argument;
+        } else if(std::strncmp(argument, "--camera-path=", 14) == 0) {
+            camera_path_file = argument + 14;
+            headless_argument = headless_argument ? headless_argument : argument;
+        } else if(std::strncmp(argument, "--timings=", 10) == 0) {
+            timings_path = argument + 10;
+            headless_argument = headless_argument ? headless_argument : argument;
+        } else {
+            std::fprintf(stderr, "Unknown argument %s\n", argument);
+            return 1;
+        }
+    }
+
+    if(headless_argument && !headless) {
+        std::fprintf(stderr, "Argument %s needs --headless\n", headless_argument);
+        return 1;
+    }
+    if(scene_name != "terrain" && scene_name != "fat_orc") {
+        std::fprintf(stderr, "Unknown scene %s, expected terrain or fat_orc\n", scene_name.c_str());
+        return 1;
+    }
+    if(frame_count < 1) {
+        std::fprintf(stderr, "Frame count has to be positive\n");
+        return 1;
+    }
+
+    // Programs bind through the state cache and to the shared uniform blocks,
+    // scenes create their programs right away
+    ShaderProgramHooks shader_hooks;
+    shader_hooks.use_program = [] (GLuint program) { GlStateCache::Instance()->UseProgram(program); };
+    shader_hooks.forget_program = [] (GLuint program) { GlStateCache::Instance()->ForgetProgram(program); };
+    shader_hooks.uniform_block_binding = GetUniformBlockBinding;
+    ShaderProgram::SetHooks(shader_hooks);
+
+    // Scenes start the thread pool, its workers have to know the profiler by then
+    ThreadPool::SetWorkerStartHook([] (unsigned index) {
+        Profiler::Instance()->SetThreadName("Worker " + std::to_string(index));
+    });
 
     SceneManager *scene_manager = SceneManager::Instance();
-    Display *display = new Display(1920, 1080, "Steel Engine");
+    Display *display = new Display(1920, 1080, "Steel Engine", headless);
+
+    if(scene_name == "fat_orc") {
+        scene_manager->Add("Fat Orc Scene", std::make_shared<FatOrcScene>(display));
+        scene_manager->SwitchTo("Fat Orc Scene");
+    } else {
+        std::shared_ptr<TerrainGenerationScene> terrain_generation_scene = std::make_shared<TerrainGenerationScene>(display);
+
+        scene_manager->Add("Terrain Generation Scene", terrain_generation_scene);
+        scene_manager->SwitchTo("Terrain Generation Scene");
+    }
 
-    std::shared_ptr<TerrainGenerationScene> terrain_generation_scene = std::make_shared<TerrainGenerationScene>(display);
+    Profiler *profiler = Profiler::Instance();
+    profiler->SetThreadName("Main");
+    display->AddCustomWidget("Profiler", "Timeline", [profiler] () { DrawProfilerPanel(*profiler); });
 
-    scene_manager->Add("Terrain Generation Scene", terrain_generation_scene);
-    scene_manager->SwitchTo("Terrain Generation Scene");
+    GlStateCache *gl_state_cache = GlStateCache::Instance();
+    display->AddCustomWidget("Profiler", "State Changes", [gl_state_cache] () {
+        const GlStateStats &stats = gl_state_cache->GetStats();
+        ImGui::Text("Programs %u, vertex arrays %u, textures %u, skipped %u",
+                    stats.program_binds, stats.vertex_array_binds, stats.texture_binds, stats.skipped_binds);
+    });
 
-    while(!display->ShouldClose()) {
+    std::unique_ptr<TraceWriter> trace_writer;
+    if(trace_path) {
+        trace_writer = std::make_unique<TraceWriter>(trace_path);
+    }
+
+    std::unique_ptr<FrameTimingLog> timing_log;
+    CameraPath camera_path;
+    if(headless) {
+        timing_log = std::make_unique<FrameTimingLog>(timings_path ? timings_path : "");
+
+        camera_path = scene_manager->GetCurrentScene()->GetBenchmarkPath();
+        if(camera_path_file && !camera_path.Load(camera_path_file)) {
+            return 1;
+        }
+    }
+
+    profiler->SetFrameListener([&trace_writer, &timing_log] (const ProfileFrame &frame) {
+        if(trace_writer) {
+            trace_writer->Submit(frame);
+        }
+        if(timing_log) {
+            timing_log->Record(frame);
+        }
+    });
+
+    // Headless frames advance at a fixed step, so every run sees the same camera positions
+    const float kHeadlessDeltaTime = 1.f / 60.f;
+
+    for(int64_t frame = 0; headless ? frame < frame_count : !display->ShouldClose(); frame++) {
+        profiler->BeginFrame();
+        gl_state_cache->ResetStats();
         glfwPollEvents();
 
         glClearColor(.2f, .3f, .3f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
         display->UpdateDeltaTime();
-        float delta_time = display->GetDeltaTime();
+        float delta_time = headless ? kHeadlessDeltaTime : display->GetDeltaTime();
 
-        scene_manager->ProcessInput();
+        if(headless) {
+            if(Camera *camera = scene_manager->GetCurrentScene()->GetCamera()) {
+                camera_path.Apply(*camera, frame * kHeadlessDeltaTime);
+            }
+        } else {
+            scene_manager->ProcessInput();
+        }
         scene_manager->Update(delta_time);
         scene_manager->LateUpdate(delta_time);
+
+        UniformBuffers::Instance()->BeginFrame();
+        // Textures requested without waiting get their images as they finish decoding
+        TextureCache::Instance()->UploadDecoded();
         scene_manager->Draw(display);
 
         display->DrawImGuis();
 
-        glfwSwapBuffers(display->GetWindow());
+        display->Present();
+    }
+
+    // The last frames are still waiting on their GPU queries
+    profiler->Flush();
+    profiler->SetFrameListener(nullptr);
+    trace_writer.reset();
+
+    if(timing_log) {
+        timing_log->PrintSummary();
     }
 
     return 0;
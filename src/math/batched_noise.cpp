@@ -0,0 +1,521 @@
+#include "batched_noise.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define STEEL_NOISE_X86 1
+#include <immintrin.h>
+#endif
+
+namespace {
+
+constexpr std::array<int32_t, 256> kBasePermutation = {
+    151,160,137,91,90,15,131,13,201,95,96,53,194,233,7,225,140,36,103,30,69,142,
+    8,99,37,240,21,10,23,190, 6,148,247,120,234,75,0,26,197,62,94,252,219,35,11,
+    88,237,149,56,87,174,20,125,136,171,168, 68,175,74,165,71,134,139,48,27,166,
+    77,146,158,231,83,111,229,122,60,211,133,230,220,105,92,41,55,46,245,40,244,
+    102,143,54, 65,25,63,161, 1,216,80,73,209,76,132,187,208, 89,18,169,200,196,
+    135,130,116,188,159,86,164,100,109,198,173,186, 3,64,52,217,226,250,124,123,
+    5,202,38,147,118,126,255,82,85,212,207,206,59,227,47,16,58,17,182,189,28,42,
+    223,183,170,213,119,248,152, 2,44,154,163, 70,221,153,101,155,167, 43,172,9,
+    129,22,39,253, 19,98,108,110,79,113,224,232,178,185, 112,104,218,246,97,228,
+    251,34,242,193,238,210,144,12,191,179,162,241, 81,51,145,235,249,14,239,107,
+    49,192,214, 31,181,199,106,157,184, 84,204,176,115,121,50,45,127, 4,150,254,
+    138,236,205,93,222,114,67,29,24,72,243,141,128,195,78,66,215,61,156,180,117,
+    32,57,177,33,203
+};
+
+constexpr std::array<int32_t, 512> MakePermutationTable()
+{
+    std::array<int32_t, 512> table {};
+    for(int i = 0; i < 512; i++) {
+        table[i] = kBasePermutation[i & 255];
+    }
+    return table;
+}
+
+alignas(64) constexpr std::array<int32_t, 512> kPermutation = MakePermutationTable();
+
+// The terrain samples the z = 0.5 slice of 3D Perlin noise, so the z cell,
+// the fractional z and its fade value are constants.
+constexpr float kSliceZ = 0.5f;
+constexpr float kSliceFade = 0.5f;
+
+// Everything that only depends on the octave and the row, computed once per
+// row in scalar code and broadcast by the SIMD kernels so all backends see
+// the exact same values.
+struct OctaveSample {
+    float frequency;
+    float amplitude;
+    int y_cell;
+    float y;
+    float y_minus_one;
+    float y_fade;
+};
+
+inline float Fade(float t)
+{
+    return ((6.f * t - 15.f) * t + 10.f) * t * t * t;
+}
+
+inline float Lerp(float t, float a, float b)
+{
+    return a + t * (b - a);
+}
+
+inline float Grad(int hash, float x, float y, float z)
+{
+    int h = hash & 15;
+    float u = h < 8 ? x : y;
+    float v = h < 4 ? y : (h == 12 || h == 14 ? x : z);
+    return ((h & 1) == 0 ? u : -u) + ((h & 2) == 0 ? v : -v);
+}
+
+// Prepares the octaves [first_octave, params.octaves), amplitudes multiplied by weight
+int PrepareOctaves(const FractalNoiseParameters &params, int first_octave, float weight, int z, OctaveSample *octaves)
+{
+    int octave_end = std::clamp(params.octaves, 0, kMaxNoiseOctaves);
+    int octave_count = 0;
+
+    float amplitude = 1.f;
+    float frequency = 1.f;
+
+    for(int i = 0; i < octave_end; i++) {
+        if(i >= first_octave) {
+            float z_sample = static_cast<float>(z) / params.noise_scale * frequency;
+            float z_floor = std::floor(z_sample);
+            float y = z_sample - z_floor;
+
+            octaves[octave_count++] = {frequency, amplitude * weight, static_cast<int>(z_floor) & 255, y, y - 1.f, Fade(y)};
+        }
+
+        amplitude *= params.persistence;
+        frequency *= params.lacunarity;
+    }
+
+    return octave_count;
+}
+
+float PerlinSample(float x, const OctaveSample &octave)
+{
+    const int32_t *p = kPermutation.data();
+
+    float x_floor = std::floor(x);
+    int X = static_cast<int>(x_floor) & 255;
+    x -= x_floor;
+
+    float u = Fade(x);
+    float x1 = x - 1.f;
+    float y = octave.y;
+    float y1 = octave.y_minus_one;
+    float z = kSliceZ;
+    float z1 = kSliceZ - 1.f;
+
+    int A = p[X] + octave.y_cell, AA = p[A], AB = p[A + 1],
+        B = p[X + 1] + octave.y_cell, BA = p[B], BB = p[B + 1];
+
+    return Lerp(kSliceFade, Lerp(octave.y_fade, Lerp(u, Grad(p[AA], x, y, z),
+                                                        Grad(p[BA], x1, y, z)),
+                                                Lerp(u, Grad(p[AB], x, y1, z),
+                                                        Grad(p[BB], x1, y1, z))),
+                            Lerp(octave.y_fade, Lerp(u, Grad(p[AA + 1], x, y, z1),
+                                                        Grad(p[BA + 1], x1, y, z1)),
+                                                Lerp(u, Grad(p[AB + 1], x, y1, z1),
+                                                        Grad(p[BB + 1], x1, y1, z1))));
+}
+
+void FractalRowReference(const OctaveSample *octaves, int octave_count, float noise_scale,
+    int x_start, int count, bool accumulate, float *out)
+{
+    for(int i = 0; i < count; i++) {
+        float x_base = static_cast<float>(x_start + i);
+        float height = accumulate ? out[i] : 0.f;
+
+        for(int o = 0; o < octave_count; o++) {
+            float x = x_base / noise_scale * octaves[o].frequency;
+            height += PerlinSample(x, octaves[o]) * octaves[o].amplitude;
+        }
+
+        out[i] = height;
+    }
+}
+
+#ifdef STEEL_NOISE_X86
+
+// SSE4.1: 4 samples per instruction, no hardware gather.
+
+__attribute__((target("sse4.1")))
+inline __m128i Gather4(const int32_t *table, __m128i index)
+{
+    alignas(16) int32_t lanes[4];
+    _mm_store_si128(reinterpret_cast<__m128i *>(lanes), index);
+    return _mm_setr_epi32(table[lanes[0]], table[lanes[1]], table[lanes[2]], table[lanes[3]]);
+}
+
+__attribute__((target("sse4.1")))
+inline __m128 Fade4(__m128 t)
+{
+    __m128 f = _mm_add_ps(_mm_mul_ps(_mm_sub_ps(_mm_mul_ps(_mm_set1_ps(6.f), t), _mm_set1_ps(15.f)), t), _mm_set1_ps(10.f));
+    return _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(f, t), t), t);
+}
+
+__attribute__((target("sse4.1")))
+inline __m128 Lerp4(__m128 t, __m128 a, __m128 b)
+{
+    return _mm_add_ps(a, _mm_mul_ps(t, _mm_sub_ps(b, a)));
+}
+
+__attribute__((target("sse4.1")))
+inline __m128 Grad4(__m128i hash, __m128 x, __m128 y, __m128 z)
+{
+    __m128i h = _mm_and_si128(hash, _mm_set1_epi32(15));
+    __m128 below_8 = _mm_castsi128_ps(_mm_cmplt_epi32(h, _mm_set1_epi32(8)));
+    __m128 below_4 = _mm_castsi128_ps(_mm_cmplt_epi32(h, _mm_set1_epi32(4)));
+    __m128 v_is_x = _mm_castsi128_ps(_mm_or_si128(_mm_cmpeq_epi32(h, _mm_set1_epi32(12)),
+                                                  _mm_cmpeq_epi32(h, _mm_set1_epi32(14))));
+
+    __m128 u = _mm_blendv_ps(y, x, below_8);
+    __m128 v = _mm_blendv_ps(_mm_blendv_ps(z, x, v_is_x), y, below_4);
+
+    __m128 u_sign = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(h, _mm_set1_epi32(1)), 31));
+    __m128 v_sign = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(h, _mm_set1_epi32(2)), 30));
+    return _mm_add_ps(_mm_xor_ps(u, u_sign), _mm_xor_ps(v, v_sign));
+}
+
+__attribute__((target("sse4.1")))
+inline __m128 Perlin4(__m128 x, const OctaveSample &octave)
+{
+    const int32_t *p = kPermutation.data();
+
+    __m128 x_floor = _mm_floor_ps(x);
+    __m128i X = _mm_and_si128(_mm_cvttps_epi32(x_floor), _mm_set1_epi32(255));
+    x = _mm_sub_ps(x, x_floor);
+
+    __m128 u = Fade4(x);
+    __m128 x1 = _mm_sub_ps(x, _mm_set1_ps(1.f));
+    __m128 y = _mm_set1_ps(octave.y);
+    __m128 y1 = _mm_set1_ps(octave.y_minus_one);
+    __m128 z = _mm_set1_ps(kSliceZ);
+    __m128 z1 = _mm_set1_ps(kSliceZ - 1.f);
+    __m128 v = _mm_set1_ps(octave.y_fade);
+    __m128 w = _mm_set1_ps(kSliceFade);
+
+    __m128i one = _mm_set1_epi32(1);
+    __m128i y_cell = _mm_set1_epi32(octave.y_cell);
+    __m128i A = _mm_add_epi32(Gather4(p, X), y_cell);
+    __m128i B = _mm_add_epi32(Gather4(p, _mm_add_epi32(X, one)), y_cell);
+    __m128i AA = Gather4(p, A), AB = Gather4(p, _mm_add_epi32(A, one));
+    __m128i BA = Gather4(p, B), BB = Gather4(p, _mm_add_epi32(B, one));
+
+    return Lerp4(w, Lerp4(v, Lerp4(u, Grad4(Gather4(p, AA), x, y, z),
+                                      Grad4(Gather4(p, BA), x1, y, z)),
+                             Lerp4(u, Grad4(Gather4(p, AB), x, y1, z),
+                                      Grad4(Gather4(p, BB), x1, y1, z))),
+                    Lerp4(v, Lerp4(u, Grad4(Gather4(p, _mm_add_epi32(AA, one)), x, y, z1),
+                                      Grad4(Gather4(p, _mm_add_epi32(BA, one)), x1, y, z1)),
+                             Lerp4(u, Grad4(Gather4(p, _mm_add_epi32(AB, one)), x, y1, z1),
+                                      Grad4(Gather4(p, _mm_add_epi32(BB, one)), x1, y1, z1))));
+}
+
+__attribute__((target("sse4.1")))
+void FractalRowSSE41(const OctaveSample *octaves, int octave_count, float noise_scale,
+    int x_start, int count, bool accumulate, float *out)
+{
+    const __m128 scale = _mm_set1_ps(noise_scale);
+    const __m128i lane_offsets = _mm_setr_epi32(0, 1, 2, 3);
+
+    int i = 0;
+    for(; i + 4 <= count; i += 4) {
+        __m128 x_base = _mm_cvtepi32_ps(_mm_add_epi32(_mm_set1_epi32(x_start + i), lane_offsets));
+        __m128 height = accumulate ? _mm_loadu_ps(out + i) : _mm_setzero_ps();
+
+        for(int o = 0; o < octave_count; o++) {
+            __m128 x = _mm_mul_ps(_mm_div_ps(x_base, scale), _mm_set1_ps(octaves[o].frequency));
+            height = _mm_add_ps(height, _mm_mul_ps(Perlin4(x, octaves[o]), _mm_set1_ps(octaves[o].amplitude)));
+        }
+
+        _mm_storeu_ps(out + i, height);
+    }
+
+    FractalRowReference(octaves, octave_count, noise_scale, x_start + i, count - i, accumulate, out + i);
+}
+
+// AVX2: 8 samples per instruction with hardware gathers.
+
+__attribute__((target("avx2")))
+inline __m256 Fade8(__m256 t)
+{
+    __m256 f = _mm256_add_ps(_mm256_mul_ps(_mm256_sub_ps(_mm256_mul_ps(_mm256_set1_ps(6.f), t), _mm256_set1_ps(15.f)), t), _mm256_set1_ps(10.f));
+    return _mm256_mul_ps(_mm256_mul_ps(_mm256_mul_ps(f, t), t), t);
+}
+
+__attribute__((target("avx2")))
+inline __m256 Lerp8(__m256 t, __m256 a, __m256 b)
+{
+    return _mm256_add_ps(a, _mm256_mul_ps(t, _mm256_sub_ps(b, a)));
+}
+
+__attribute__((target("avx2")))
+inline __m256 Grad8(__m256i hash, __m256 x, __m256 y, __m256 z)
+{
+    __m256i h = _mm256_and_si256(hash, _mm256_set1_epi32(15));
+    __m256 below_8 = _mm256_castsi256_ps(_mm256_cmpgt_epi32(_mm256_set1_epi32(8), h));
+    __m256 below_4 = _mm256_castsi256_ps(_mm256_cmpgt_epi32(_mm256_set1_epi32(4), h));
+    __m256 v_is_x = _mm256_castsi256_ps(_mm256_or_si256(_mm256_cmpeq_epi32(h, _mm256_set1_epi32(12)),
+                                                        _mm256_cmpeq_epi32(h, _mm256_set1_epi32(14))));
+
+    __m256 u = _mm256_blendv_ps(y, x, below_8);
+    __m256 v = _mm256_blendv_ps(_mm256_blendv_ps(z, x, v_is_x), y, below_4);
+
+    __m256 u_sign = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(h, _mm256_set1_epi32(1)), 31));
+    __m256 v_sign = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(h, _mm256_set1_epi32(2)), 30));
+    return _mm256_add_ps(_mm256_xor_ps(u, u_sign), _mm256_xor_ps(v, v_sign));
+}
+
+__attribute__((target("avx2")))
+inline __m256 Perlin8(__m256 x, const OctaveSample &octave)
+{
+    const int *p = kPermutation.data();
+
+    __m256 x_floor = _mm256_floor_ps(x);
+    __m256i X = _mm256_and_si256(_mm256_cvttps_epi32(x_floor), _mm256_set1_epi32(255));
+    x = _mm256_sub_ps(x, x_floor);
+
+    __m256 u = Fade8(x);
+    __m256 x1 = _mm256_sub_ps(x, _mm256_set1_ps(1.f));
+    __m256 y = _mm256_set1_ps(octave.y);
+    __m256 y1 = _mm256_set1_ps(octave.y_minus_one);
+    __m256 z = _mm256_set1_ps(kSliceZ);
+    __m256 z1 = _mm256_set1_ps(kSliceZ - 1.f);
+    __m256 v = _mm256_set1_ps(octave.y_fade);
+    __m256 w = _mm256_set1_ps(kSliceFade);
+
+    __m256i one = _mm256_set1_epi32(1);
+    __m256i y_cell = _mm256_set1_epi32(octave.y_cell);
+    __m256i A = _mm256_add_epi32(_mm256_i32gather_epi32(p, X, 4), y_cell);
+    __m256i B = _mm256_add_epi32(_mm256_i32gather_epi32(p, _mm256_add_epi32(X, one), 4), y_cell);
+    __m256i AA = _mm256_i32gather_epi32(p, A, 4), AB = _mm256_i32gather_epi32(p, _mm256_add_epi32(A, one), 4);
+    __m256i BA = _mm256_i32gather_epi32(p, B, 4), BB = _mm256_i32gather_epi32(p, _mm256_add_epi32(B, one), 4);
+
+    return Lerp8(w, Lerp8(v, Lerp8(u, Grad8(_mm256_i32gather_epi32(p, AA, 4), x, y, z),
+                                      Grad8(_mm256_i32gather_epi32(p, BA, 4), x1, y, z)),
+                             Lerp8(u, Grad8(_mm256_i32gather_epi32(p, AB, 4), x, y1, z),
+                                      Grad8(_mm256_i32gather_epi32(p, BB, 4), x1, y1, z))),
+                    Lerp8(v, Lerp8(u, Grad8(_mm256_i32gather_epi32(p, _mm256_add_epi32(AA, one), 4), x, y, z1),
+                                      Grad8(_mm256_i32gather_epi32(p, _mm256_add_epi32(BA, one), 4), x1, y, z1)),
+                             Lerp8(u, Grad8(_mm256_i32gather_epi32(p, _mm256_add_epi32(AB, one), 4), x, y1, z1),
+                                      Grad8(_mm256_i32gather_epi32(p, _mm256_add_epi32(BB, one), 4), x1, y1, z1))));
+}
+
+__attribute__((target("avx2")))
+void FractalRowAVX2(const OctaveSample *octaves, int octave_count, float noise_scale,
+    int x_start, int count, bool accumulate, float *out)
+{
+    const __m256 scale = _mm256_set1_ps(noise_scale);
+    const __m256i lane_offsets = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+
+    int i = 0;
+    for(; i + 8 <= count; i += 8) {
+        __m256 x_base = _mm256_cvtepi32_ps(_mm256_add_epi32(_mm256_set1_epi32(x_start + i), lane_offsets));
+        __m256 height = accumulate ? _mm256_loadu_ps(out + i) : _mm256_setzero_ps();
+
+        for(int o = 0; o < octave_count; o++) {
+            __m256 x = _mm256_mul_ps(_mm256_div_ps(x_base, scale), _mm256_set1_ps(octaves[o].frequency));
+            height = _mm256_add_ps(height, _mm256_mul_ps(Perlin8(x, octaves[o]), _mm256_set1_ps(octaves[o].amplitude)));
+        }
+
+        _mm256_storeu_ps(out + i, height);
+    }
+
+    FractalRowReference(octaves, octave_count, noise_scale, x_start + i, count - i, accumulate, out + i);
+}
+
+// AVX-512F: 16 samples per instruction, mask registers instead of blend vectors.
+
+__attribute__((target("avx512f")))
+inline __m512 Fade16(__m512 t)
+{
+    __m512 f = _mm512_add_ps(_mm512_mul_ps(_mm512_sub_ps(_mm512_mul_ps(_mm512_set1_ps(6.f), t), _mm512_set1_ps(15.f)), t), _mm512_set1_ps(10.f));
+    return _mm512_mul_ps(_mm512_mul_ps(_mm512_mul_ps(f, t), t), t);
+}
+
+__attribute__((target("avx512f")))
+inline __m512 Lerp16(__m512 t, __m512 a, __m512 b)
+{
+    return _mm512_add_ps(a, _mm512_mul_ps(t, _mm512_sub_ps(b, a)));
+}
+
+__attribute__((target("avx512f")))
+inline __m512 Grad16(__m512i hash, __m512 x, __m512 y, __m512 z)
+{
+    __m512i h = _mm512_and_si512(hash, _mm512_set1_epi32(15));
+    __mmask16 below_8 = _mm512_cmplt_epi32_mask(h, _mm512_set1_epi32(8));
+    __mmask16 below_4 = _mm512_cmplt_epi32_mask(h, _mm512_set1_epi32(4));
+    __mmask16 v_is_x = _mm512_cmpeq_epi32_mask(h, _mm512_set1_epi32(12)) | _mm512_cmpeq_epi32_mask(h, _mm512_set1_epi32(14));
+
+    __m512 u = _mm512_mask_blend_ps(below_8, y, x);
+    __m512 v = _mm512_mask_blend_ps(below_4, _mm512_mask_blend_ps(v_is_x, z, x), y);
+
+    __m512i u_sign = _mm512_slli_epi32(_mm512_and_si512(h, _mm512_set1_epi32(1)), 31);
+    __m512i v_sign = _mm512_slli_epi32(_mm512_and_si512(h, _mm512_set1_epi32(2)), 30);
+    return _mm512_add_ps(_mm512_castsi512_ps(_mm512_xor_si512(_mm512_castps_si512(u), u_sign)),
+                         _mm512_castsi512_ps(_mm512_xor_si512(_mm512_castps_si512(v), v_sign)));
+}
+
+__attribute__((target("avx512f")))
+inline __m512 Perlin16(__m512 x, const OctaveSample &octave)
+{
+    const int *p = kPermutation.data();
+
+    __m512 x_floor = _mm512_roundscale_ps(x, _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC);
+    __m512i X = _mm512_and_si512(_mm512_cvttps_epi32(x_floor), _mm512_set1_epi32(255));
+    x = _mm512_sub_ps(x, x_floor);
+
+    __m512 u = Fade16(x);
+    __m512 x1 = _mm512_sub_ps(x, _mm512_set1_ps(1.f));
+    __m512 y = _mm512_set1_ps(octave.y);
+    __m512 y1 = _mm512_set1_ps(octave.y_minus_one);
+    __m512 z = _mm512_set1_ps(kSliceZ);
+    __m512 z1 = _mm512_set1_ps(kSliceZ - 1.f);
+    __m512 v = _mm512_set1_ps(octave.y_fade);
+    __m512 w = _mm512_set1_ps(kSliceFade);
+
+    __m512i one = _mm512_set1_epi32(1);
+    __m512i y_cell = _mm512_set1_epi32(octave.y_cell);
+    __m512i A = _mm512_add_epi32(_mm512_i32gather_epi32(X, p, 4), y_cell);
+    __m512i B = _mm512_add_epi32(_mm512_i32gather_epi32(_mm512_add_epi32(X, one), p, 4), y_cell);
+    __m512i AA = _mm512_i32gather_epi32(A, p, 4), AB = _mm512_i32gather_epi32(_mm512_add_epi32(A, one), p, 4);
+    __m512i BA = _mm512_i32gather_epi32(B, p, 4), BB = _mm512_i32gather_epi32(_mm512_add_epi32(B, one), p, 4);
+
+    return Lerp16(w, Lerp16(v, Lerp16(u, Grad16(_mm512_i32gather_epi32(AA, p, 4), x, y, z),
+                                         Grad16(_mm512_i32gather_epi32(BA, p, 4), x1, y, z)),
+                               Lerp16(u, Grad16(_mm512_i32gather_epi32(AB, p, 4), x, y1, z),
+                                         Grad16(_mm512_i32gather_epi32(BB, p, 4), x1, y1, z))),
+                     Lerp16(v, Lerp16(u, Grad16(_mm512_i32gather_epi32(_mm512_add_epi32(AA, one), p, 4), x, y, z1),
+                                         Grad16(_mm512_i32gather_epi32(_mm512_add_epi32(BA, one), p, 4), x1, y, z1)),
+                               Lerp16(u, Grad16(_mm512_i32gather_epi32(_mm512_add_epi32(AB, one), p, 4), x, y1, z1),
+                                         Grad16(_mm512_i32gather_epi32(_mm512_add_epi32(BB, one), p, 4), x1, y1, z1))));
+}
+
+__attribute__((target("avx512f")))
+void FractalRowAVX512(const OctaveSample *octaves, int octave_count, float noise_scale,
+    int x_start, int count, bool accumulate, float *out)
+{
+    const __m512 scale = _mm512_set1_ps(noise_scale);
+    const __m512i lane_offsets = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+
+    int i = 0;
+    for(; i + 16 <= count; i += 16) {
+        __m512 x_base = _mm512_cvtepi32_ps(_mm512_add_epi32(_mm512_set1_epi32(x_start + i), lane_offsets));
+        __m512 height = accumulate ? _mm512_loadu_ps(out + i) : _mm512_setzero_ps();
+
+        for(int o = 0; o < octave_count; o++) {
+            __m512 x = _mm512_mul_ps(_mm512_div_ps(x_base, scale), _mm512_set1_ps(octaves[o].frequency));
+            height = _mm512_add_ps(height, _mm512_mul_ps(Perlin16(x, octaves[o]), _mm512_set1_ps(octaves[o].amplitude)));
+        }
+
+        _mm512_storeu_ps(out + i, height);
+    }
+
+    FractalRowReference(octaves, octave_count, noise_scale, x_start + i, count - i, accumulate, out + i);
+}
+
+#endif // STEEL_NOISE_X86
+
+const NoiseBackend supported_backend = DetectNoiseBackend();
+std::atomic<NoiseBackend> active_backend {supported_backend};
+
+} // namespace
+
+NoiseBackend DetectNoiseBackend()
+{
+#ifdef STEEL_NOISE_X86
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx512f")) return NoiseBackend::AVX512;
+    if(__builtin_cpu_supports("avx2")) return NoiseBackend::AVX2;
+    if(__builtin_cpu_supports("sse4.1")) return NoiseBackend::SSE41;
+#endif
+    return NoiseBackend::Reference;
+}
+
+NoiseBackend GetNoiseBackend()
+{
+    return active_backend.load(std::memory_order_relaxed);
+}
+
+void SetNoiseBackend(NoiseBackend backend)
+{
+    active_backend.store(std::min(backend, supported_backend), std::memory_order_relaxed);
+}
+
+const char *NoiseBackendName(NoiseBackend backend)
+{
+    switch(backend) {
+        case NoiseBackend::SSE41: return "SSE4.1";
+        case NoiseBackend::AVX2: return "AVX2";
+        case NoiseBackend::AVX512: return "AVX-512";
+        default: return "Reference";
+    }
+}
+
+namespace {
+void DispatchFractalRow(const OctaveSample *octaves, int octave_count, float noise_scale,
+    int x_start, int count, bool accumulate, float *out, NoiseBackend backend)
+{
+    switch(std::min(backend, supported_backend)) {
+#ifdef STEEL_NOISE_X86
+        case NoiseBackend::AVX512:
+            FractalRowAVX512(octaves, octave_count, noise_scale, x_start, count, accumulate, out);
+            return;
+        case NoiseBackend::AVX2:
+            FractalRowAVX2(octaves, octave_count, noise_scale, x_start, count, accumulate, out);
+            return;
+        case NoiseBackend::SSE41:
+            FractalRowSSE41(octaves, octave_count, noise_scale, x_start, count, accumulate, out);
+            return;
+#endif
+        default:
+            FractalRowReference(octaves, octave_count, noise_scale, x_start, count, accumulate, out);
+            return;
+    }
+}
+} // namespace
+
+void FractalNoiseRow(const FractalNoiseParameters &params, int x_start, int z, int count, float *out)
+{
+    FractalNoiseRow(params, x_start, z, count, out, GetNoiseBackend());
+}
+
+void FractalNoiseRow(const FractalNoiseParameters &params, int x_start, int z, int count, float *out, NoiseBackend backend)
+{
+    OctaveSample octaves[kMaxNoiseOctaves];
+    int octave_count = PrepareOctaves(params, 0, 1.f, z, octaves);
+
+    DispatchFractalRow(octaves, octave_count, params.noise_scale, x_start, count, false, out, backend);
+}
+
+void AccumulateFractalNoiseRow(const FractalNoiseParameters &params, int first_octave, float weight,
+    int x_start, int z, int count, float *out)
+{
+    OctaveSample octaves[kMaxNoiseOctaves];
+    int octave_count = PrepareOctaves(params, first_octave, weight, z, octaves);
+
+    DispatchFractalRow(octaves, octave_count, params.noise_scale, x_start, count, true, out, GetNoiseBackend());
+}
+
+float FractalNoiseMaximum(const FractalNoiseParameters &params)
+{
+    int octave_count = std::clamp(params.octaves, 0, kMaxNoiseOctaves);
+    float amplitude = 1.f;
+    float maximum = 0.f;
+
+    for(int i = 0; i < octave_count; i++) {
+        maximum += amplitude;
+        amplitude *= params.persistence;
+    }
+
+    return maximum;
+}
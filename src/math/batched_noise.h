@@ -0,0 +1,45 @@
+#ifndef BATCHED_NOISE_H
+#define BATCHED_NOISE_H
+
+#include <cstdint>
+
+// Instruction sets the batched noise kernels can run on. Every backend
+// produces bit-for-bit identical results to Reference, which is the plain
+// scalar implementation and is always available.
+enum class NoiseBackend {
+    Reference,
+    SSE41,
+    AVX2,
+    AVX512,
+};
+
+constexpr int kMaxNoiseOctaves = 32;
+
+struct FractalNoiseParameters {
+    int octaves = 8;
+    float noise_scale = 128;
+    float persistence = 0.5;
+    float lacunarity = 2;
+};
+
+NoiseBackend DetectNoiseBackend();
+NoiseBackend GetNoiseBackend();
+void SetNoiseBackend(NoiseBackend backend);
+const char *NoiseBackendName(NoiseBackend backend);
+
+// Evaluates fractal Perlin noise for the samples (x_start + i, z), i in [0, count)
+// on the integer sample grid and writes the summed octaves into out.
+void FractalNoiseRow(const FractalNoiseParameters &params, int x_start, int z, int count, float *out);
+void FractalNoiseRow(const FractalNoiseParameters &params, int x_start, int z, int count, float *out, NoiseBackend backend);
+
+// Adds the octaves [first_octave, params.octaves) times weight onto out. With
+// weight 1 the result matches FractalNoiseRow over all octaves bit for bit when
+// out holds the sum of the octaves before first_octave; weight -1 removes octaves
+// again, up to rounding.
+void AccumulateFractalNoiseRow(const FractalNoiseParameters &params, int first_octave, float weight,
+    int x_start, int z, int count, float *out);
+
+// Sum of the octave amplitudes, used to normalize the output of FractalNoiseRow.
+float FractalNoiseMaximum(const FractalNoiseParameters &params);
+
+#endif // BATCHED_NOISE_H
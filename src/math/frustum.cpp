@@ -0,0 +1,134 @@
+#include "frustum.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define STEEL_FRUSTUM_SSE 1
+#include <emmintrin.h>
+#endif
+
+namespace {
+// Signed distance of the box corner furthest along the plane normal
+inline float MaxPlaneDistance(const glm::vec4 &plane, const Aabb &box)
+{
+    float x = plane.x >= 0.f ? box.max.x : box.min.x;
+    float y = plane.y >= 0.f ? box.max.y : box.min.y;
+    float z = plane.z >= 0.f ? box.max.z : box.min.z;
+    return plane.x * x + plane.y * y + plane.z * z + plane.w;
+}
+}
+
+Aabb ComputeAabb(const glm::vec3 *points, size_t count, size_t stride)
+{
+    if(count == 0) {
+        return {glm::vec3(0.f), glm::vec3(0.f)};
+    }
+
+    const char *bytes = reinterpret_cast<const char *>(points);
+    Aabb box {*points, *points};
+    for(size_t i = 1; i < count; i++) {
+        const glm::vec3 &point = *reinterpret_cast<const glm::vec3 *>(bytes + i * stride);
+        box.min = glm::min(box.min, point);
+        box.max = glm::max(box.max, point);
+    }
+    return box;
+}
+
+Aabb TransformAabb(const Aabb &box, const glm::mat4 &transform)
+{
+    // Arvo: each output axis gathers the extents of the input axes weighted by |matrix entry|
+    glm::vec3 center = (box.min + box.max) * .5f;
+    glm::vec3 extent = (box.max - box.min) * .5f;
+
+    glm::vec3 new_center = glm::vec3(transform[3]);
+    glm::vec3 new_extent(0.f);
+    for(int column = 0; column < 3; column++) {
+        glm::vec3 axis = glm::vec3(transform[column]);
+        new_center += axis * center[column];
+        new_extent += glm::abs(axis) * extent[column];
+    }
+    return {new_center - new_extent, new_center + new_extent};
+}
+
+Frustum Frustum::FromMatrix(const glm::mat4 &view_projection)
+{
+    // Gribb-Hartmann: rows of the matrix combined against the OpenGL clip volume -w <= x, y, z <= w
+    glm::vec4 rows[4];
+    for(int i = 0; i < 4; i++) {
+        rows[i] = glm::vec4(view_projection[0][i], view_projection[1][i], view_projection[2][i], view_projection[3][i]);
+    }
+
+    Frustum frustum;
+    frustum.planes[Left] = rows[3] + rows[0];
+    frustum.planes[Right] = rows[3] - rows[0];
+    frustum.planes[Bottom] = rows[3] + rows[1];
+    frustum.planes[Top] = rows[3] - rows[1];
+    frustum.planes[Near] = rows[3] + rows[2];
+    frustum.planes[Far] = rows[3] - rows[2];
+
+    for(glm::vec4 &plane : frustum.planes) {
+        plane /= glm::length(glm::vec3(plane));
+    }
+    return frustum;
+}
+
+Frustum Frustum::ToObjectSpace(const glm::mat4 &model) const
+{
+    // dot(plane, model * p) == dot(transpose(model) * plane, p)
+    glm::mat4 model_transposed = glm::transpose(model);
+
+    Frustum frustum;
+    for(int i = 0; i < PlaneCount; i++) {
+        frustum.planes[i] = model_transposed * planes[i];
+    }
+    return frustum;
+}
+
+bool Frustum::Intersects(const Aabb &box) const
+{
+    for(const glm::vec4 &plane : planes) {
+        if(MaxPlaneDistance(plane, box) < 0.f) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void CullAabbs(const Frustum &frustum, const Aabb *boxes, size_t count, uint8_t *visible)
+{
+    size_t i = 0;
+
+#ifdef STEEL_FRUSTUM_SSE
+    // Four boxes per iteration as structure of arrays. The plane is the same
+    // for all lanes, so the corner to test is picked once per plane.
+    for(; i + 4 <= count; i += 4) {
+        const Aabb *b = boxes + i;
+        __m128 min_x = _mm_setr_ps(b[0].min.x, b[1].min.x, b[2].min.x, b[3].min.x);
+        __m128 min_y = _mm_setr_ps(b[0].min.y, b[1].min.y, b[2].min.y, b[3].min.y);
+        __m128 min_z = _mm_setr_ps(b[0].min.z, b[1].min.z, b[2].min.z, b[3].min.z);
+        __m128 max_x = _mm_setr_ps(b[0].max.x, b[1].max.x, b[2].max.x, b[3].max.x);
+        __m128 max_y = _mm_setr_ps(b[0].max.y, b[1].max.y, b[2].max.y, b[3].max.y);
+        __m128 max_z = _mm_setr_ps(b[0].max.z, b[1].max.z, b[2].max.z, b[3].max.z);
+
+        __m128 outside = _mm_setzero_ps();
+        for(const glm::vec4 &plane : frustum.planes) {
+            __m128 x = plane.x >= 0.f ? max_x : min_x;
+            __m128 y = plane.y >= 0.f ? max_y : min_y;
+            __m128 z = plane.z >= 0.f ? max_z : min_z;
+
+            // Same order of operations as MaxPlaneDistance, so both paths agree on boxes touching a plane
+            __m128 distance = _mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(plane.x)), _mm_mul_ps(y, _mm_set1_ps(plane.y)));
+            distance = _mm_add_ps(distance, _mm_mul_ps(z, _mm_set1_ps(plane.z)));
+            distance = _mm_add_ps(distance, _mm_set1_ps(plane.w));
+            outside = _mm_or_ps(outside, _mm_cmplt_ps(distance, _mm_setzero_ps()));
+        }
+
+        int outside_mask = _mm_movemask_ps(outside);
+        for(int lane = 0; lane < 4; lane++) {
+            visible[i + lane] = (outside_mask >> lane) & 1 ? 0 : 1;
+        }
+    }
+#endif
+
+    for(; i < count; i++) {
+        visible[i] = frustum.Intersects(boxes[i]) ? 1 : 0;
+    }
+}
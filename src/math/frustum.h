@@ -0,0 +1,42 @@
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+
+struct Aabb {
+    glm::vec3 min;
+    glm::vec3 max;
+};
+
+// Smallest box around the points
+Aabb ComputeAabb(const glm::vec3 *points, size_t count, size_t stride = sizeof(glm::vec3));
+
+// Smallest box around the transformed box, without transforming its eight corners
+Aabb TransformAabb(const Aabb &box, const glm::mat4 &transform);
+
+// Six planes (a, b, c, d) with normals pointing inwards, a point p is inside
+// every plane with dot(plane, vec4(p, 1)) >= 0
+struct Frustum {
+    enum Plane { Left, Right, Bottom, Top, Near, Far, PlaneCount };
+
+    glm::vec4 planes[PlaneCount];
+
+    // Planes of the clip volume of a view-projection matrix, in the space the matrix maps from
+    static Frustum FromMatrix(const glm::mat4 &view_projection);
+
+    // Moves the planes into the object space of a model matrix, so local boxes
+    // can be tested without transforming them. The planes are no longer normalized.
+    Frustum ToObjectSpace(const glm::mat4 &model) const;
+
+    // Conservative, boxes near the frustum corners may pass although they are outside
+    bool Intersects(const Aabb &box) const;
+};
+
+// Sets visible[i] to 1 if boxes[i] intersects the frustum and to 0 otherwise.
+// Tests four boxes at a time with SSE where it is available.
+void CullAabbs(const Frustum &frustum, const Aabb *boxes, size_t count, uint8_t *visible);
+
+#endif // FRUSTUM_H
@@ -0,0 +1,46 @@
+#ifndef PACKING_H
+#define PACKING_H
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+// Octahedral normal encoding folded around the y axis, so upward facing
+// normals (most of the terrain) get the most precision. Both components are
+// in [-1, 1]; the shaders decode with the matching DecodeOctahedral.
+inline glm::vec2 OctahedralEncode(glm::vec3 n)
+{
+    n /= std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+    glm::vec2 p(n.x, n.z);
+
+    if(n.y < 0.f) {
+        p = glm::vec2((1.f - std::abs(n.z)) * (n.x >= 0.f ? 1.f : -1.f),
+                      (1.f - std::abs(n.x)) * (n.z >= 0.f ? 1.f : -1.f));
+    }
+
+    return p;
+}
+
+// Inverse of OctahedralEncode, matches DecodeOctahedral in the shaders
+inline glm::vec3 OctahedralDecode(glm::vec2 p)
+{
+    glm::vec3 n(p.x, 1.f - std::abs(p.x) - std::abs(p.y), p.y);
+    float t = std::max(-n.y, 0.f);
+    n.x += n.x >= 0.f ? -t : t;
+    n.z += n.z >= 0.f ? -t : t;
+    return glm::normalize(n);
+}
+
+inline int8_t PackSnorm8(float value)
+{
+    return static_cast<int8_t>(std::lround(std::clamp(value, -1.f, 1.f) * 127.f));
+}
+
+inline uint16_t PackUnorm16(float value)
+{
+    return static_cast<uint16_t>(std::lround(std::clamp(value, 0.f, 1.f) * 65535.f));
+}
+
+#endif // PACKING_H
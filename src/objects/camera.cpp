@@ -1,5 +1,7 @@
 #include "camera.h"
 
+#include <algorithm>
+#include <cmath>
 #include <iostream>
 
 
@@ -65,6 +67,19 @@ void Camera::ProcessMouseInput(float x_offset, float y_offset, bool constrain_pi
     UpdateCameraVectors();
 }
 
+void Camera::LookAt(glm::vec3 target) {
+    glm::vec3 direction = target - position_;
+    if(glm::length(direction) <= 0.f) {
+        return;
+    }
+    direction = glm::normalize(direction);
+
+    // Inverse of the angles UpdateCameraVectors turns into the front vector
+    pitch_ = glm::degrees(std::asin(std::clamp(direction.y, -1.f, 1.f)));
+    yaw_ = glm::degrees(std::atan2(direction.z, direction.x));
+    UpdateCameraVectors();
+}
+
 void Camera::UpdateCameraVectors() {
     glm::vec3 front;
     front.x = cos(glm::radians(yaw_)) * cos(glm::radians(pitch_));
@@ -76,13 +91,3 @@ void Camera::UpdateCameraVectors() {
     up_    = glm::normalize(glm::cross(right_, front_));
 }
 
-
-void Camera::UpdateShader(std::unique_ptr<ShaderProgram> &shader) {
-    glm::mat4 view = GetViewMat();
-
-    glm::mat4 projection = glm::perspective(glm::radians(45.0f), aspect_ratio_, near_z_, far_z_);
-
-    shader->SetMat4Uniform("projection", projection);
-    shader->SetMat4Uniform("view", view);
-    shader->SetVec3Uniform("viewPos", position_.x, position_.y, position_.z);
-}
\ No newline at end of file
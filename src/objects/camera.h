@@ -5,6 +5,7 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+#include "../math/frustum.h"
 #include "../utils/shader.h"
 
 
@@ -46,7 +47,7 @@ public:
 
     Camera(float pos_x, float pos_y, float pos_z, float up_x, float up_y, float up_z, float yaw, float pitch, float fov, float ratio, float near_z, float far_z);
 
-    glm::mat4 GetViewMat() {
+    glm::mat4 GetViewMat() const {
         return glm::lookAt(
             position_,
             position_ + front_,
@@ -54,12 +55,21 @@ public:
         );
     }
 
+    glm::mat4 GetProjectionMat() const {
+        return glm::perspective(glm::radians(kZoom), aspect_ratio_, near_z_, far_z_);
+    }
+
+    // World space planes of the camera's view volume
+    Frustum GetFrustum() const {
+        return Frustum::FromMatrix(GetProjectionMat() * GetViewMat());
+    }
+
     void ProcessKeyboard(CameraMovement direction, float delta_time);
 
     void ProcessMouseInput(float x_offset, float y_offset, bool constrain_pitch);
 
-    void UpdateShader(std::unique_ptr<ShaderProgram> &shader);
-
+    // Turns the camera towards the point, keeping its position
+    void LookAt(glm::vec3 target);
 
 private:
     void UpdateCameraVectors();
@@ -0,0 +1,90 @@
+#include "camera_path.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+CameraPath::CameraPath(std::vector<CameraKeyframe> keyframes) : keyframes_(std::move(keyframes))
+{
+    std::sort(keyframes_.begin(), keyframes_.end(), [] (const CameraKeyframe &a, const CameraKeyframe &b) { return a.time < b.time; });
+}
+
+bool CameraPath::Load(const std::filesystem::path &path)
+{
+    std::ifstream file(path);
+    if(!file) {
+        std::cout << "Failed to open camera path: " << path.string() << std::endl;
+        return false;
+    }
+
+    std::vector<CameraKeyframe> keyframes;
+    std::string line;
+    for(int line_number = 1; std::getline(file, line); line_number++) {
+        line = line.substr(0, line.find('#'));
+        if(line.find_first_not_of(" \t\r") == std::string::npos) {
+            continue;
+        }
+
+        std::istringstream stream(line);
+        CameraKeyframe keyframe;
+        if(!(stream >> keyframe.time >> keyframe.position.x >> keyframe.position.y >> keyframe.position.z
+                    >> keyframe.target.x >> keyframe.target.y >> keyframe.target.z)) {
+            std::cout << path.string() << ":" << line_number << ": expected time x y z target_x target_y target_z" << std::endl;
+            return false;
+        }
+        keyframes.push_back(keyframe);
+    }
+
+    *this = CameraPath(std::move(keyframes));
+    return true;
+}
+
+CameraPath CameraPath::Orbit(glm::vec3 center, float radius, float height, float duration, int steps)
+{
+    std::vector<CameraKeyframe> keyframes;
+    for(int i = 0; i <= steps; i++) {
+        float angle = 2.f * 3.14159265f * i / steps;
+        glm::vec3 position = center + glm::vec3(std::cos(angle) * radius, height, std::sin(angle) * radius);
+        keyframes.push_back({duration * i / steps, position, center});
+    }
+    return CameraPath(std::move(keyframes));
+}
+
+float CameraPath::GetDuration() const
+{
+    return keyframes_.empty() ? 0.f : keyframes_.back().time;
+}
+
+void CameraPath::Apply(Camera &camera, float time) const
+{
+    if(keyframes_.empty()) {
+        return;
+    }
+
+    float duration = GetDuration();
+    if(duration > 0.f) {
+        time = std::fmod(time, duration);
+    }
+
+    auto next = std::upper_bound(keyframes_.begin(), keyframes_.end(), time,
+                                 [] (float time, const CameraKeyframe &keyframe) { return time < keyframe.time; });
+    if(next == keyframes_.begin()) {
+        next++;
+    }
+    if(next == keyframes_.end()) {
+        camera.position_ = keyframes_.back().position;
+        camera.LookAt(keyframes_.back().target);
+        return;
+    }
+
+    const CameraKeyframe &from = *(next - 1);
+    const CameraKeyframe &to = *next;
+    float span = to.time - from.time;
+    float t = span > 0.f ? std::clamp((time - from.time) / span, 0.f, 1.f) : 1.f;
+
+    camera.position_ = from.position + (to.position - from.position) * t;
+    camera.LookAt(from.target + (to.target - from.target) * t);
+}
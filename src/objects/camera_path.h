@@ -0,0 +1,41 @@
+#ifndef CAMERA_PATH_H
+#define CAMERA_PATH_H
+
+#include <glm/glm.hpp>
+
+#include <filesystem>
+#include <vector>
+
+#include "camera.h"
+
+struct CameraKeyframe {
+    // Seconds since the start of the path
+    float time;
+    glm::vec3 position;
+    glm::vec3 target;
+};
+
+// Scripted camera flight for reproducible runs. Position and look-at target
+// are interpolated linearly between keyframes, the path loops once its last
+// keyframe is passed.
+class CameraPath {
+public:
+    CameraPath() = default;
+    explicit CameraPath(std::vector<CameraKeyframe> keyframes);
+
+    // One keyframe per line: time x y z target_x target_y target_z, '#' starts a comment
+    bool Load(const std::filesystem::path &path);
+
+    // Keyframes on a circle around center, facing it
+    static CameraPath Orbit(glm::vec3 center, float radius, float height, float duration, int steps = 32);
+
+    bool IsEmpty() const { return keyframes_.empty(); };
+    float GetDuration() const;
+
+    void Apply(Camera &camera, float time) const;
+
+private:
+    std::vector<CameraKeyframe> keyframes_;
+};
+
+#endif // CAMERA_PATH_H
@@ -15,10 +15,10 @@ private:
 public:
     DirectionalLight();
     DirectionalLight(vec3, vec3, vec3, vec3);
-    vec3 GetDirection() { return direction_; };
-    vec3 GeAmbient() { return ambient_; };
-    vec3 GetDiffuse() { return diffuse_; };
-    vec3 GetSpecular() { return specular_; };
+    vec3 GetDirection() const { return direction_; };
+    vec3 GetAmbient() const { return ambient_; };
+    vec3 GetDiffuse() const { return diffuse_; };
+    vec3 GetSpecular() const { return specular_; };
 };
 
 #endif // DIR_LIGHT_H
\ No newline at end of file
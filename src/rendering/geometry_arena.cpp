@@ -0,0 +1,280 @@
+#include "geometry_arena.h"
+#include "gl_state_cache.h"
+#include "instance_buffer.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+size_t AlignUp(size_t value, size_t alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+GLuint CreateBuffer(size_t capacity)
+{
+    GLuint buffer = 0;
+    glGenBuffers(1, &buffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+    glBufferData(GL_COPY_WRITE_BUFFER, capacity, nullptr, GL_STATIC_DRAW);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    return buffer;
+}
+}
+
+size_t GeometryArena::BufferRanges::Allocate(size_t size, size_t alignment)
+{
+    for(auto it = free.begin(); it != free.end(); it++) {
+        size_t range_offset = it->first;
+        size_t range_size = it->second;
+        size_t offset = AlignUp(range_offset, alignment);
+        if(offset + size > range_offset + range_size) {
+            continue;
+        }
+
+        free.erase(it);
+        if(offset > range_offset) {
+            free[range_offset] = offset - range_offset;
+        }
+        if(offset + size < range_offset + range_size) {
+            free[offset + size] = range_offset + range_size - offset - size;
+        }
+        return offset;
+    }
+    return SIZE_MAX;
+}
+
+void GeometryArena::BufferRanges::Free(size_t offset, size_t size)
+{
+    auto next = free.lower_bound(offset);
+    if(next != free.end() && offset + size == next->first) {
+        size += next->second;
+        next = free.erase(next);
+    }
+    if(next != free.begin()) {
+        auto previous = std::prev(next);
+        if(previous->first + previous->second == offset) {
+            previous->second += size;
+            return;
+        }
+    }
+    free[offset] = size;
+}
+
+GeometryArena::GeometryArena(GLsizei vertex_stride, AttributeSetup setup_attributes, size_t initial_vertex_bytes, size_t initial_index_bytes)
+    : vertex_stride_(vertex_stride), setup_attributes_(setup_attributes)
+{
+    vertices_.capacity = AlignUp(initial_vertex_bytes, vertex_stride_);
+    vertices_.buffer = CreateBuffer(vertices_.capacity);
+    vertices_.free[0] = vertices_.capacity;
+
+    indices_.capacity = AlignUp(initial_index_bytes, sizeof(uint32_t));
+    indices_.buffer = CreateBuffer(indices_.capacity);
+    indices_.free[0] = indices_.capacity;
+
+    glGenVertexArrays(1, &vao_);
+    glGenVertexArrays(1, &instanced_vao_);
+    SetupVertexArray();
+
+    indirect_ = SupportsMultiDrawIndirect();
+    if(indirect_) {
+        glGenBuffers(1, &indirect_buffer_);
+    }
+}
+
+GeometryArena::~GeometryArena()
+{
+    GlStateCache *state = GlStateCache::Instance();
+    state->ForgetVertexArray(vao_);
+    state->ForgetVertexArray(instanced_vao_);
+    glDeleteVertexArrays(1, &vao_);
+    glDeleteVertexArrays(1, &instanced_vao_);
+    glDeleteBuffers(1, &vertices_.buffer);
+    glDeleteBuffers(1, &indices_.buffer);
+    if(indirect_buffer_) {
+        glDeleteBuffers(1, &indirect_buffer_);
+    }
+}
+
+bool GeometryArena::SupportsMultiDrawIndirect()
+{
+    if(!glMultiDrawElementsIndirect) {
+        return false;
+    }
+
+    if(gl3wIsSupported(4, 3)) {
+        return true;
+    }
+
+    GLint extension_count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &extension_count);
+    for(GLint i = 0; i < extension_count; i++) {
+        const char *extension = reinterpret_cast<const char *>(glGetStringi(GL_EXTENSIONS, i));
+        if(extension && std::strcmp(extension, "GL_ARB_multi_draw_indirect") == 0) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void GeometryArena::SetupVertexArray()
+{
+    GlStateCache *state = GlStateCache::Instance();
+    for(GLuint vao : {vao_, instanced_vao_}) {
+        state->BindVertexArray(vao);
+        glBindBuffer(GL_ARRAY_BUFFER, vertices_.buffer);
+        setup_attributes_();
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indices_.buffer);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void GeometryArena::Grow(BufferRanges &ranges, size_t required_size)
+{
+    size_t old_capacity = ranges.capacity;
+    size_t new_capacity = std::max(old_capacity * 2, old_capacity + required_size);
+    new_capacity = AlignUp(new_capacity, &ranges == &vertices_ ? vertex_stride_ : sizeof(uint32_t));
+
+    // The copy runs on the GPU, in order with the draws still reading the old buffer
+    GLuint new_buffer = CreateBuffer(new_capacity);
+    glBindBuffer(GL_COPY_READ_BUFFER, ranges.buffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, new_buffer);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, old_capacity);
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    glDeleteBuffers(1, &ranges.buffer);
+
+    ranges.buffer = new_buffer;
+    ranges.capacity = new_capacity;
+    ranges.Free(old_capacity, new_capacity - old_capacity);
+
+    SetupVertexArray();
+}
+
+GeometryAllocation GeometryArena::Allocate(const void *vertices, size_t vertex_count, const uint32_t *indices, size_t index_count)
+{
+    GeometryAllocation allocation;
+    if(vertex_count == 0) {
+        return allocation;
+    }
+
+    allocation.vertex_size = vertex_count * vertex_stride_;
+    allocation.index_size = index_count * sizeof(uint32_t);
+
+    // Vertex ranges start on whole vertices, so their offset turns into a base vertex
+    allocation.vertex_offset = vertices_.Allocate(allocation.vertex_size, vertex_stride_);
+    if(allocation.vertex_offset == SIZE_MAX) {
+        Grow(vertices_, allocation.vertex_size);
+        allocation.vertex_offset = vertices_.Allocate(allocation.vertex_size, vertex_stride_);
+    }
+
+    allocation.index_offset = 0;
+    if(allocation.index_size > 0) {
+        allocation.index_offset = indices_.Allocate(allocation.index_size, sizeof(uint32_t));
+        if(allocation.index_offset == SIZE_MAX) {
+            Grow(indices_, allocation.index_size);
+            allocation.index_offset = indices_.Allocate(allocation.index_size, sizeof(uint32_t));
+        }
+    }
+
+    allocation.base_vertex = static_cast<GLint>(allocation.vertex_offset / vertex_stride_);
+    allocation.first_index = static_cast<GLuint>(allocation.index_offset / sizeof(uint32_t));
+    allocation.index_count = static_cast<GLsizei>(index_count);
+
+    // Written through the copy target, binding the element buffer would change the bound VAO
+    glBindBuffer(GL_COPY_WRITE_BUFFER, vertices_.buffer);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, allocation.vertex_offset, allocation.vertex_size, vertices);
+    if(allocation.index_size > 0) {
+        glBindBuffer(GL_COPY_WRITE_BUFFER, indices_.buffer);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, allocation.index_offset, allocation.index_size, indices);
+    }
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    return allocation;
+}
+
+void GeometryArena::Free(const GeometryAllocation &allocation)
+{
+    if(!allocation.IsValid()) {
+        return;
+    }
+
+    vertices_.Free(allocation.vertex_offset, allocation.vertex_size);
+    if(allocation.index_size > 0) {
+        indices_.Free(allocation.index_offset, allocation.index_size);
+    }
+}
+
+void GeometryArena::Bind() const
+{
+    GlStateCache::Instance()->BindVertexArray(vao_);
+}
+
+void GeometryArena::BindInstances(GLuint buffer, size_t offset)
+{
+    // Without base instance (GL 4.2) the instance range is picked through the attribute offsets
+    GlStateCache::Instance()->BindVertexArray(instanced_vao_);
+    InstanceBuffer::SetupAttributes(buffer, offset);
+}
+
+void GeometryArena::Draw(const GeometryAllocation &allocation) const
+{
+    glDrawElementsBaseVertex(GL_TRIANGLES, allocation.index_count, GL_UNSIGNED_INT,
+                             reinterpret_cast<const void *>(allocation.index_offset), allocation.base_vertex);
+}
+
+void GeometryArena::SetDrawCommands(const DrawElementsIndirectCommand *commands, size_t count)
+{
+    if(!indirect_) {
+        commands_.assign(commands, commands + count);
+        return;
+    }
+
+    size_t size = count * sizeof(DrawElementsIndirectCommand);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirect_buffer_);
+    if(size > indirect_capacity_) {
+        indirect_capacity_ = std::max(size, indirect_capacity_ * 2);
+    }
+    // Orphaned every pass, the previous commands may still be read by the GPU
+    glBufferData(GL_DRAW_INDIRECT_BUFFER, indirect_capacity_, nullptr, GL_STREAM_DRAW);
+    glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, size, commands);
+}
+
+void GeometryArena::MultiDraw(size_t first_command, size_t command_count)
+{
+    if(command_count == 0) {
+        return;
+    }
+
+    if(indirect_) {
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirect_buffer_);
+        glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT,
+                                    reinterpret_cast<const void *>(first_command * sizeof(DrawElementsIndirectCommand)),
+                                    static_cast<GLsizei>(command_count), 0);
+        return;
+    }
+
+    const DrawElementsIndirectCommand *commands = commands_.data() + first_command;
+    if(commands->instance_count != 1) {
+        for(size_t i = 0; i < command_count; i++) {
+            glDrawElementsInstancedBaseVertex(GL_TRIANGLES, commands[i].count, GL_UNSIGNED_INT,
+                                              reinterpret_cast<const void *>(commands[i].first_index * sizeof(uint32_t)),
+                                              commands[i].instance_count, commands[i].base_vertex);
+        }
+        return;
+    }
+
+    counts_.clear();
+    index_offsets_.clear();
+    base_vertices_.clear();
+    for(size_t i = first_command; i < first_command + command_count; i++) {
+        const DrawElementsIndirectCommand &command = commands_[i];
+        counts_.push_back(static_cast<GLsizei>(command.count));
+        index_offsets_.push_back(reinterpret_cast<const void *>(command.first_index * sizeof(uint32_t)));
+        base_vertices_.push_back(command.base_vertex);
+    }
+
+    glMultiDrawElementsBaseVertex(GL_TRIANGLES, counts_.data(), GL_UNSIGNED_INT, index_offsets_.data(),
+                                  static_cast<GLsizei>(command_count), base_vertices_.data());
+}
@@ -0,0 +1,106 @@
+#ifndef GEOMETRY_ARENA_H
+#define GEOMETRY_ARENA_H
+
+#include <GL/gl3w.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <vector>
+
+// Where a mesh lives in its arena
+struct GeometryAllocation {
+    size_t vertex_offset = 0;
+    size_t vertex_size = 0;
+    size_t index_offset = 0;
+    size_t index_size = 0;
+
+    GLint base_vertex = 0;
+    GLuint first_index = 0;
+    GLsizei index_count = 0;
+
+    bool IsValid() const { return vertex_size != 0; };
+};
+
+// Layout glMultiDrawElementsIndirect reads its commands in
+struct DrawElementsIndirectCommand {
+    GLuint count;
+    GLuint instance_count;
+    GLuint first_index;
+    GLint base_vertex;
+    GLuint base_instance;
+};
+
+// Static geometry of one vertex format, suballocated from one vertex and one
+// index buffer behind a single VAO. Meshes are drawn with their base vertex
+// and first index, so any number of them draw without rebinding buffers.
+// Buffers grow by copying on the GPU when full. Context thread only.
+class GeometryArena {
+public:
+    // Sets the attribute pointers of the format, relative to offset 0 of the bound GL_ARRAY_BUFFER
+    using AttributeSetup = void (*)();
+
+    GeometryArena(GLsizei vertex_stride, AttributeSetup setup_attributes,
+                  size_t initial_vertex_bytes = 16 << 20, size_t initial_index_bytes = 8 << 20);
+    ~GeometryArena();
+
+    GeometryArena(const GeometryArena &) = delete;
+    void operator=(const GeometryArena &) = delete;
+
+    GeometryAllocation Allocate(const void *vertices, size_t vertex_count, const uint32_t *indices, size_t index_count);
+    void Free(const GeometryAllocation &allocation);
+
+    void Bind() const;
+    // Binds the arena's instanced VAO with its instance attributes at offset of buffer, see InstanceBuffer
+    void BindInstances(GLuint buffer, size_t offset);
+    // Draws one allocation, the arena has to be bound
+    void Draw(const GeometryAllocation &allocation) const;
+
+    // Uploads the commands of a pass, MultiDraw then draws consecutive runs of them
+    void SetDrawCommands(const DrawElementsIndirectCommand *commands, size_t count);
+    // One glMultiDrawElementsIndirect when the context has it, otherwise one
+    // glMultiDrawElementsBaseVertex, which is core since 3.2. Instanced
+    // commands fall back to a glDrawElementsInstancedBaseVertex each.
+    void MultiDraw(size_t first_command, size_t command_count);
+
+    bool UsesIndirectDraws() const { return indirect_; };
+    GLuint GetVertexArray() const { return vao_; };
+
+private:
+    // First fit over the free ranges of a buffer, neighbours are merged on free
+    struct BufferRanges {
+        GLuint buffer = 0;
+        size_t capacity = 0;
+        // Offset to size
+        std::map<size_t, size_t> free;
+
+        // Returns SIZE_MAX when no range fits
+        size_t Allocate(size_t size, size_t alignment);
+        void Free(size_t offset, size_t size);
+    };
+
+    GLsizei vertex_stride_;
+    AttributeSetup setup_attributes_;
+    GLuint vao_ = 0;
+    // Same vertex layout plus the per-instance attributes
+    GLuint instanced_vao_ = 0;
+    BufferRanges vertices_;
+    BufferRanges indices_;
+
+    bool indirect_ = false;
+    GLuint indirect_buffer_ = 0;
+    size_t indirect_capacity_ = 0;
+    std::vector<DrawElementsIndirectCommand> commands_;
+
+    // Scratch arrays for the glMultiDrawElementsBaseVertex path
+    std::vector<GLsizei> counts_;
+    std::vector<const void *> index_offsets_;
+    std::vector<GLint> base_vertices_;
+
+    void Grow(BufferRanges &ranges, size_t required_size);
+    void SetupVertexArray();
+
+    static bool SupportsMultiDrawIndirect();
+};
+
+#endif // GEOMETRY_ARENA_H
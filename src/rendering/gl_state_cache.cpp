@@ -0,0 +1,85 @@
+#include "gl_state_cache.h"
+
+GlStateCache *GlStateCache::gl_state_cache_ = nullptr;
+
+GlStateCache *GlStateCache::Instance()
+{
+    if(!gl_state_cache_) gl_state_cache_ = new GlStateCache();
+    return gl_state_cache_;
+}
+
+void GlStateCache::UseProgram(GLuint program)
+{
+    if(program == program_) {
+        stats_.skipped_binds++;
+        return;
+    }
+
+    glUseProgram(program);
+    program_ = program;
+    stats_.program_binds++;
+}
+
+void GlStateCache::BindVertexArray(GLuint vertex_array)
+{
+    if(vertex_array == vertex_array_) {
+        stats_.skipped_binds++;
+        return;
+    }
+
+    glBindVertexArray(vertex_array);
+    vertex_array_ = vertex_array;
+    stats_.vertex_array_binds++;
+}
+
+void GlStateCache::BindTexture(GLuint unit, GLenum target, GLuint texture)
+{
+    // Units past the shadowed ones are always bound
+    if(unit < kTextureUnits) {
+        TextureBinding &binding = textures_[unit];
+        if(binding.target == target && binding.texture == texture) {
+            stats_.skipped_binds++;
+            return;
+        }
+        binding.target = target;
+        binding.texture = texture;
+    }
+
+    if(unit != active_unit_) {
+        glActiveTexture(GL_TEXTURE0 + unit);
+        active_unit_ = unit;
+    }
+    glBindTexture(target, texture);
+    stats_.texture_binds++;
+}
+
+void GlStateCache::ForgetProgram(GLuint program)
+{
+    if(program == program_) {
+        program_ = kUnknown;
+    }
+}
+
+void GlStateCache::ForgetVertexArray(GLuint vertex_array)
+{
+    if(vertex_array == vertex_array_) {
+        vertex_array_ = kUnknown;
+    }
+}
+
+void GlStateCache::ForgetTexture(GLuint texture)
+{
+    for(TextureBinding &binding : textures_) {
+        if(binding.texture == texture) {
+            binding = TextureBinding();
+        }
+    }
+}
+
+void GlStateCache::Invalidate()
+{
+    program_ = kUnknown;
+    vertex_array_ = kUnknown;
+    active_unit_ = kUnknown;
+    textures_.fill(TextureBinding());
+}
@@ -0,0 +1,68 @@
+#ifndef GL_STATE_CACHE_H
+#define GL_STATE_CACHE_H
+
+#include <GL/gl3w.h>
+
+#include <array>
+#include <cstdint>
+
+// Binds that were issued and skipped since the last ResetStats
+struct GlStateStats {
+    uint32_t program_binds = 0;
+    uint32_t vertex_array_binds = 0;
+    uint32_t texture_binds = 0;
+    uint32_t skipped_binds = 0;
+};
+
+// Shadows the program, vertex array and texture bindings of the context, so
+// binding what is already bound costs no GL call. Every bind of these has to
+// go through the cache, or be followed by Invalidate. Objects deleted while
+// cached have to be forgotten, their names are handed out again.
+// Has to be used on the context thread.
+class GlStateCache {
+private:
+    static GlStateCache *gl_state_cache_;
+
+public:
+    GlStateCache() = default;
+
+    GlStateCache(GlStateCache &other) = delete;
+
+    void operator=(const GlStateCache &) = delete;
+
+    static GlStateCache *Instance();
+
+    void UseProgram(GLuint program);
+    void BindVertexArray(GLuint vertex_array);
+    // Makes unit active only when the texture isn't bound to it already
+    void BindTexture(GLuint unit, GLenum target, GLuint texture);
+
+    void ForgetProgram(GLuint program);
+    void ForgetVertexArray(GLuint vertex_array);
+    void ForgetTexture(GLuint texture);
+
+    // Forgets everything, for code that changed the bindings behind the cache's back
+    void Invalidate();
+
+    const GlStateStats &GetStats() const { return stats_; };
+    void ResetStats() { stats_ = GlStateStats(); };
+
+private:
+    static constexpr GLuint kTextureUnits = 16;
+    // Never a GL name, so the first bind of anything is issued
+    static constexpr GLuint kUnknown = 0xFFFFFFFF;
+
+    struct TextureBinding {
+        GLenum target = 0;
+        GLuint texture = kUnknown;
+    };
+
+    GLuint program_ = kUnknown;
+    GLuint vertex_array_ = kUnknown;
+    GLuint active_unit_ = kUnknown;
+    std::array<TextureBinding, kTextureUnits> textures_ {};
+
+    GlStateStats stats_;
+};
+
+#endif // GL_STATE_CACHE_H
@@ -0,0 +1,70 @@
+#include "instance_buffer.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+
+InstanceBuffer *InstanceBuffer::instance_buffer_ = nullptr;
+
+InstanceBuffer *InstanceBuffer::Instance()
+{
+    if(!instance_buffer_) instance_buffer_ = new InstanceBuffer();
+    return instance_buffer_;
+}
+
+InstanceBuffer::~InstanceBuffer()
+{
+    if(buffer_) {
+        glDeleteBuffers(1, &buffer_);
+    }
+}
+
+size_t InstanceBuffer::Upload(const InstanceData *instances, size_t count)
+{
+    size_t size = count * sizeof(InstanceData);
+
+    if(!buffer_) {
+        glGenBuffers(1, &buffer_);
+    }
+
+    glBindBuffer(GL_COPY_WRITE_BUFFER, buffer_);
+    if(head_ + size > capacity_) {
+        capacity_ = std::max({capacity_, size, kInitialCapacity});
+        glBufferData(GL_COPY_WRITE_BUFFER, capacity_, nullptr, GL_STREAM_DRAW);
+        head_ = 0;
+    }
+
+    // Regions written since the last orphaning are never read by pending draws
+    void *pointer = glMapBufferRange(GL_COPY_WRITE_BUFFER, head_, size,
+                                     GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+    if(pointer) {
+        std::memcpy(pointer, instances, size);
+        glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+    } else {
+        glBufferSubData(GL_COPY_WRITE_BUFFER, head_, size, instances);
+    }
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    size_t offset = head_;
+    head_ += size;
+    return offset;
+}
+
+void InstanceBuffer::SetupAttributes(GLuint buffer, size_t offset)
+{
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    for(GLuint column = 0; column < 4; column++) {
+        GLuint location = kInstanceAttributeLocation + column;
+        glEnableVertexAttribArray(location);
+        glVertexAttribPointer(location, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData),
+                              reinterpret_cast<const void *>(offset + offsetof(InstanceData, model) + column * sizeof(glm::vec4)));
+        glVertexAttribDivisor(location, 1);
+    }
+
+    GLuint tint_location = kInstanceAttributeLocation + 4;
+    glEnableVertexAttribArray(tint_location);
+    glVertexAttribPointer(tint_location, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData),
+                          reinterpret_cast<const void *>(offset + offsetof(InstanceData, tint)));
+    glVertexAttribDivisor(tint_location, 1);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
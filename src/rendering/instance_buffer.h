@@ -0,0 +1,52 @@
+#ifndef INSTANCE_BUFFER_H
+#define INSTANCE_BUFFER_H
+
+#include <GL/gl3w.h>
+#include <glm/glm.hpp>
+
+#include <cstddef>
+
+// Per-instance vertex attributes, read with divisor 1 starting at
+// kInstanceAttributeLocation: four columns of the model matrix, then the tint
+struct InstanceData {
+    glm::mat4 model;
+    glm::vec4 tint = glm::vec4(1.f);
+};
+
+constexpr GLuint kInstanceAttributeLocation = 7;
+
+// Streaming vertex buffer the instances of every instanced draw are written
+// to. Uploads go to consecutive regions through unsynchronized maps; when the
+// buffer is used up it is orphaned, so the driver hands out fresh storage
+// instead of waiting for draws still reading the old one.
+class InstanceBuffer {
+private:
+    static InstanceBuffer *instance_buffer_;
+
+public:
+    InstanceBuffer() = default;
+    ~InstanceBuffer();
+
+    InstanceBuffer(InstanceBuffer &other) = delete;
+
+    void operator=(const InstanceBuffer &) = delete;
+
+    static InstanceBuffer *Instance();
+
+    // Returns the byte offset the instances were written to
+    size_t Upload(const InstanceData *instances, size_t count);
+
+    GLuint GetBuffer() const { return buffer_; };
+
+    // Points the instance attributes of the bound VAO at instances uploaded to offset
+    static void SetupAttributes(GLuint buffer, size_t offset);
+
+private:
+    static constexpr size_t kInitialCapacity = 4 << 20;
+
+    GLuint buffer_ = 0;
+    size_t capacity_ = 0;
+    size_t head_ = 0;
+};
+
+#endif // INSTANCE_BUFFER_H
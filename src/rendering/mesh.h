@@ -8,8 +8,13 @@
 #include <GL/gl3w.h>
 #include <GLFW/glfw3.h>
 
+#include "geometry_arena.h"
+#include "gl_state_cache.h"
+#include "vertex_layouts.h"
+#include "../math/frustum.h"
 #include "../utils/shader.h"
 
+#include <map>
 #include <string>
 #include <vector>
 
@@ -17,18 +22,6 @@
 
 using namespace std;
 
-#define MAX_BONE_INFLUENCE 4
-
-struct Vertex {
-    glm::vec3 Position;
-    glm::vec3 Normal;
-    glm::vec2 TexCoords;
-    glm::vec3 Tangent;
-    glm::vec3 Bitangent;
-	int m_BoneIDs[MAX_BONE_INFLUENCE];
-	float m_Weights[MAX_BONE_INFLUENCE];
-};
-
 struct Texture {
     unsigned int id;
     string type;
@@ -40,27 +33,122 @@ public:
     vector<Vertex>       vertices;
     vector<unsigned int> indices;
     vector<Texture>      textures;
-    unsigned int VAO;
 
-    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures)
+    // Packed layouts are uploaded quantized, the mesh's draws have to bind the same quantization
+    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures,
+         VertexLayout layout = VertexLayout::Full, const VertexQuantization &quantization = VertexQuantization())
     {
         this->vertices = vertices;
         this->indices = indices;
         this->textures = textures;
 
-        SetupMesh();
+        SetupMesh(this->vertices.data(), this->vertices.size(), this->indices.data(), this->indices.size(), layout, quantization);
+    }
+
+    // Uploads straight from memory the mesh doesn't keep, like a mapped model cache
+    Mesh(const Vertex *vertex_data, size_t vertex_count, const unsigned int *index_data, size_t index_count, vector<Texture> textures,
+         VertexLayout layout = VertexLayout::Full, const VertexQuantization &quantization = VertexQuantization())
+    {
+        this->textures = textures;
+
+        SetupMesh(vertex_data, vertex_count, index_data, index_count, layout, quantization);
     }
 
+    // Every mesh with the layout lives in its arena, created on first use
+    static GeometryArena &ArenaFor(VertexLayout layout)
+    {
+        static GeometryArena *arenas[static_cast<size_t>(VertexLayout::Count)] = {};
+
+        GeometryArena *&arena = arenas[static_cast<size_t>(layout)];
+        if(!arena)
+        {
+            switch(layout)
+            {
+                case VertexLayout::Packed:
+                    arena = new GeometryArena(VertexLayoutStride(layout), [] () { SetupVertexLayoutAttributes(VertexLayout::Packed); });
+                    break;
+                case VertexLayout::PackedSkinned:
+                    arena = new GeometryArena(VertexLayoutStride(layout), [] () { SetupVertexLayoutAttributes(VertexLayout::PackedSkinned); });
+                    break;
+                default:
+                    arena = new GeometryArena(VertexLayoutStride(layout), [] () { SetupVertexLayoutAttributes(VertexLayout::Full); });
+                    break;
+            }
+        }
+        return *arena;
+    }
+
+    GeometryArena &GetArena() const { return ArenaFor(layout_); }
+    VertexLayout GetLayout() const { return layout_; }
+
     void Draw(unique_ptr<ShaderProgram> &shader)
+    {
+        BindTextures(*shader);
+
+        GeometryArena &arena = GetArena();
+        arena.Bind();
+        arena.Draw(geometry_);
+    }
+
+    // Texture i goes to unit i, binds and sampler uniforms already in place are skipped
+    void BindTextures(ShaderProgram &shader)
+    {
+        if(shader.GetGeneration() != sampler_program_)
+            ResolveSamplerLocations(shader);
+
+        GlStateCache *state = GlStateCache::Instance();
+        for(unsigned int i = 0; i < textures.size(); i++)
+        {
+            shader.SetSamplerUniform(sampler_locations_[i], i);
+            state->BindTexture(i, GL_TEXTURE_2D, textures[i].id);
+        }
+    }
+
+    // Meshes sampling the same textures share an id, render queues sort by it
+    uint32_t GetMaterialId() const { return material_id_; }
+
+    DrawElementsIndirectCommand GetDrawCommand() const
+    {
+        return {static_cast<GLuint>(geometry_.index_count), 1, geometry_.first_index, geometry_.base_vertex, 0};
+    }
+
+    // Returns the geometry to the arena, copies of the mesh must not draw afterwards
+    void ReleaseGeometry()
+    {
+        GetArena().Free(geometry_);
+        geometry_ = GeometryAllocation();
+    }
+
+    // Object space bounds of the vertices, computed when the mesh is uploaded
+    const Aabb &GetBounds() const { return bounds_; }
+
+    void ClearMesh() {
+        vertices.clear();
+        indices.clear();
+        textures.clear();
+    }
+
+private:
+    GeometryAllocation geometry_;
+    VertexLayout layout_ = VertexLayout::Full;
+    Aabb bounds_;
+    uint32_t material_id_ = 0;
+    // Sampler uniform of every texture in the program they were resolved for
+    vector<GLint> sampler_locations_;
+    // Generation of that program, GL ids are reused once a program is deleted
+    std::uint64_t sampler_program_ = 0;
+
+    // Textures of a type bind to its numbered samplers in order, texture_diffuse1, texture_diffuse2, ...
+    void ResolveSamplerLocations(const ShaderProgram &shader)
     {
         unsigned int diffuseNr  = 1;
         unsigned int specularNr = 1;
         unsigned int normalNr   = 1;
         unsigned int heightNr   = 1;
+
+        sampler_locations_.clear();
         for(unsigned int i = 0; i < textures.size(); i++)
         {
-            glActiveTexture(GL_TEXTURE0 + i); 
-
             string number;
             string name = textures[i].type;
 
@@ -73,63 +161,40 @@ public:
              else if(name == "texture_height")
                 number = std::to_string(heightNr++); 
 
-            glUniform1i(glGetUniformLocation(shader->programId_, (name + number).c_str()), i);
-            glBindTexture(GL_TEXTURE_2D, textures[i].id);
+            sampler_locations_.push_back(shader.GetUniformLocation(name + number));
         }
-        
-        glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, static_cast<unsigned int>(indices.size()), GL_UNSIGNED_INT, 0);
-        glBindVertexArray(0);
-
-        glActiveTexture(GL_TEXTURE0);
-    }
-
-    void ClearMesh() {
-        vertices.clear();
-        indices.clear();
-        textures.clear();
+        sampler_program_ = shader.GetGeneration();
     }
 
-private:
-    unsigned int VBO, EBO;
-
-    void SetupMesh()
+    void SetupMesh(const Vertex *vertex_data, size_t vertex_count, const unsigned int *index_data, size_t index_count,
+                   VertexLayout layout, const VertexQuantization &quantization)
     {
-        glGenVertexArrays(1, &VAO);
-        glGenBuffers(1, &VBO);
-        glGenBuffers(1, &EBO);
-
-        glBindVertexArray(VAO);
-
-        glBindBuffer(GL_ARRAY_BUFFER, VBO);
-        
-        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);  
-
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
-
-       
-        glEnableVertexAttribArray(0);	
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
+        layout_ = layout;
+        bounds_ = ComputeAabb(&vertex_data->Position, vertex_count, sizeof(Vertex));
 
-        glEnableVertexAttribArray(1);	
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
-
-        glEnableVertexAttribArray(2);	
-        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
-
-        glEnableVertexAttribArray(3);
-        glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Tangent));
+        if(layout_ == VertexLayout::Full)
+        {
+            geometry_ = GetArena().Allocate(vertex_data, vertex_count, index_data, index_count);
+        }
+        else
+        {
+            vector<uint8_t> packed(vertex_count * VertexLayoutStride(layout_));
+            PackVertices(layout_, vertex_data, vertex_count, quantization, packed.data());
+            geometry_ = GetArena().Allocate(packed.data(), vertex_count, index_data, index_count);
+        }
+        material_id_ = RegisterMaterial(textures);
+    }
 
-        glEnableVertexAttribArray(4);
-        glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Bitangent));
+    static uint32_t RegisterMaterial(const vector<Texture> &textures)
+    {
+        static map<vector<unsigned int>, uint32_t> *materials = new map<vector<unsigned int>, uint32_t>();
 
-		glEnableVertexAttribArray(5);
-		glVertexAttribIPointer(5, 4, GL_INT, sizeof(Vertex), (void*)offsetof(Vertex, m_BoneIDs));
+        vector<unsigned int> texture_ids;
+        for(const Texture &texture : textures)
+            texture_ids.push_back(texture.id);
 
-		glEnableVertexAttribArray(6);
-		glVertexAttribPointer(6, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, m_Weights));
-        glBindVertexArray(0);
+        auto material = materials->try_emplace(texture_ids, static_cast<uint32_t>(materials->size())).first;
+        return material->second;
     }
 };
 #endif
\ No newline at end of file
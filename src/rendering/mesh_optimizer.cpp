@@ -0,0 +1,273 @@
+#include "mesh_optimizer.h"
+
+#include <algorithm>
+#include <numeric>
+
+namespace {
+// Triangles using each vertex, as offsets into one flat list
+struct TriangleAdjacency {
+    std::vector<uint32_t> offsets;
+    std::vector<uint32_t> triangles;
+};
+
+TriangleAdjacency BuildAdjacency(const uint32_t *indices, size_t index_count, size_t vertex_count)
+{
+    TriangleAdjacency adjacency;
+    adjacency.offsets.assign(vertex_count + 1, 0);
+    for(size_t i = 0; i < index_count; i++) {
+        adjacency.offsets[indices[i] + 1]++;
+    }
+    std::partial_sum(adjacency.offsets.begin(), adjacency.offsets.end(), adjacency.offsets.begin());
+
+    std::vector<uint32_t> fill(adjacency.offsets.begin(), adjacency.offsets.end() - 1);
+    adjacency.triangles.resize(index_count);
+    for(size_t i = 0; i < index_count; i++) {
+        adjacency.triangles[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+    }
+    return adjacency;
+}
+
+// Simulated FIFO cache, a vertex is cached while fewer than size misses came after it
+class FifoCache {
+public:
+    FifoCache(size_t vertex_count, uint32_t size) : timestamps_(vertex_count, 0), size_(size), time_(size + 1) {}
+
+    // Returns true on a miss
+    bool Access(uint32_t vertex)
+    {
+        if(time_ - timestamps_[vertex] <= size_) {
+            return false;
+        }
+        timestamps_[vertex] = time_++;
+        return true;
+    }
+
+    bool Contains(uint32_t vertex) const { return time_ - timestamps_[vertex] <= size_; }
+
+    // Misses since the vertex was added, 1 for the one added last
+    uint32_t Age(uint32_t vertex) const { return time_ - timestamps_[vertex]; }
+
+    void Clear() { time_ += size_ + 1; }
+
+private:
+    std::vector<uint32_t> timestamps_;
+    uint32_t size_;
+    uint32_t time_;
+};
+}
+
+std::vector<uint32_t> OptimizeVertexCache(uint32_t *indices, size_t index_count, size_t vertex_count, uint32_t cache_size)
+{
+    std::vector<uint32_t> clusters;
+    size_t triangle_count = index_count / 3;
+    if(triangle_count == 0) {
+        return clusters;
+    }
+
+    TriangleAdjacency adjacency = BuildAdjacency(indices, index_count, vertex_count);
+
+    std::vector<uint32_t> live_triangles(vertex_count);
+    for(size_t i = 0; i < vertex_count; i++) {
+        live_triangles[i] = adjacency.offsets[i + 1] - adjacency.offsets[i];
+    }
+
+    std::vector<uint8_t> emitted(triangle_count, 0);
+    std::vector<uint32_t> dead_ends;
+    std::vector<uint32_t> candidates;
+    std::vector<uint32_t> output;
+    output.reserve(index_count);
+
+    FifoCache cache(vertex_count, cache_size);
+    uint32_t fan_vertex = indices[0];
+    size_t input_cursor = 0;
+
+    clusters.push_back(0);
+    while(true) {
+        // Emits every remaining triangle around the fanning vertex
+        candidates.clear();
+        for(uint32_t i = adjacency.offsets[fan_vertex]; i < adjacency.offsets[fan_vertex + 1]; i++) {
+            uint32_t triangle = adjacency.triangles[i];
+            if(emitted[triangle]) {
+                continue;
+            }
+
+            for(int corner = 0; corner < 3; corner++) {
+                uint32_t vertex = indices[triangle * 3 + corner];
+                output.push_back(vertex);
+                dead_ends.push_back(vertex);
+                candidates.push_back(vertex);
+                live_triangles[vertex]--;
+                cache.Access(vertex);
+            }
+            emitted[triangle] = 1;
+        }
+
+        // Fans next around the oldest candidate that stays cached while its remaining triangles are emitted
+        uint32_t next_vertex = UINT32_MAX;
+        int best_priority = -1;
+        for(uint32_t vertex : candidates) {
+            if(live_triangles[vertex] == 0) {
+                continue;
+            }
+
+            int priority = 0;
+            if(cache.Contains(vertex) && cache.Age(vertex) + 2 * live_triangles[vertex] <= cache_size) {
+                priority = static_cast<int>(cache.Age(vertex));
+            }
+            if(priority > best_priority) {
+                best_priority = priority;
+                next_vertex = vertex;
+            }
+        }
+
+        if(next_vertex == UINT32_MAX) {
+            // Dead end, recently used vertices first, then the first one in input order with triangles left
+            while(!dead_ends.empty() && next_vertex == UINT32_MAX) {
+                uint32_t vertex = dead_ends.back();
+                dead_ends.pop_back();
+                if(live_triangles[vertex] > 0) {
+                    next_vertex = vertex;
+                }
+            }
+            while(next_vertex == UINT32_MAX && input_cursor < index_count) {
+                uint32_t vertex = indices[input_cursor++];
+                if(live_triangles[vertex] > 0) {
+                    next_vertex = vertex;
+                }
+            }
+            if(next_vertex == UINT32_MAX) {
+                break;
+            }
+            clusters.push_back(static_cast<uint32_t>(output.size() / 3));
+        }
+
+        fan_vertex = next_vertex;
+    }
+
+    std::copy(output.begin(), output.end(), indices);
+    return clusters;
+}
+
+void OptimizeOverdraw(uint32_t *indices, size_t index_count, const std::vector<uint32_t> &clusters,
+                      const glm::vec3 *positions, size_t position_stride, size_t vertex_count,
+                      float threshold, uint32_t cache_size)
+{
+    size_t triangle_count = index_count / 3;
+    if(triangle_count == 0 || clusters.empty()) {
+        return;
+    }
+
+    auto position = [positions, position_stride] (uint32_t vertex) -> const glm::vec3 & {
+        return *reinterpret_cast<const glm::vec3 *>(reinterpret_cast<const uint8_t *>(positions) + vertex * position_stride);
+    };
+
+    // Soft boundaries, a cluster is cut wherever the misses so far are within threshold of its whole run
+    std::vector<uint32_t> soft_clusters;
+    FifoCache cache(vertex_count, cache_size);
+    for(size_t i = 0; i < clusters.size(); i++) {
+        uint32_t start = clusters[i];
+        uint32_t end = i + 1 < clusters.size() ? clusters[i + 1] : static_cast<uint32_t>(triangle_count);
+
+        cache.Clear();
+        uint32_t cluster_misses = 0;
+        for(uint32_t triangle = start; triangle < end; triangle++) {
+            for(int corner = 0; corner < 3; corner++) {
+                cluster_misses += cache.Access(indices[triangle * 3 + corner]);
+            }
+        }
+        float cluster_ratio = static_cast<float>(cluster_misses) / (end - start);
+
+        cache.Clear();
+        soft_clusters.push_back(start);
+        uint32_t misses = 0;
+        uint32_t soft_start = start;
+        for(uint32_t triangle = start; triangle < end; triangle++) {
+            for(int corner = 0; corner < 3; corner++) {
+                misses += cache.Access(indices[triangle * 3 + corner]);
+            }
+
+            float ratio = static_cast<float>(misses) / (triangle + 1 - soft_start);
+            if(triangle + 1 < end && ratio <= cluster_ratio * threshold) {
+                soft_clusters.push_back(triangle + 1);
+                soft_start = triangle + 1;
+                misses = 0;
+                cache.Clear();
+            }
+        }
+    }
+
+    // Area weighted center and normal of every cluster
+    glm::vec3 mesh_center(0.f);
+    float mesh_area = 0.f;
+    std::vector<glm::vec3> cluster_centers(soft_clusters.size(), glm::vec3(0.f));
+    std::vector<glm::vec3> cluster_normals(soft_clusters.size(), glm::vec3(0.f));
+    for(size_t i = 0; i < soft_clusters.size(); i++) {
+        uint32_t end = i + 1 < soft_clusters.size() ? soft_clusters[i + 1] : static_cast<uint32_t>(triangle_count);
+
+        float cluster_area = 0.f;
+        for(uint32_t triangle = soft_clusters[i]; triangle < end; triangle++) {
+            const glm::vec3 &a = position(indices[triangle * 3]);
+            const glm::vec3 &b = position(indices[triangle * 3 + 1]);
+            const glm::vec3 &c = position(indices[triangle * 3 + 2]);
+
+            glm::vec3 normal = glm::cross(b - a, c - a);
+            float area = glm::length(normal);
+
+            cluster_centers[i] += (a + b + c) * (area / 3.f);
+            cluster_normals[i] += normal;
+            cluster_area += area;
+        }
+
+        mesh_center += cluster_centers[i];
+        mesh_area += cluster_area;
+        cluster_centers[i] = cluster_area > 0.f ? cluster_centers[i] / cluster_area : position(indices[soft_clusters[i] * 3]);
+    }
+    mesh_center = mesh_area > 0.f ? mesh_center / mesh_area : glm::vec3(0.f);
+
+    std::vector<float> scores(soft_clusters.size());
+    for(size_t i = 0; i < soft_clusters.size(); i++) {
+        float normal_length = glm::length(cluster_normals[i]);
+        glm::vec3 normal = normal_length > 0.f ? cluster_normals[i] / normal_length : glm::vec3(0.f);
+        scores[i] = glm::dot(cluster_centers[i] - mesh_center, normal);
+    }
+
+    std::vector<uint32_t> order(soft_clusters.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&scores] (uint32_t a, uint32_t b) { return scores[a] > scores[b]; });
+
+    std::vector<uint32_t> reordered;
+    reordered.reserve(index_count);
+    for(uint32_t cluster : order) {
+        uint32_t end = cluster + 1 < soft_clusters.size() ? soft_clusters[cluster + 1] : static_cast<uint32_t>(triangle_count);
+        reordered.insert(reordered.end(), indices + soft_clusters[cluster] * 3, indices + end * 3);
+    }
+    std::copy(reordered.begin(), reordered.end(), indices);
+}
+
+std::vector<uint32_t> OptimizeVertexFetch(uint32_t *indices, size_t index_count, size_t vertex_count)
+{
+    std::vector<uint32_t> remap(vertex_count, UINT32_MAX);
+    uint32_t next_index = 0;
+    for(size_t i = 0; i < index_count; i++) {
+        uint32_t &index = remap[indices[i]];
+        if(index == UINT32_MAX) {
+            index = next_index++;
+        }
+        indices[i] = index;
+    }
+    return remap;
+}
+
+float AverageCacheMissRatio(const uint32_t *indices, size_t index_count, size_t vertex_count, uint32_t cache_size)
+{
+    if(index_count < 3) {
+        return 0.f;
+    }
+
+    FifoCache cache(vertex_count, cache_size);
+    uint32_t misses = 0;
+    for(size_t i = 0; i < index_count; i++) {
+        misses += cache.Access(indices[i]);
+    }
+    return static_cast<float>(misses) / (index_count / 3);
+}
@@ -0,0 +1,58 @@
+#ifndef MESH_OPTIMIZER_H
+#define MESH_OPTIMIZER_H
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Import time reordering of indexed triangle lists. Only the order of
+// triangles and vertices changes, the rendered result stays the same.
+
+// Post-transform cache entries the reordering plans for, small enough for every GPU we target
+constexpr uint32_t kVertexCacheSize = 16;
+
+// Reorders triangles so consecutive ones share vertices still in a FIFO cache
+// of cache_size (Tipsify, Sander et al. 2007). Returns the first triangle of
+// every cluster, clusters start wherever the walk had to jump.
+std::vector<uint32_t> OptimizeVertexCache(uint32_t *indices, size_t index_count, size_t vertex_count,
+                                          uint32_t cache_size = kVertexCacheSize);
+
+// Splits the clusters where their cache efficiency allows it and draws the
+// clusters facing away from the mesh center first, so they occlude the rest.
+// Costs at most threshold times the cache misses of the clusters.
+void OptimizeOverdraw(uint32_t *indices, size_t index_count, const std::vector<uint32_t> &clusters,
+                      const glm::vec3 *positions, size_t position_stride, size_t vertex_count,
+                      float threshold = 1.05f, uint32_t cache_size = kVertexCacheSize);
+
+// Numbers the vertices in the order the indices first use them and rewrites
+// the indices. Returns the new index of every old vertex, UINT32_MAX for
+// vertices no triangle uses.
+std::vector<uint32_t> OptimizeVertexFetch(uint32_t *indices, size_t index_count, size_t vertex_count);
+
+// Vertices missing a FIFO cache of cache_size per triangle, 0.5 is the best a large mesh can do
+float AverageCacheMissRatio(const uint32_t *indices, size_t index_count, size_t vertex_count,
+                            uint32_t cache_size = kVertexCacheSize);
+
+// Moves vertices to their slots from OptimizeVertexFetch, dropping the unused ones
+template <typename Vertex>
+std::vector<Vertex> RemapVertices(const std::vector<Vertex> &vertices, const std::vector<uint32_t> &remap)
+{
+    size_t used_count = 0;
+    for(uint32_t index : remap) {
+        if(index != UINT32_MAX) {
+            used_count++;
+        }
+    }
+
+    std::vector<Vertex> remapped(used_count);
+    for(size_t i = 0; i < vertices.size(); i++) {
+        if(remap[i] != UINT32_MAX) {
+            remapped[remap[i]] = vertices[i];
+        }
+    }
+    return remapped;
+}
+
+#endif // MESH_OPTIMIZER_H
@@ -3,28 +3,33 @@
 
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
-#include "../../dependencies/stb_image.h"
 #include <assimp/Importer.hpp>
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
 
+#include "instance_buffer.h"
 #include "mesh.h"
+#include "mesh_optimizer.h"
+#include "model_cache.h"
+#include "render_queue.h"
+#include "texture_cache.h"
+#include "uniform_buffers.h"
+#include "vertex_layouts.h"
+#include "../utils/profiler.h"
 #include "../utils/shader.h"
 
 #include <string>
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <algorithm>
 #include <map>
 #include <vector>
 using namespace std;
 
-unsigned int TextureFromFile(const char *path, const string &directory, bool gamma = false);
-
 class Model 
 {
 public:
-    vector<Texture> textures_loaded_;	
     vector<Mesh>    meshes_;
     string directory_;
     bool gamma_correction_;
@@ -32,19 +37,253 @@ public:
     Model(string const &path, bool gamma = false) : gamma_correction_(gamma)
     {
         LoadModel(path);
+        TextureCache::Instance()->FinishUploads();
+
+        for(const Mesh &mesh : meshes_)
+            mesh_bounds_.push_back(mesh.GetBounds());
+
+        bounds_ = {glm::vec3(0.f), glm::vec3(0.f)};
+        if(!mesh_bounds_.empty())
+        {
+            bounds_ = mesh_bounds_.front();
+            for(const Aabb &box : mesh_bounds_)
+            {
+                bounds_.min = glm::min(bounds_.min, box.min);
+                bounds_.max = glm::max(bounds_.max, box.max);
+            }
+        }
+
+        BuildBatches();
+    }
+
+    ~Model()
+    {
+        for(Mesh &mesh : meshes_)
+            mesh.ReleaseGeometry();
+    }
+
+    Model(const Model &) = delete;
+    void operator=(const Model &) = delete;
+
+    void Draw(unique_ptr<ShaderProgram> &shader, const glm::mat4 &model = glm::mat4(1.0f))
+    {
+        STEEL_PROFILE_SCOPE("Draw Model");
+        mesh_visible_.assign(meshes_.size(), 1);
+        if(!GatherDrawCommands(1))
+            return;
+
+        DrawBatches(shader, model, kNoInstances);
     }
 
-    void Draw(unique_ptr<ShaderProgram> &shader)
+    // Draws the meshes whose bounds intersect the frustum when the model is drawn with the model matrix
+    void Draw(unique_ptr<ShaderProgram> &shader, const Frustum &frustum, const glm::mat4 &model)
     {
+        STEEL_PROFILE_SCOPE("Draw Model");
+        mesh_visible_.resize(mesh_bounds_.size());
+        CullAabbs(frustum.ToObjectSpace(model), mesh_bounds_.data(), mesh_bounds_.size(), mesh_visible_.data());
+        if(!GatherDrawCommands(1))
+            return;
+
+        DrawBatches(shader, model, kNoInstances);
+    }
+
+    // Draws every mesh once per instance, the shader takes its model matrix and tint from the instance attributes
+    void DrawInstanced(unique_ptr<ShaderProgram> &shader, const InstanceData *instances, size_t count)
+    {
+        STEEL_PROFILE_SCOPE("Draw Model Instanced");
+        mesh_visible_.assign(meshes_.size(), 1);
+        if(count == 0 || !GatherDrawCommands(static_cast<GLuint>(count)))
+            return;
+
+        size_t offset = InstanceBuffer::Instance()->Upload(instances, count);
+        DrawBatches(shader, glm::mat4(1.0f), offset);
+    }
+
+    // Draws the instances whose transformed model bounds intersect the frustum
+    void DrawInstanced(unique_ptr<ShaderProgram> &shader, const Frustum &frustum, const InstanceData *instances, size_t count)
+    {
+        {
+            STEEL_PROFILE_SCOPE("Cull Instances");
+            instance_bounds_.resize(count);
+            for(size_t i = 0; i < count; i++)
+                instance_bounds_[i] = TransformAabb(bounds_, instances[i].model);
+
+            instance_visible_.resize(count);
+            CullAabbs(frustum, instance_bounds_.data(), count, instance_visible_.data());
+
+            visible_instances_.clear();
+            for(size_t i = 0; i < count; i++)
+            {
+                if(instance_visible_[i])
+                    visible_instances_.push_back(instances[i]);
+            }
+        }
+
+        DrawInstanced(shader, visible_instances_.data(), visible_instances_.size());
+    }
+
+    // Queues the meshes whose bounds intersect the frustum, depth sorted from view_position
+    void Submit(RenderQueue &queue, ShaderProgram &shader, const Frustum &frustum, const glm::mat4 &model, const glm::vec3 &view_position)
+    {
+        mesh_visible_.resize(mesh_bounds_.size());
+        CullAabbs(frustum.ToObjectSpace(model), mesh_bounds_.data(), mesh_bounds_.size(), mesh_visible_.data());
+
+        // Full layout meshes store float vertices, they get a transform without dequantization
+        uint32_t packed_transform = UINT32_MAX;
+        uint32_t full_transform = UINT32_MAX;
         for(unsigned int i = 0; i < meshes_.size(); i++)
-            meshes_[i].Draw(shader);
+        {
+            if(!mesh_visible_[i])
+                continue;
+
+            uint32_t transform;
+            if(meshes_[i].GetLayout() == VertexLayout::Full)
+            {
+                if(full_transform == UINT32_MAX)
+                    full_transform = queue.AddTransform(model);
+                transform = full_transform;
+            }
+            else
+            {
+                if(packed_transform == UINT32_MAX)
+                    packed_transform = queue.AddTransform(model, quantization_);
+                transform = packed_transform;
+            }
+
+            GeometryArena &arena = meshes_[i].GetArena();
+            glm::vec3 center = glm::vec3(model * glm::vec4((mesh_bounds_[i].min + mesh_bounds_[i].max) * .5f, 1.f));
+
+            DrawItem item;
+            item.sort_key = MakeSortKey(shader.programId_, meshes_[i].GetMaterialId(), arena.GetVertexArray(), glm::distance(center, view_position));
+            item.program = &shader;
+            item.transform = transform;
+            item.mesh = &meshes_[i];
+            item.arena = &arena;
+            item.command = meshes_[i].GetDrawCommand();
+            queue.Submit(std::move(item));
+        }
     }
-    
+
+    // Object space bounds of all meshes
+    const Aabb &GetBounds() const { return bounds_; };
+
 private:
+    // Object space bounds of the meshes, packed for batched culling
+    vector<Aabb> mesh_bounds_;
+    vector<uint8_t> mesh_visible_;
+    Aabb bounds_;
+    // Shared by all meshes, so the packed ones still draw with one multi-draw
+    VertexQuantization quantization_;
+
+    // Scratch arrays of the culled instanced draw
+    vector<Aabb> instance_bounds_;
+    vector<uint8_t> instance_visible_;
+    vector<InstanceData> visible_instances_;
+
+    // Meshes with the same layout and material, their visible ones are drawn
+    // with one multi-draw. Batches of a layout are next to each other.
+    vector<vector<unsigned int>> batches_;
+    vector<VertexLayout> batch_layouts_;
+    vector<DrawElementsIndirectCommand> draw_commands_;
+    vector<size_t> batch_command_counts_;
+
+    void BuildBatches()
+    {
+        vector<pair<VertexLayout, uint32_t>> batch_keys;
+        for(unsigned int i = 0; i < meshes_.size(); i++)
+        {
+            pair<VertexLayout, uint32_t> key(meshes_[i].GetLayout(), meshes_[i].GetMaterialId());
+            auto batch = std::lower_bound(batch_keys.begin(), batch_keys.end(), key);
+            if(batch == batch_keys.end() || *batch != key)
+            {
+                batches_.emplace(batches_.begin() + (batch - batch_keys.begin()));
+                batch = batch_keys.insert(batch, key);
+            }
+            batches_[batch - batch_keys.begin()].push_back(i);
+        }
+
+        for(const pair<VertexLayout, uint32_t> &key : batch_keys)
+            batch_layouts_.push_back(key.first);
+    }
+
+    // Collects the commands of the visible meshes by batch, returns false when nothing is visible
+    bool GatherDrawCommands(GLuint instance_count)
+    {
+        draw_commands_.clear();
+        batch_command_counts_.clear();
+        for(const vector<unsigned int> &batch : batches_)
+        {
+            size_t first = draw_commands_.size();
+            for(unsigned int mesh : batch)
+            {
+                if(!mesh_visible_[mesh])
+                    continue;
+
+                DrawElementsIndirectCommand command = meshes_[mesh].GetDrawCommand();
+                command.instance_count = instance_count;
+                draw_commands_.push_back(command);
+            }
+            batch_command_counts_.push_back(draw_commands_.size() - first);
+        }
+
+        return !draw_commands_.empty();
+    }
+
+    static constexpr size_t kNoInstances = SIZE_MAX;
+
+    // The commands of every layout go up in one upload to its arena, then every
+    // batch binds its textures and draws once. instance_offset is where the
+    // instances were uploaded to, kNoInstances for plain draws. Every layout
+    // writes the model matrix and its dequantization to the draw block.
+    void DrawBatches(unique_ptr<ShaderProgram> &shader, const glm::mat4 &model, size_t instance_offset)
+    {
+        size_t batch = 0;
+        size_t layout_first_command = 0;
+        while(batch < batches_.size())
+        {
+            VertexLayout layout = batch_layouts_[batch];
+            size_t layout_end = batch;
+            size_t layout_command_count = 0;
+            while(layout_end < batches_.size() && batch_layouts_[layout_end] == layout)
+                layout_command_count += batch_command_counts_[layout_end++];
+
+            if(layout_command_count > 0)
+            {
+                GeometryArena &arena = Mesh::ArenaFor(layout);
+                if(instance_offset == kNoInstances)
+                    arena.Bind();
+                else
+                    arena.BindInstances(InstanceBuffer::Instance()->GetBuffer(), instance_offset);
+                arena.SetDrawCommands(draw_commands_.data() + layout_first_command, layout_command_count);
+                UniformBuffers::Instance()->SetModel(model, layout == VertexLayout::Full ? VertexQuantization() : quantization_);
+
+                size_t first_command = 0;
+                for(size_t i = batch; i < layout_end; i++)
+                {
+                    if(batch_command_counts_[i] == 0)
+                        continue;
+
+                    meshes_[batches_[i].front()].BindTextures(*shader);
+                    arena.MultiDraw(first_command, batch_command_counts_[i]);
+                    first_command += batch_command_counts_[i];
+                }
+            }
+
+            batch = layout_end;
+            layout_first_command += layout_command_count;
+        }
+    }
+
     void LoadModel(string const &path)
     {
+        directory_ = path.substr(0, path.find_last_of('/'));
+
+        if(LoadModelCache(path))
+            return;
+
         Assimp::Importer importer;
-        const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
+        // Identical vertices are joined, or no two triangles would share one and reordering could gain nothing
+        const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_JoinIdenticalVertices | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
 
         if(!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) 
         {
@@ -52,27 +291,80 @@ private:
             return;
         }
 
-        directory_ = path.substr(0, path.find_last_of('/'));
+        vector<ImportedMesh> imported;
+        ProcessNode(scene->mRootNode, scene, imported);
+
+        VertexBounds vertex_bounds;
+        for(const ImportedMesh &mesh : imported)
+            vertex_bounds.Include(mesh.vertices.data(), mesh.vertices.size());
+        quantization_ = vertex_bounds.GetQuantization();
+
+        for(ImportedMesh &mesh : imported)
+        {
+            VertexLayout layout = ChooseVertexLayout(mesh.vertices.data(), mesh.vertices.size(), mesh.skinned);
+            meshes_.emplace_back(mesh.vertices, mesh.indices, mesh.textures, layout, quantization_);
+        }
+
+        if(!ModelCache::Write(path, meshes_))
+            cout << "WARNING::MODEL_CACHE:: could not write cache of " << path << endl;
+    }
+
+    // Skips Assimp when the model was imported before, vertices are uploaded from the mapped cache
+    bool LoadModelCache(string const &path)
+    {
+        ModelCache cache;
+        if(!cache.Open(path))
+            return false;
+
+        vector<vector<Texture>> material_textures;
+        for(const CachedMaterial &material : cache.GetMaterials())
+        {
+            vector<Texture> textures;
+            for(uint32_t i = 0; i < material.texture_count; i++)
+            {
+                const CachedTexture &texture = cache.GetTextures()[material.first_texture + i];
+                textures.push_back(LoadTexture(string(texture.path), string(texture.type)));
+            }
+            material_textures.push_back(textures);
+        }
+
+        VertexBounds vertex_bounds;
+        for(const CachedMesh &mesh : cache.GetMeshes())
+            vertex_bounds.Include(mesh.vertices, mesh.vertex_count);
+        quantization_ = vertex_bounds.GetQuantization();
 
-        ProcessNode(scene->mRootNode, scene);
+        for(const CachedMesh &mesh : cache.GetMeshes())
+            meshes_.emplace_back(mesh.vertices, mesh.vertex_count, mesh.indices, mesh.index_count, material_textures[mesh.material],
+                                 mesh.layout, quantization_);
+
+        return true;
     }
 
-    void ProcessNode(aiNode *node, const aiScene *scene)
+    // Meshes are kept on the CPU until the whole model is imported, the quantization spans all of them
+    struct ImportedMesh
+    {
+        vector<Vertex> vertices;
+        vector<unsigned int> indices;
+        vector<Texture> textures;
+        bool skinned;
+    };
+
+    void ProcessNode(aiNode *node, const aiScene *scene, vector<ImportedMesh> &imported)
     {
         for(unsigned int i = 0; i < node->mNumMeshes; i++)
         {
             aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-            meshes_.push_back(ProcessMesh(mesh, scene));
+            imported.push_back(ProcessMesh(mesh, scene));
         }
 
         for(unsigned int i = 0; i < node->mNumChildren; i++)
         {
-            ProcessNode(node->mChildren[i], scene);
+            ProcessNode(node->mChildren[i], scene, imported);
         }
 
     }
 
-    Mesh ProcessMesh(aiMesh *mesh, const aiScene *scene)
+    ImportedMesh ProcessMesh(aiMesh *mesh, const aiScene *scene)
     {
         vector<Vertex> vertices;
         vector<unsigned int> indices;
@@ -80,7 +372,8 @@ private:
 
         for(unsigned int i = 0; i < mesh->mNumVertices; i++)
         {
-            Vertex vertex;
+            // Zeroed, bone slots stay empty
+            Vertex vertex {};
             glm::vec3 vector;
 
             vector.x = mesh->mVertices[i].x;
@@ -141,8 +434,25 @@ private:
 
         std::vector<Texture> height_maps = LoadMaterialTextures(material, aiTextureType_AMBIENT, "texture_height");
         textures.insert(textures.end(), height_maps.begin(), height_maps.end());
+
+        // Meshes with point or line faces aren't whole triangles, they keep their order
+        if(mesh->mPrimitiveTypes == aiPrimitiveType_TRIANGLE && indices.size() % 3 == 0)
+            OptimizeMesh(vertices, indices);
         
-        return Mesh(vertices, indices, textures);
+        return {vertices, indices, textures, mesh->HasBones()};
+    }
+
+    // Runs once per import, the model cache keeps the optimized order
+    void OptimizeMesh(vector<Vertex> &vertices, vector<unsigned int> &indices)
+    {
+        if(indices.empty())
+            return;
+
+        vector<uint32_t> clusters = OptimizeVertexCache(indices.data(), indices.size(), vertices.size());
+        OptimizeOverdraw(indices.data(), indices.size(), clusters, &vertices[0].Position, sizeof(Vertex), vertices.size());
+
+        vector<uint32_t> remap = OptimizeVertexFetch(indices.data(), indices.size(), vertices.size());
+        vertices = RemapVertices(vertices, remap);
     }
 
     vector<Texture> LoadMaterialTextures(aiMaterial *mat, aiTextureType type, string type_name)
@@ -152,69 +462,20 @@ private:
         {
             aiString str;
             mat->GetTexture(type, i, &str);
-            bool skip = false;
-
-            for(unsigned int j = 0; j < textures_loaded_.size(); j++)
-            {
-                if(std::strcmp(textures_loaded_[j].path.data(), str.C_Str()) == 0)
-                {
-                    textures.push_back(textures_loaded_[j]);
-                    skip = true; 
-                    break;
-                }
-            }
-            if(!skip)
-            {   
-                Texture texture;
-                texture.id = TextureFromFile(str.C_Str(), this->directory_);
-                texture.type = type_name;
-                texture.path = str.C_Str();
-                textures.push_back(texture);
-                textures_loaded_.push_back(texture);  
-            }
+            textures.push_back(LoadTexture(str.C_Str(), type_name));
         }
         return textures;
     }
-};
-
-
-unsigned int TextureFromFile(const char *path, const string &directory, bool gamma)
-{
-    string filename = string(path);
-    filename = directory + '/' + filename;
-
-    unsigned int texture_id;
-    glGenTextures(1, &texture_id);
-
-    int width, height, nr_components;
-    unsigned char *data = stbi_load(filename.c_str(), &width, &height, &nr_components, 0);
-    if (data)
-    {
-        GLenum format;
-        if (nr_components == 1)
-            format = GL_RED;
-        else if (nr_components == 3)
-            format = GL_RGB;
-        else if (nr_components == 4)
-            format = GL_RGBA;
 
-        glBindTexture(GL_TEXTURE_2D, texture_id);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        stbi_image_free(data);
-    }
-    else
+    // Decoding runs on the thread pool, the constructor waits for the uploads once all meshes are loaded
+    Texture LoadTexture(const string &path, const string &type_name)
     {
-        std::cout << "Texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
+        Texture texture;
+        texture.id = TextureCache::Instance()->Load(directory_ + '/' + path, gamma_correction_);
+        texture.type = type_name;
+        texture.path = path;
+        return texture;
     }
+};
 
-    return texture_id;
-}
 #endif
\ No newline at end of file
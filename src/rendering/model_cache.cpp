@@ -0,0 +1,343 @@
+#include "model_cache.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+namespace {
+constexpr char kMagic[4] = {'S', 'M', 'C', 'H'};
+// Blobs start aligned so the mapped vertices and indices can be read in place
+constexpr uint64_t kBlobAlignment = 16;
+
+struct FileHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t source_hash;
+    uint32_t vertex_size;
+    uint32_t mesh_count;
+    uint32_t material_count;
+    uint32_t texture_count;
+    uint64_t strings_offset;
+    uint64_t strings_size;
+};
+
+struct MeshRecord {
+    uint64_t vertex_offset;
+    uint64_t index_offset;
+    uint32_t vertex_count;
+    uint32_t index_count;
+    uint32_t material;
+    // VertexLayout the mesh is uploaded in, the cache keeps full vertices
+    uint32_t layout;
+};
+
+struct MaterialRecord {
+    uint32_t first_texture;
+    uint32_t texture_count;
+};
+
+struct TextureRecord {
+    uint32_t type_offset;
+    uint32_t type_length;
+    uint32_t path_offset;
+    uint32_t path_length;
+};
+
+uint64_t AlignUp(uint64_t value)
+{
+    return (value + kBlobAlignment - 1) & ~(kBlobAlignment - 1);
+}
+
+bool InRange(uint64_t offset, uint64_t size, uint64_t file_size)
+{
+    return offset <= file_size && size <= file_size - offset;
+}
+
+// FNV-1a
+uint64_t HashBytes(const uint8_t *data, size_t size, uint64_t hash = 0xcbf29ce484222325ull)
+{
+    for(size_t i = 0; i < size; i++) {
+        hash = (hash ^ data[i]) * 0x100000001b3ull;
+    }
+    return hash;
+}
+
+// Material libraries an OBJ references, their materials and texture lists end up in the cache too
+std::vector<std::string> FindMaterialLibraries(const uint8_t *data, size_t size)
+{
+    std::vector<std::string> libraries;
+    const char *text = reinterpret_cast<const char *>(data);
+    size_t line_start = 0;
+    while(line_start < size) {
+        const char *line_end = static_cast<const char *>(std::memchr(text + line_start, '\n', size - line_start));
+        size_t line_size = (line_end ? line_end - text : size) - line_start;
+        std::string_view line(text + line_start, line_size);
+        line_start += line_size + 1;
+
+        size_t first = line.find_first_not_of(" \t");
+        if(first == std::string_view::npos || line.compare(first, 7, "mtllib ") != 0) {
+            continue;
+        }
+        line.remove_prefix(first + 7);
+        size_t name_start = line.find_first_not_of(" \t");
+        size_t name_end = line.find_last_not_of(" \t\r");
+        if(name_start != std::string_view::npos) {
+            libraries.emplace_back(line.substr(name_start, name_end - name_start + 1));
+        }
+    }
+    return libraries;
+}
+
+bool IndicesInRange(const unsigned int *indices, uint32_t index_count, uint32_t vertex_count)
+{
+    for(uint32_t i = 0; i < index_count; i++) {
+        if(indices[i] >= vertex_count) {
+            return false;
+        }
+    }
+    return true;
+}
+
+uint32_t AddString(std::string &strings, const std::string &value)
+{
+    uint32_t offset = static_cast<uint32_t>(strings.size());
+    strings += value;
+    return offset;
+}
+}
+
+std::string ModelCache::CachePath(const std::string &source_path)
+{
+    return source_path + ".meshcache";
+}
+
+uint64_t ModelCache::HashSource(const std::string &source_path)
+{
+    MappedFile source;
+    if(!source.Open(source_path)) {
+        return 0;
+    }
+
+    uint32_t layout[2] = {kVersion, static_cast<uint32_t>(sizeof(Vertex))};
+    uint64_t hash = HashBytes(reinterpret_cast<const uint8_t *>(layout), sizeof(layout));
+    hash = HashBytes(source.GetData(), source.GetSize(), hash);
+
+    // Edited materials have to invalidate the cache as well, a missing library only adds its name
+    std::string directory = source_path.substr(0, source_path.find_last_of('/') + 1);
+    for(const std::string &library : FindMaterialLibraries(source.GetData(), source.GetSize())) {
+        hash = HashBytes(reinterpret_cast<const uint8_t *>(library.data()), library.size(), hash);
+        MappedFile material;
+        if(material.Open(directory + library)) {
+            hash = HashBytes(material.GetData(), material.GetSize(), hash);
+        }
+    }
+    return hash;
+}
+
+bool ModelCache::Open(const std::string &source_path)
+{
+    Close();
+
+    uint64_t source_hash = HashSource(source_path);
+    if(!source_hash || !file_.Open(CachePath(source_path))) {
+        return false;
+    }
+
+    const uint8_t *data = file_.GetData();
+    uint64_t file_size = file_.GetSize();
+
+    FileHeader header;
+    if(file_size < sizeof(header)) {
+        Close();
+        return false;
+    }
+    std::memcpy(&header, data, sizeof(header));
+
+    bool valid = std::memcmp(header.magic, kMagic, sizeof(kMagic)) == 0 &&
+        header.version == kVersion &&
+        header.source_hash == source_hash &&
+        header.vertex_size == sizeof(Vertex);
+
+    uint64_t records_offset = sizeof(FileHeader);
+    uint64_t materials_offset = records_offset + uint64_t(header.mesh_count) * sizeof(MeshRecord);
+    uint64_t textures_offset = materials_offset + uint64_t(header.material_count) * sizeof(MaterialRecord);
+    uint64_t tables_end = textures_offset + uint64_t(header.texture_count) * sizeof(TextureRecord);
+
+    valid = valid && InRange(0, tables_end, file_size) && InRange(header.strings_offset, header.strings_size, file_size);
+    if(!valid) {
+        Close();
+        return false;
+    }
+
+    const char *strings = reinterpret_cast<const char *>(data + header.strings_offset);
+
+    for(uint32_t i = 0; i < header.texture_count; i++) {
+        TextureRecord record;
+        std::memcpy(&record, data + textures_offset + i * sizeof(TextureRecord), sizeof(record));
+
+        if(!InRange(record.type_offset, record.type_length, header.strings_size) ||
+           !InRange(record.path_offset, record.path_length, header.strings_size)) {
+            Close();
+            return false;
+        }
+
+        textures_.push_back({
+            std::string_view(strings + record.type_offset, record.type_length),
+            std::string_view(strings + record.path_offset, record.path_length)
+        });
+    }
+
+    for(uint32_t i = 0; i < header.material_count; i++) {
+        MaterialRecord record;
+        std::memcpy(&record, data + materials_offset + i * sizeof(MaterialRecord), sizeof(record));
+
+        if(!InRange(record.first_texture, record.texture_count, header.texture_count)) {
+            Close();
+            return false;
+        }
+        materials_.push_back({record.first_texture, record.texture_count});
+    }
+
+    for(uint32_t i = 0; i < header.mesh_count; i++) {
+        MeshRecord record;
+        std::memcpy(&record, data + records_offset + i * sizeof(MeshRecord), sizeof(record));
+
+        bool mesh_valid = record.material < header.material_count &&
+            record.layout < static_cast<uint32_t>(VertexLayout::Count) &&
+            record.vertex_offset % kBlobAlignment == 0 && record.index_offset % kBlobAlignment == 0 &&
+            InRange(record.vertex_offset, uint64_t(record.vertex_count) * sizeof(Vertex), file_size) &&
+            InRange(record.index_offset, uint64_t(record.index_count) * sizeof(unsigned int), file_size) &&
+            IndicesInRange(reinterpret_cast<const unsigned int *>(data + record.index_offset), record.index_count, record.vertex_count);
+
+        if(!mesh_valid) {
+            Close();
+            return false;
+        }
+
+        meshes_.push_back({
+            reinterpret_cast<const Vertex *>(data + record.vertex_offset), record.vertex_count,
+            reinterpret_cast<const unsigned int *>(data + record.index_offset), record.index_count,
+            record.material, static_cast<VertexLayout>(record.layout)
+        });
+    }
+
+    return true;
+}
+
+void ModelCache::Close()
+{
+    meshes_.clear();
+    materials_.clear();
+    textures_.clear();
+    file_.Close();
+}
+
+bool ModelCache::Write(const std::string &source_path, const std::vector<Mesh> &meshes)
+{
+    uint64_t source_hash = HashSource(source_path);
+    if(!source_hash) {
+        return false;
+    }
+
+    std::string strings;
+    std::vector<MeshRecord> mesh_records;
+    std::vector<MaterialRecord> material_records;
+    std::vector<TextureRecord> texture_records;
+    // Texture lists of the materials so far, meshes with the same textures share one
+    std::vector<std::vector<const Texture *>> material_textures;
+
+    for(const Mesh &mesh : meshes) {
+        uint32_t material = 0;
+        while(material < material_textures.size()) {
+            const std::vector<const Texture *> &textures = material_textures[material];
+            bool same = textures.size() == mesh.textures.size();
+            for(size_t i = 0; same && i < textures.size(); i++) {
+                same = textures[i]->type == mesh.textures[i].type && textures[i]->path == mesh.textures[i].path;
+            }
+            if(same) break;
+            material++;
+        }
+
+        if(material == material_textures.size()) {
+            material_records.push_back({static_cast<uint32_t>(texture_records.size()), static_cast<uint32_t>(mesh.textures.size())});
+            material_textures.emplace_back();
+
+            for(const Texture &texture : mesh.textures) {
+                material_textures.back().push_back(&texture);
+
+                TextureRecord record;
+                record.type_offset = AddString(strings, texture.type);
+                record.type_length = static_cast<uint32_t>(texture.type.size());
+                record.path_offset = AddString(strings, texture.path);
+                record.path_length = static_cast<uint32_t>(texture.path.size());
+                texture_records.push_back(record);
+            }
+        }
+
+        MeshRecord record {};
+        record.vertex_count = static_cast<uint32_t>(mesh.vertices.size());
+        record.index_count = static_cast<uint32_t>(mesh.indices.size());
+        record.material = material;
+        record.layout = static_cast<uint32_t>(mesh.GetLayout());
+        mesh_records.push_back(record);
+    }
+
+    FileHeader header {};
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kVersion;
+    header.source_hash = source_hash;
+    header.vertex_size = sizeof(Vertex);
+    header.mesh_count = static_cast<uint32_t>(mesh_records.size());
+    header.material_count = static_cast<uint32_t>(material_records.size());
+    header.texture_count = static_cast<uint32_t>(texture_records.size());
+    header.strings_offset = sizeof(FileHeader) + mesh_records.size() * sizeof(MeshRecord) +
+        material_records.size() * sizeof(MaterialRecord) + texture_records.size() * sizeof(TextureRecord);
+    header.strings_size = strings.size();
+
+    uint64_t offset = AlignUp(header.strings_offset + header.strings_size);
+    for(size_t i = 0; i < meshes.size(); i++) {
+        mesh_records[i].vertex_offset = offset;
+        offset = AlignUp(offset + meshes[i].vertices.size() * sizeof(Vertex));
+        mesh_records[i].index_offset = offset;
+        offset = AlignUp(offset + meshes[i].indices.size() * sizeof(unsigned int));
+    }
+
+    // Written under a temporary name first, so a crash never leaves a truncated cache behind
+    std::string cache_path = CachePath(source_path);
+    std::string temporary_path = cache_path + ".tmp";
+    {
+        std::ofstream file(temporary_path, std::ios::binary | std::ios::trunc);
+        if(!file.is_open()) {
+            return false;
+        }
+
+        auto write_at = [&file] (uint64_t position, const void *data, size_t size) {
+            static const char zeros[kBlobAlignment] = {};
+            while(static_cast<uint64_t>(file.tellp()) < position) {
+                file.write(zeros, std::min<uint64_t>(position - file.tellp(), kBlobAlignment));
+            }
+            file.write(static_cast<const char *>(data), size);
+        };
+
+        write_at(0, &header, sizeof(header));
+        write_at(file.tellp(), mesh_records.data(), mesh_records.size() * sizeof(MeshRecord));
+        write_at(file.tellp(), material_records.data(), material_records.size() * sizeof(MaterialRecord));
+        write_at(file.tellp(), texture_records.data(), texture_records.size() * sizeof(TextureRecord));
+        write_at(header.strings_offset, strings.data(), strings.size());
+
+        for(size_t i = 0; i < meshes.size(); i++) {
+            write_at(mesh_records[i].vertex_offset, meshes[i].vertices.data(), meshes[i].vertices.size() * sizeof(Vertex));
+            write_at(mesh_records[i].index_offset, meshes[i].indices.data(), meshes[i].indices.size() * sizeof(unsigned int));
+        }
+
+        if(!file.good()) {
+            file.close();
+            std::remove(temporary_path.c_str());
+            return false;
+        }
+    }
+
+    std::remove(cache_path.c_str());
+    return std::rename(temporary_path.c_str(), cache_path.c_str()) == 0;
+}
@@ -0,0 +1,63 @@
+#ifndef MODEL_CACHE_H
+#define MODEL_CACHE_H
+
+#include "mesh.h"
+#include "../utils/mapped_file.h"
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Meshes of an imported model as stored in the cache, the data points into the mapped file
+struct CachedMesh {
+    const Vertex *vertices;
+    uint32_t vertex_count;
+    const unsigned int *indices;
+    uint32_t index_count;
+    uint32_t material;
+    VertexLayout layout;
+};
+
+// Range of the cached textures a material uses
+struct CachedMaterial {
+    uint32_t first_texture;
+    uint32_t texture_count;
+};
+
+struct CachedTexture {
+    std::string_view type;
+    std::string_view path;
+};
+
+// Binary cache of the meshes Assimp imported from a model file, written next
+// to it on the first import. It is keyed on a hash of the source file and the
+// import settings, so edited models are imported again.
+class ModelCache {
+public:
+    // Bumped whenever the layout or the import settings change
+    static constexpr uint32_t kVersion = 3;
+
+    static std::string CachePath(const std::string &source_path);
+    // Hash of the file contents, the material libraries it references, the cache version and the vertex layout, 0 if it can't be read
+    static uint64_t HashSource(const std::string &source_path);
+
+    // Maps the cache of source_path, fails if it is missing, corrupt or outdated
+    bool Open(const std::string &source_path);
+    void Close();
+
+    const std::vector<CachedMesh> &GetMeshes() const { return meshes_; };
+    const std::vector<CachedMaterial> &GetMaterials() const { return materials_; };
+    const std::vector<CachedTexture> &GetTextures() const { return textures_; };
+
+    // Writes the cache of source_path from freshly imported meshes
+    static bool Write(const std::string &source_path, const std::vector<Mesh> &meshes);
+
+private:
+    MappedFile file_;
+    std::vector<CachedMesh> meshes_;
+    std::vector<CachedMaterial> materials_;
+    std::vector<CachedTexture> textures_;
+};
+
+#endif // MODEL_CACHE_H
@@ -0,0 +1,134 @@
+#include "render_queue.h"
+#include "gl_state_cache.h"
+#include "mesh.h"
+#include "uniform_buffers.h"
+#include "../utils/profiler.h"
+
+#include <algorithm>
+#include <cstring>
+
+uint64_t MakeSortKey(GLuint program, uint32_t material, GLuint vertex_array, float depth)
+{
+    // Bits of non-negative floats order like the floats, the top 20 keep sign, exponent and 11 mantissa bits
+    uint32_t depth_bits = 0;
+    float clamped_depth = std::max(depth, 0.f);
+    std::memcpy(&depth_bits, &clamped_depth, sizeof(depth_bits));
+
+    return (static_cast<uint64_t>(program & 0xFFFF) << 48) |
+           (static_cast<uint64_t>(material & 0xFFFF) << 32) |
+           (static_cast<uint64_t>(vertex_array & 0xFFF) << 20) |
+           (depth_bits >> 12);
+}
+
+void RenderQueue::Clear()
+{
+    items_.clear();
+    transforms_.clear();
+}
+
+uint32_t RenderQueue::AddTransform(const glm::mat4 &model, const VertexQuantization &quantization)
+{
+    transforms_.push_back({model, quantization});
+    return static_cast<uint32_t>(transforms_.size() - 1);
+}
+
+void RenderQueue::Submit(DrawItem item)
+{
+    items_.push_back(std::move(item));
+}
+
+bool RenderQueue::SameRun(const DrawItem &a, const DrawItem &b) const
+{
+    return !a.draw && !b.draw &&
+           a.program == b.program &&
+           a.arena == b.arena &&
+           a.transform == b.transform &&
+           a.mesh->GetMaterialId() == b.mesh->GetMaterialId();
+}
+
+size_t RenderQueue::ArenaIndex(GeometryArena *arena)
+{
+    for(size_t i = 0; i < arena_commands_.size(); i++) {
+        if(arena_commands_[i].arena == arena) {
+            return i;
+        }
+    }
+    arena_commands_.push_back({arena, {}});
+    return arena_commands_.size() - 1;
+}
+
+void RenderQueue::Flush()
+{
+    STEEL_PROFILE_SCOPE("Flush Render Queue");
+    if(items_.empty()) {
+        return;
+    }
+
+    order_.clear();
+    for(size_t i = 0; i < items_.size(); i++) {
+        order_.push_back({items_[i].sort_key, static_cast<uint32_t>(i)});
+    }
+    std::sort(order_.begin(), order_.end());
+
+    // Every arena gets its commands in one upload, before anything is drawn
+    runs_.clear();
+    for(ArenaCommands &arena : arena_commands_) {
+        arena.commands.clear();
+    }
+    for(size_t i = 0; i < order_.size(); i++) {
+        const DrawItem &item = items_[order_[i].second];
+        if(item.draw) {
+            runs_.push_back({i, 1, 0, 0});
+            continue;
+        }
+
+        if(!runs_.empty()) {
+            Run &run = runs_.back();
+            if(SameRun(items_[order_[run.first_item].second], item)) {
+                arena_commands_[run.arena].commands.push_back(item.command);
+                run.item_count++;
+                continue;
+            }
+        }
+
+        size_t arena = ArenaIndex(item.arena);
+        runs_.push_back({i, 1, arena, arena_commands_[arena].commands.size()});
+        arena_commands_[arena].commands.push_back(item.command);
+    }
+
+    for(ArenaCommands &arena : arena_commands_) {
+        if(!arena.commands.empty()) {
+            arena.arena->SetDrawCommands(arena.commands.data(), arena.commands.size());
+        }
+    }
+
+    UniformBuffers *uniform_buffers = UniformBuffers::Instance();
+    const ShaderProgram *textures_program = nullptr;
+    uint32_t textures_material = UINT32_MAX;
+    uint32_t transform = UINT32_MAX;
+
+    for(const Run &run : runs_) {
+        DrawItem &item = items_[order_[run.first_item].second];
+
+        item.program->Use();
+        if(item.transform != transform) {
+            transform = item.transform;
+            uniform_buffers->SetModel(transforms_[transform].model, transforms_[transform].quantization);
+        }
+
+        if(item.draw) {
+            item.draw();
+            // Custom draws may bind textures of their own
+            textures_program = nullptr;
+            continue;
+        }
+
+        item.arena->Bind();
+        if(item.program != textures_program || item.mesh->GetMaterialId() != textures_material) {
+            item.mesh->BindTextures(*item.program);
+            textures_program = item.program;
+            textures_material = item.mesh->GetMaterialId();
+        }
+        item.arena->MultiDraw(run.first_command, run.item_count);
+    }
+}
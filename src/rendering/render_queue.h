@@ -0,0 +1,85 @@
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include <GL/gl3w.h>
+#include <glm/glm.hpp>
+
+#include "geometry_arena.h"
+#include "vertex_layouts.h"
+#include "../utils/shader.h"
+
+#include <cstdint>
+#include <functional>
+#include <utility>
+#include <vector>
+
+class Mesh;
+
+// Program in the top 16 bits, then material (16), vertex array (12) and view
+// depth (20), so sorting groups by the most expensive state change first and
+// draws each group front to back. Ids are truncated to their field, which
+// only costs sorting quality, state is compared in full when drawing.
+uint64_t MakeSortKey(GLuint program, uint32_t material, GLuint vertex_array, float depth);
+
+struct DrawItem {
+    uint64_t sort_key = 0;
+    ShaderProgram *program = nullptr;
+    // Index into the queue's transforms, written to the draw block
+    uint32_t transform = 0;
+
+    // Arena draws, the textures of mesh are bound for them
+    Mesh *mesh = nullptr;
+    GeometryArena *arena = nullptr;
+    DrawElementsIndirectCommand command {};
+
+    // Custom draws run after program and transform are set, binding the rest themselves
+    std::function<void()> draw;
+};
+
+// Draws submitted in any order, sorted by key when flushed. Runs of arena
+// draws that share program, material, arena and transform go out as one
+// multi-draw, and all binds go through the GlStateCache.
+// Has to be used on the context thread.
+class RenderQueue {
+public:
+    // Forgets the submitted items and transforms
+    void Clear();
+
+    uint32_t AddTransform(const glm::mat4 &model, const VertexQuantization &quantization = VertexQuantization());
+    void Submit(DrawItem item);
+
+    void Flush();
+
+private:
+    // A run of sorted arena items, drawn with one MultiDraw
+    struct Run {
+        size_t first_item;
+        size_t item_count;
+        size_t arena;
+        size_t first_command;
+    };
+
+    struct ArenaCommands {
+        GeometryArena *arena;
+        std::vector<DrawElementsIndirectCommand> commands;
+    };
+
+    // What goes into the draw block
+    struct Transform {
+        glm::mat4 model;
+        VertexQuantization quantization;
+    };
+
+    std::vector<DrawItem> items_;
+    std::vector<Transform> transforms_;
+
+    // Sort key and submission index, so equal keys keep their order
+    std::vector<std::pair<uint64_t, uint32_t>> order_;
+    std::vector<Run> runs_;
+    std::vector<ArenaCommands> arena_commands_;
+
+    bool SameRun(const DrawItem &a, const DrawItem &b) const;
+    size_t ArenaIndex(GeometryArena *arena);
+};
+
+#endif // RENDER_QUEUE_H
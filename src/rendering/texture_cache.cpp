@@ -0,0 +1,127 @@
+#include "texture_cache.h"
+#include "gl_state_cache.h"
+#include "../utils/thread_pool.h"
+#include "../../lib/stb_image.h"
+
+#include <filesystem>
+#include <iostream>
+#include <system_error>
+
+TextureCache *TextureCache::texture_cache_ = nullptr;
+
+TextureCache *TextureCache::Instance()
+{
+    if(!texture_cache_) texture_cache_ = new TextureCache();
+    return texture_cache_;
+}
+
+TextureCache::~TextureCache()
+{
+    FinishUploads();
+
+    for(auto &[path, texture] : textures_) {
+        GlStateCache::Instance()->ForgetTexture(texture);
+        glDeleteTextures(1, &texture);
+    }
+}
+
+GLuint TextureCache::Load(const std::string &path, bool gamma)
+{
+    std::error_code error;
+    std::string canonical_path = std::filesystem::weakly_canonical(path, error).string();
+    if(error) {
+        canonical_path = path;
+    }
+
+    std::string key = gamma ? canonical_path + "#srgb" : canonical_path;
+    auto cached = textures_.find(key);
+    if(cached != textures_.end()) {
+        return cached->second;
+    }
+
+    GLuint texture;
+    glGenTextures(1, &texture);
+    textures_[key] = texture;
+    pending_uploads_++;
+
+    std::shared_ptr<DecodedQueue> decoded_images = decoded_images_;
+    ThreadPool::Instance()->Submit([texture, canonical_path, gamma, decoded_images] () {
+        DecodedImage image {texture, canonical_path, nullptr, 0, 0, 0, gamma};
+        image.pixels = stbi_load(canonical_path.c_str(), &image.width, &image.height, &image.components, 0);
+
+        std::lock_guard<std::mutex> lock(decoded_images->mutex);
+        decoded_images->images.push_back(std::move(image));
+        decoded_images->decoded.notify_all();
+    });
+
+    return texture;
+}
+
+void TextureCache::UploadDecoded()
+{
+    std::vector<DecodedImage> images;
+    {
+        std::lock_guard<std::mutex> lock(decoded_images_->mutex);
+        images.swap(decoded_images_->images);
+    }
+
+    Upload(images);
+}
+
+void TextureCache::FinishUploads()
+{
+    while(pending_uploads_ > 0) {
+        std::vector<DecodedImage> images;
+        {
+            std::unique_lock<std::mutex> lock(decoded_images_->mutex);
+            decoded_images_->decoded.wait(lock, [this] () { return !decoded_images_->images.empty(); });
+            images.swap(decoded_images_->images);
+        }
+
+        Upload(images);
+    }
+}
+
+void TextureCache::Upload(std::vector<DecodedImage> &images)
+{
+    for(DecodedImage &image : images) {
+        pending_uploads_--;
+
+        if(!image.pixels) {
+            std::cout << "Texture failed to load at path: " << image.path << std::endl;
+            continue;
+        }
+
+        GLenum format = GL_RGBA;
+        if(image.components == 1)
+            format = GL_RED;
+        else if(image.components == 2)
+            format = GL_RG;
+        else if(image.components == 3)
+            format = GL_RGB;
+
+        // Only color images have an sRGB format
+        GLenum internal_format = format;
+        if(image.gamma && format == GL_RGB)
+            internal_format = GL_SRGB8;
+        else if(image.gamma && format == GL_RGBA)
+            internal_format = GL_SRGB8_ALPHA8;
+
+        // Rows of one and three channel images aren't 4 byte aligned
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        GlStateCache::Instance()->BindTexture(0, GL_TEXTURE_2D, image.texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, internal_format, image.width, image.height, 0, format, GL_UNSIGNED_BYTE, image.pixels);
+        glGenerateMipmap(GL_TEXTURE_2D);
+
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+        stbi_image_free(image.pixels);
+    }
+
+    if(!images.empty()) {
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    }
+}
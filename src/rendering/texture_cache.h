@@ -0,0 +1,67 @@
+#ifndef TEXTURE_CACHE_H
+#define TEXTURE_CACHE_H
+
+#include <GL/gl3w.h>
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Process-wide cache of image textures, keyed by canonical path so every file
+// is decoded once no matter how many models use it. Images are decoded on the
+// thread pool and uploaded in batches on the context thread.
+// Everything but the decoding has to happen on the context thread.
+class TextureCache {
+private:
+    static TextureCache *texture_cache_;
+
+public:
+    TextureCache() = default;
+    ~TextureCache();
+
+    TextureCache(TextureCache &other) = delete;
+
+    void operator=(const TextureCache &) = delete;
+
+    static TextureCache *Instance();
+
+    // Returns the texture of the file right away, its image is filled in by a
+    // later upload once decoding has finished. Gamma corrected textures are
+    // stored as sRGB and cached apart from linear ones of the same file.
+    GLuint Load(const std::string &path, bool gamma = false);
+
+    // Uploads the images decoded so far, called once per frame
+    void UploadDecoded();
+    // Uploads every requested image, waiting for the ones still being decoded
+    void FinishUploads();
+
+private:
+    struct DecodedImage {
+        GLuint texture;
+        std::string path;
+        unsigned char *pixels;
+        int width;
+        int height;
+        int components;
+        bool gamma;
+    };
+
+    // Shared with the decode jobs so they never touch the cache itself
+    struct DecodedQueue {
+        std::mutex mutex;
+        std::condition_variable decoded;
+        std::vector<DecodedImage> images;
+    };
+
+    std::unordered_map<std::string, GLuint> textures_;
+    std::shared_ptr<DecodedQueue> decoded_images_ = std::make_shared<DecodedQueue>();
+    // Requested images that are not uploaded yet
+    int pending_uploads_ = 0;
+
+    void Upload(std::vector<DecodedImage> &images);
+};
+
+#endif // TEXTURE_CACHE_H
@@ -0,0 +1,112 @@
+#include "uniform_buffers.h"
+
+#include "../objects/camera.h"
+#include "../objects/directional_light.h"
+
+#include <cstring>
+
+UniformBuffers *UniformBuffers::uniform_buffers_ = nullptr;
+
+UniformBuffers *UniformBuffers::Instance()
+{
+    if(!uniform_buffers_) uniform_buffers_ = new UniformBuffers();
+    return uniform_buffers_;
+}
+
+UniformBuffers::~UniformBuffers()
+{
+    if(frame_buffer_) {
+        glDeleteBuffers(1, &frame_buffer_);
+        glDeleteBuffers(1, &draw_buffer_);
+    }
+}
+
+void UniformBuffers::Create()
+{
+    GLint offset_alignment = 256;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &offset_alignment);
+    GLsizeiptr alignment = offset_alignment > 0 ? offset_alignment : 256;
+    draw_stride_ = (static_cast<GLsizeiptr>(sizeof(DrawUniformData)) + alignment - 1) / alignment * alignment;
+
+    glGenBuffers(1, &frame_buffer_);
+    glBindBuffer(GL_UNIFORM_BUFFER, frame_buffer_);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameUniformData), nullptr, GL_DYNAMIC_DRAW);
+
+    glGenBuffers(1, &draw_buffer_);
+    OrphanDrawBuffer();
+
+    // The frame block stays bound for good, only its contents change
+    glBindBufferBase(GL_UNIFORM_BUFFER, static_cast<GLuint>(UniformBlockBinding::Frame), frame_buffer_);
+}
+
+void UniformBuffers::OrphanDrawBuffer()
+{
+    // The driver hands out fresh storage while draws still read the old one
+    glBindBuffer(GL_UNIFORM_BUFFER, draw_buffer_);
+    glBufferData(GL_UNIFORM_BUFFER, draw_stride_ * kDrawCapacity, nullptr, GL_STREAM_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    draw_count_ = 0;
+}
+
+void UniformBuffers::SetCamera(Camera &camera)
+{
+    FrameUniformData data = frame_data_;
+    data.view = camera.GetViewMat();
+    data.projection = camera.GetProjectionMat();
+    data.view_pos = glm::vec4(camera.position_, 1.f);
+
+    frame_dirty_ = frame_dirty_ || std::memcmp(&data, &frame_data_, sizeof(data)) != 0;
+    frame_data_ = data;
+}
+
+void UniformBuffers::SetDirectionalLight(const DirectionalLight &light)
+{
+    FrameUniformData data = frame_data_;
+    data.light_direction = glm::vec4(light.GetDirection(), 0.f);
+    data.light_ambient = glm::vec4(light.GetAmbient(), 0.f);
+    data.light_diffuse = glm::vec4(light.GetDiffuse(), 0.f);
+    data.light_specular = glm::vec4(light.GetSpecular(), 0.f);
+
+    frame_dirty_ = frame_dirty_ || std::memcmp(&data, &frame_data_, sizeof(data)) != 0;
+    frame_data_ = data;
+}
+
+void UniformBuffers::BeginFrame()
+{
+    if(!frame_buffer_) {
+        Create();
+    } else if(draw_count_ > 0) {
+        OrphanDrawBuffer();
+    }
+
+    if(frame_dirty_) {
+        glBindBuffer(GL_UNIFORM_BUFFER, frame_buffer_);
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(FrameUniformData), &frame_data_);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        frame_dirty_ = false;
+    }
+}
+
+void UniformBuffers::SetModel(const glm::mat4 &model, const VertexQuantization &quantization)
+{
+    if(!frame_buffer_) {
+        Create();
+    } else if(draw_count_ == kDrawCapacity) {
+        OrphanDrawBuffer();
+    }
+
+    DrawUniformData data {
+        model,
+        glm::vec4(quantization.position_offset, 0.f),
+        glm::vec4(quantization.position_scale, 0.f),
+        glm::vec4(quantization.texcoord_offset, quantization.texcoord_scale)
+    };
+    GLintptr offset = draw_count_ * draw_stride_;
+    draw_count_++;
+
+    glBindBuffer(GL_UNIFORM_BUFFER, draw_buffer_);
+    glBufferSubData(GL_UNIFORM_BUFFER, offset, sizeof(data), &data);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+    glBindBufferRange(GL_UNIFORM_BUFFER, static_cast<GLuint>(UniformBlockBinding::Draw), draw_buffer_, offset, sizeof(data));
+}
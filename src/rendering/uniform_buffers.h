@@ -0,0 +1,102 @@
+#ifndef UNIFORM_BUFFERS_H
+#define UNIFORM_BUFFERS_H
+
+#include <GL/gl3w.h>
+
+#include <glm/glm.hpp>
+
+#include "vertex_layouts.h"
+
+#include <string_view>
+
+class Camera;
+class DirectionalLight;
+
+// Binding points of the uniform blocks every program shares. GLSL 4.10 has no
+// binding layout qualifier for blocks, so programs are bound to these by block
+// name after linking.
+enum class UniformBlockBinding : GLuint {
+    Frame = 0,
+    Draw = 1,
+};
+
+// Binding point of a block name, false for blocks that aren't shared
+inline bool GetUniformBlockBinding(std::string_view block_name, GLuint &binding)
+{
+    if(block_name == "FrameUniforms") {
+        binding = static_cast<GLuint>(UniformBlockBinding::Frame);
+        return true;
+    }
+    if(block_name == "DrawUniforms") {
+        binding = static_cast<GLuint>(UniformBlockBinding::Draw);
+        return true;
+    }
+    return false;
+}
+
+// std140 layout of the FrameUniforms block
+struct FrameUniformData {
+    glm::mat4 view;
+    glm::mat4 projection;
+    glm::vec4 view_pos;
+    glm::vec4 light_direction;
+    glm::vec4 light_ambient;
+    glm::vec4 light_diffuse;
+    glm::vec4 light_specular;
+};
+
+// std140 layout of the DrawUniforms block
+struct DrawUniformData {
+    glm::mat4 model;
+    glm::vec4 position_offset;
+    glm::vec4 position_scale;
+    glm::vec4 texcoord_transform;
+};
+
+// Owns the uniform buffers behind the shared blocks. The frame block holds
+// camera and light and is uploaded and bound once per frame; per-draw data is
+// appended to a buffer that is orphaned every frame, with each draw binding
+// its own range of it.
+// Has to be used on the context thread.
+class UniformBuffers {
+private:
+    static UniformBuffers *uniform_buffers_;
+
+public:
+    UniformBuffers() = default;
+    ~UniformBuffers();
+
+    UniformBuffers(UniformBuffers &other) = delete;
+
+    void operator=(const UniformBuffers &) = delete;
+
+    static UniformBuffers *Instance();
+
+    void SetCamera(Camera &camera);
+    void SetDirectionalLight(const DirectionalLight &light);
+
+    // Uploads the frame block if it changed and starts a new per-draw buffer.
+    // Call once per frame before drawing.
+    void BeginFrame();
+
+    // Writes the draw's model matrix and vertex dequantization and binds them to the draw block
+    void SetModel(const glm::mat4 &model, const VertexQuantization &quantization = VertexQuantization());
+
+private:
+    // Draws per frame before the per-draw buffer is orphaned again
+    static constexpr GLsizeiptr kDrawCapacity = 4096;
+
+    GLuint frame_buffer_ = 0;
+    GLuint draw_buffer_ = 0;
+    // Per-draw data is bound at multiples of the uniform buffer offset alignment
+    GLsizeiptr draw_stride_ = 0;
+    GLsizeiptr draw_count_ = 0;
+
+    FrameUniformData frame_data_ {};
+    bool frame_dirty_ = true;
+
+    void Create();
+    void OrphanDrawBuffer();
+};
+
+#endif // UNIFORM_BUFFERS_H
@@ -0,0 +1,169 @@
+#include "upload_ring.h"
+
+#include <cstring>
+
+namespace {
+// Regions start on cache line boundaries so workers never share a line
+constexpr size_t kUploadAlignment = 64;
+
+size_t AlignUp(size_t value)
+{
+    return (value + kUploadAlignment - 1) & ~(kUploadAlignment - 1);
+}
+}
+
+UploadRing::~UploadRing()
+{
+    for(FrameFence &fence : fences_) {
+        glDeleteSync(fence.sync);
+    }
+
+    if(buffer_) {
+        glBindBuffer(GL_COPY_READ_BUFFER, buffer_);
+        if(mapped_) {
+            glUnmapBuffer(GL_COPY_READ_BUFFER);
+        }
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+        glDeleteBuffers(1, &buffer_);
+    }
+}
+
+bool UploadRing::SupportsBufferStorage()
+{
+    if(!glBufferStorage) {
+        return false;
+    }
+
+    if(gl3wIsSupported(4, 4)) {
+        return true;
+    }
+
+    GLint extension_count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &extension_count);
+    for(GLint i = 0; i < extension_count; i++) {
+        const char *extension = reinterpret_cast<const char *>(glGetStringi(GL_EXTENSIONS, i));
+        if(extension && std::strcmp(extension, "GL_ARB_buffer_storage") == 0) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void UploadRing::Create(size_t capacity)
+{
+    capacity_ = AlignUp(capacity);
+
+    glGenBuffers(1, &buffer_);
+    glBindBuffer(GL_COPY_READ_BUFFER, buffer_);
+
+    if(SupportsBufferStorage()) {
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(GL_COPY_READ_BUFFER, capacity_, nullptr, flags);
+        mapped_ = glMapBufferRange(GL_COPY_READ_BUFFER, 0, capacity_, flags);
+    } else {
+        glBufferData(GL_COPY_READ_BUFFER, capacity_, nullptr, GL_STREAM_DRAW);
+    }
+
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+}
+
+UploadAllocation UploadRing::Allocate(size_t requested_size)
+{
+    size_t size = AlignUp(requested_size);
+    if(size == 0 || size > capacity_) {
+        return {};
+    }
+
+    size_t offset;
+    if(blocks_.empty()) {
+        offset = 0;
+    } else {
+        size_t tail = blocks_.front().offset;
+        if(head_ > tail) {
+            // Free space at the end, otherwise wrap around to the start
+            if(head_ + size <= capacity_) {
+                offset = head_;
+            } else if(size <= tail) {
+                offset = 0;
+            } else {
+                return {};
+            }
+        } else if(head_ + size <= tail) {
+            offset = head_;
+        } else {
+            return {};
+        }
+    }
+
+    Block block {offset, size, next_id_++};
+    blocks_.push_back(block);
+    head_ = offset + size;
+
+    UploadAllocation allocation;
+    allocation.offset = offset;
+    allocation.size = requested_size;
+    allocation.pointer = mapped_ ? static_cast<char *>(mapped_) + offset : nullptr;
+    allocation.id = block.id;
+    return allocation;
+}
+
+void UploadRing::Write(const UploadAllocation &allocation, const void *data)
+{
+    // The fences guarantee the GPU is done with the region, so the driver doesn't have to wait
+    GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT;
+
+    glBindBuffer(GL_COPY_READ_BUFFER, buffer_);
+    void *pointer = glMapBufferRange(GL_COPY_READ_BUFFER, allocation.offset, allocation.size, flags);
+    if(pointer) {
+        std::memcpy(pointer, data, allocation.size);
+        glUnmapBuffer(GL_COPY_READ_BUFFER);
+    }
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+}
+
+void UploadRing::CopyToBuffer(const UploadAllocation &allocation, GLuint buffer, size_t buffer_offset)
+{
+    glBindBuffer(GL_COPY_READ_BUFFER, buffer_);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, allocation.offset, buffer_offset, allocation.size);
+
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+}
+
+void UploadRing::Release(const UploadAllocation &allocation)
+{
+    for(Block &block : blocks_) {
+        if(block.id == allocation.id) {
+            block.released = true;
+            block.release_frame = frame_;
+            released_this_frame_ = true;
+            return;
+        }
+    }
+}
+
+void UploadRing::EndFrame()
+{
+    if(released_this_frame_) {
+        fences_.push_back({frame_, glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0)});
+        released_this_frame_ = false;
+    }
+    frame_++;
+
+    while(!fences_.empty()) {
+        GLenum status = glClientWaitSync(fences_.front().sync, 0, 0);
+        if(status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) {
+            break;
+        }
+        completed_frame_ = fences_.front().frame;
+        glDeleteSync(fences_.front().sync);
+        fences_.pop_front();
+    }
+
+    // Regions are freed in allocation order, one still in use holds back the ones after it
+    while(!blocks_.empty() && blocks_.front().released && blocks_.front().release_frame <= completed_frame_) {
+        blocks_.pop_front();
+    }
+}
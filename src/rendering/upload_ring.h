@@ -0,0 +1,83 @@
+#ifndef UPLOAD_RING_H
+#define UPLOAD_RING_H
+
+#include <GL/gl3w.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+
+// Region of the staging ring reserved for one upload
+struct UploadAllocation {
+    size_t offset = 0;
+    size_t size = 0;
+    // Mapped memory of the region, only set on persistently mapped rings.
+    // Any thread may write it until the allocation is released.
+    void *pointer = nullptr;
+    uint64_t id = 0;
+
+    bool IsValid() const { return id != 0; };
+};
+
+// Staging buffer that uploads are written into and copied from on the GPU.
+// With ARB_buffer_storage it stays persistently mapped, so worker threads can
+// write into it directly; otherwise regions are written through unsynchronized
+// maps on the context thread. Released regions are reused once the fence of
+// the frame that released them has signaled.
+// Everything but writing mapped memory has to happen on the context thread.
+class UploadRing {
+public:
+    UploadRing() = default;
+    ~UploadRing();
+
+    UploadRing(const UploadRing &) = delete;
+    void operator=(const UploadRing &) = delete;
+
+    void Create(size_t capacity);
+    bool IsCreated() const { return buffer_ != 0; };
+    bool IsPersistent() const { return mapped_ != nullptr; };
+
+    // Returns an invalid allocation while the ring has no room for requested_size bytes
+    UploadAllocation Allocate(size_t requested_size);
+    // Copies data into the region, for rings that are not persistently mapped
+    void Write(const UploadAllocation &allocation, const void *data);
+    void CopyToBuffer(const UploadAllocation &allocation, GLuint buffer, size_t buffer_offset);
+    // The region is reused after the commands issued so far have completed
+    void Release(const UploadAllocation &allocation);
+
+    // Fences the regions released since the last call and frees the ones whose
+    // fences have signaled. Call once per frame after issuing the copies.
+    void EndFrame();
+
+private:
+    struct Block {
+        size_t offset;
+        // Requested size rounded up to the alignment
+        size_t size;
+        uint64_t id;
+        bool released = false;
+        // Frame whose fence guards the region once released
+        uint64_t release_frame = 0;
+    };
+
+    struct FrameFence {
+        uint64_t frame;
+        GLsync sync;
+    };
+
+    GLuint buffer_ = 0;
+    size_t capacity_ = 0;
+    void *mapped_ = nullptr;
+    // Next allocation starts here, blocks are ordered from the oldest
+    size_t head_ = 0;
+    std::deque<Block> blocks_;
+    std::deque<FrameFence> fences_;
+    uint64_t next_id_ = 1;
+    uint64_t frame_ = 1;
+    uint64_t completed_frame_ = 0;
+    bool released_this_frame_ = false;
+
+    static bool SupportsBufferStorage();
+};
+
+#endif // UPLOAD_RING_H
@@ -0,0 +1,221 @@
+#include "vertex_layouts.h"
+#include "../math/packing.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+constexpr float kPi = 3.14159265358979f;
+
+// Orthonormal basis around a unit normal (Duff et al. 2017), the shaders build the same one
+void TangentBasis(const glm::vec3 &n, glm::vec3 &b1, glm::vec3 &b2)
+{
+    float sign = n.z >= 0.f ? 1.f : -1.f;
+    float a = -1.f / (sign + n.z);
+    float b = n.x * n.y * a;
+    b1 = glm::vec3(1.f + sign * n.x * n.x * a, sign * b, -sign * n.x);
+    b2 = glm::vec3(b, sign + n.y * n.y * a, -n.y);
+}
+
+uint32_t PackSnorm10(float value)
+{
+    return static_cast<uint32_t>(std::lround(std::clamp(value, -1.f, 1.f) * 511.f)) & 0x3FF;
+}
+
+float UnpackSnorm10(uint32_t bits)
+{
+    int32_t value = static_cast<int32_t>(bits << 22) >> 22;
+    return std::max(value / 511.f, -1.f);
+}
+
+uint16_t Quantize(float value, float offset, float scale)
+{
+    return PackUnorm16((value - offset) / scale);
+}
+
+template <typename PackedType>
+void PackCommon(const Vertex &vertex, const VertexQuantization &quantization, PackedType &packed)
+{
+    for(int i = 0; i < 3; i++) {
+        packed.position[i] = Quantize(vertex.Position[i], quantization.position_offset[i], quantization.position_scale[i]);
+    }
+    packed.position[3] = 0;
+    packed.tangent_frame = PackTangentFrame(vertex.Normal, vertex.Tangent, vertex.Bitangent);
+    for(int i = 0; i < 2; i++) {
+        packed.texcoords[i] = Quantize(vertex.TexCoords[i], quantization.texcoord_offset[i], quantization.texcoord_scale[i]);
+    }
+}
+}
+
+void VertexBounds::Include(const Vertex *vertices, size_t count)
+{
+    for(size_t i = 0; i < count; i++) {
+        position_min = glm::min(position_min, vertices[i].Position);
+        position_max = glm::max(position_max, vertices[i].Position);
+        texcoord_min = glm::min(texcoord_min, vertices[i].TexCoords);
+        texcoord_max = glm::max(texcoord_max, vertices[i].TexCoords);
+    }
+}
+
+VertexQuantization VertexBounds::GetQuantization() const
+{
+    VertexQuantization quantization;
+    if(position_min.x > position_max.x) {
+        return quantization;
+    }
+
+    // Flat extents keep a scale of 1, so quantizing never divides by zero
+    glm::vec3 position_extent = position_max - position_min;
+    glm::vec2 texcoord_extent = texcoord_max - texcoord_min;
+    quantization.position_offset = position_min;
+    quantization.texcoord_offset = texcoord_min;
+    for(int i = 0; i < 3; i++) {
+        quantization.position_scale[i] = position_extent[i] > 0.f ? position_extent[i] : 1.f;
+    }
+    for(int i = 0; i < 2; i++) {
+        quantization.texcoord_scale[i] = texcoord_extent[i] > 0.f ? texcoord_extent[i] : 1.f;
+    }
+    return quantization;
+}
+
+uint32_t PackTangentFrame(const glm::vec3 &normal, const glm::vec3 &tangent, const glm::vec3 &bitangent)
+{
+    if(glm::dot(normal, normal) == 0.f) {
+        return 0;
+    }
+
+    glm::vec2 octahedral = OctahedralEncode(glm::normalize(normal));
+    uint32_t packed = PackSnorm10(octahedral.x) | PackSnorm10(octahedral.y) << 10;
+
+    // The angle is measured in the basis of the decoded normal, exactly what the shaders rebuild
+    glm::vec3 decoded_normal = OctahedralDecode(glm::vec2(UnpackSnorm10(packed & 0x3FF), UnpackSnorm10(packed >> 10 & 0x3FF)));
+    glm::vec3 b1, b2;
+    TangentBasis(decoded_normal, b1, b2);
+
+    glm::vec3 projected = tangent - decoded_normal * glm::dot(decoded_normal, tangent);
+    float angle = 0.f;
+    if(glm::dot(projected, projected) > 0.f) {
+        angle = std::atan2(glm::dot(projected, b2), glm::dot(projected, b1));
+    }
+    uint32_t angle_bits = static_cast<uint32_t>(std::lround((angle + kPi) / (2.f * kPi) * 2047.f)) & 0x7FF;
+    packed |= angle_bits << 20;
+
+    if(glm::dot(glm::cross(decoded_normal, tangent), bitangent) < 0.f) {
+        packed |= 1u << 31;
+    }
+    return packed;
+}
+
+void UnpackTangentFrame(uint32_t tangent_frame, glm::vec3 &normal, glm::vec3 &tangent, glm::vec3 &bitangent)
+{
+    normal = OctahedralDecode(glm::vec2(UnpackSnorm10(tangent_frame & 0x3FF), UnpackSnorm10(tangent_frame >> 10 & 0x3FF)));
+
+    glm::vec3 b1, b2;
+    TangentBasis(normal, b1, b2);
+    float angle = (tangent_frame >> 20 & 0x7FF) / 2047.f * 2.f * kPi - kPi;
+    tangent = b1 * std::cos(angle) + b2 * std::sin(angle);
+
+    float sign = tangent_frame >> 31 ? -1.f : 1.f;
+    bitangent = glm::cross(normal, tangent) * sign;
+}
+
+VertexLayout ChooseVertexLayout(const Vertex *vertices, size_t count, bool skinned)
+{
+    if(!skinned) {
+        return VertexLayout::Packed;
+    }
+
+    // Bone ids past a byte stay in the full layout, negative ids mark empty slots
+    for(size_t i = 0; i < count; i++) {
+        for(int j = 0; j < MAX_BONE_INFLUENCE; j++) {
+            if(vertices[i].m_BoneIDs[j] > 255) {
+                return VertexLayout::Full;
+            }
+        }
+    }
+    return VertexLayout::PackedSkinned;
+}
+
+GLsizei VertexLayoutStride(VertexLayout layout)
+{
+    switch(layout) {
+        case VertexLayout::Packed:
+            return sizeof(PackedVertex);
+        case VertexLayout::PackedSkinned:
+            return sizeof(PackedSkinnedVertex);
+        default:
+            return sizeof(Vertex);
+    }
+}
+
+void SetupVertexLayoutAttributes(VertexLayout layout)
+{
+    GLsizei stride = VertexLayoutStride(layout);
+
+    if(layout == VertexLayout::Full) {
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void*)0);
+
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(Vertex, Normal));
+
+        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(Vertex, TexCoords));
+
+        glEnableVertexAttribArray(3);
+        glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(Vertex, Tangent));
+
+        glEnableVertexAttribArray(4);
+        glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(Vertex, Bitangent));
+
+        glEnableVertexAttribArray(5);
+        glVertexAttribIPointer(5, 4, GL_INT, stride, (void*)offsetof(Vertex, m_BoneIDs));
+
+        glEnableVertexAttribArray(6);
+        glVertexAttribPointer(6, 4, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(Vertex, m_Weights));
+        return;
+    }
+
+    // Both packed layouts start with the PackedVertex members
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_TRUE, stride, (void*)offsetof(PackedVertex, position));
+
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 2, GL_UNSIGNED_SHORT, GL_TRUE, stride, (void*)offsetof(PackedVertex, texcoords));
+
+    glEnableVertexAttribArray(kTangentFrameAttributeLocation);
+    glVertexAttribIPointer(kTangentFrameAttributeLocation, 1, GL_UNSIGNED_INT, stride, (void*)offsetof(PackedVertex, tangent_frame));
+
+    if(layout == VertexLayout::PackedSkinned) {
+        glEnableVertexAttribArray(5);
+        glVertexAttribIPointer(5, 4, GL_UNSIGNED_BYTE, stride, (void*)offsetof(PackedSkinnedVertex, bone_ids));
+
+        glEnableVertexAttribArray(6);
+        glVertexAttribPointer(6, 4, GL_UNSIGNED_BYTE, GL_TRUE, stride, (void*)offsetof(PackedSkinnedVertex, bone_weights));
+    }
+}
+
+void PackVertices(VertexLayout layout, const Vertex *vertices, size_t count, const VertexQuantization &quantization, void *destination)
+{
+    if(layout == VertexLayout::Packed) {
+        PackedVertex *packed = static_cast<PackedVertex *>(destination);
+        for(size_t i = 0; i < count; i++) {
+            PackCommon(vertices[i], quantization, packed[i]);
+        }
+        return;
+    }
+
+    if(layout == VertexLayout::PackedSkinned) {
+        PackedSkinnedVertex *packed = static_cast<PackedSkinnedVertex *>(destination);
+        for(size_t i = 0; i < count; i++) {
+            PackCommon(vertices[i], quantization, packed[i]);
+            for(int j = 0; j < MAX_BONE_INFLUENCE; j++) {
+                // Empty slots become bone 0 without influence
+                bool empty = vertices[i].m_BoneIDs[j] < 0;
+                float weight = empty ? 0.f : std::clamp(vertices[i].m_Weights[j], 0.f, 1.f);
+                packed[i].bone_ids[j] = static_cast<uint8_t>(empty ? 0 : vertices[i].m_BoneIDs[j]);
+                packed[i].bone_weights[j] = static_cast<uint8_t>(std::lround(weight * 255.f));
+            }
+        }
+    }
+}
@@ -0,0 +1,94 @@
+#ifndef VERTEX_LAYOUTS_H
+#define VERTEX_LAYOUTS_H
+
+#include <GL/gl3w.h>
+#include <glm/glm.hpp>
+
+#include <cfloat>
+#include <cstddef>
+#include <cstdint>
+
+#define MAX_BONE_INFLUENCE 4
+
+// Vertex as imported, kept on the CPU and in the model cache
+struct Vertex {
+    glm::vec3 Position;
+    glm::vec3 Normal;
+    glm::vec2 TexCoords;
+    glm::vec3 Tangent;
+    glm::vec3 Bitangent;
+	int m_BoneIDs[MAX_BONE_INFLUENCE];
+	float m_Weights[MAX_BONE_INFLUENCE];
+};
+
+// Formats meshes are uploaded in, picked per mesh. Every layout lives in an
+// arena of its own.
+enum class VertexLayout : uint32_t {
+    // Vertex as it is, 88 bytes
+    Full,
+    // PackedVertex, 16 bytes
+    Packed,
+    // PackedSkinnedVertex, 24 bytes
+    PackedSkinned,
+    Count,
+};
+
+// Positions as unorm16 in the quantization box, the tangent frame from
+// PackTangentFrame and texcoords as unorm16 in the quantization range
+struct PackedVertex {
+    uint16_t position[4];
+    uint32_t tangent_frame;
+    uint16_t texcoords[2];
+};
+
+// PackedVertex plus four bone ids up to 255 and unorm8 weights
+struct PackedSkinnedVertex {
+    uint16_t position[4];
+    uint32_t tangent_frame;
+    uint16_t texcoords[2];
+    uint8_t bone_ids[MAX_BONE_INFLUENCE];
+    uint8_t bone_weights[MAX_BONE_INFLUENCE];
+};
+
+// Packed layouts read the tangent frame as a uint here, the full layout has normal, tangent and bitangent at 1, 3 and 4
+constexpr GLuint kTangentFrameAttributeLocation = 12;
+
+// Maps quantized positions and texcoords back, shaders read it from the draw
+// block. The default leaves full layout vertices as they are.
+struct VertexQuantization {
+    glm::vec3 position_offset = glm::vec3(0.f);
+    glm::vec3 position_scale = glm::vec3(1.f);
+    glm::vec2 texcoord_offset = glm::vec2(0.f);
+    glm::vec2 texcoord_scale = glm::vec2(1.f);
+};
+
+// Ranges the quantization of a model has to cover, grown mesh by mesh. Meshes
+// drawn with one multi-draw have to share their quantization.
+struct VertexBounds {
+    glm::vec3 position_min = glm::vec3(FLT_MAX);
+    glm::vec3 position_max = glm::vec3(-FLT_MAX);
+    glm::vec2 texcoord_min = glm::vec2(FLT_MAX);
+    glm::vec2 texcoord_max = glm::vec2(-FLT_MAX);
+
+    void Include(const Vertex *vertices, size_t count);
+    VertexQuantization GetQuantization() const;
+};
+
+// Octahedral normal in two snorm10, the tangent's angle around the normal in
+// 11 bits and the sign of the bitangent in the top bit. The shaders decode it
+// with DecodeTangentFrame.
+uint32_t PackTangentFrame(const glm::vec3 &normal, const glm::vec3 &tangent, const glm::vec3 &bitangent);
+void UnpackTangentFrame(uint32_t tangent_frame, glm::vec3 &normal, glm::vec3 &tangent, glm::vec3 &bitangent);
+
+// Packed layouts for meshes that fit them, bones only for skinned ones
+VertexLayout ChooseVertexLayout(const Vertex *vertices, size_t count, bool skinned);
+
+GLsizei VertexLayoutStride(VertexLayout layout);
+
+// Sets the attribute pointers of the layout, relative to the bound GL_ARRAY_BUFFER
+void SetupVertexLayoutAttributes(VertexLayout layout);
+
+// Writes count vertices of a packed layout to destination, VertexLayoutStride bytes each
+void PackVertices(VertexLayout layout, const Vertex *vertices, size_t count, const VertexQuantization &quantization, void *destination);
+
+#endif // VERTEX_LAYOUTS_H
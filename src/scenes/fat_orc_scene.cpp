@@ -12,11 +12,41 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+#include <cmath>
+#include <vector>
+
+#include "../objects/directional_light.h"
+#include "../rendering/render_queue.h"
+#include "../rendering/uniform_buffers.h"
+
 
 class FatOrcScene : virtual public Scene {
 	std::unique_ptr<Camera> camera_;
 	std::unique_ptr<ShaderProgram> main_shader_;
+	std::unique_ptr<ShaderProgram> instanced_shader_;
 	std::unique_ptr<Model> fat_troll_model_ = make_unique<Model>(ROOT_DIR"/assets/models/FatTroll.obj");
+	RenderQueue render_queue_;
+	DirectionalLight sun_ {glm::vec3(-0.2f, -1.0f, -0.3f), glm::vec3(0.2f), glm::vec3(0.7f), glm::vec3(0.3f)};
+
+	// Copies of the troll on a square grid, drawn instanced when there is more than one
+	std::vector<InstanceData> instances_;
+	int instance_count_ = 1;
+	static constexpr float kInstanceSpacing = 8.f;
+
+	void BuildInstances() {
+		instances_.resize(instance_count_);
+		int side = static_cast<int>(std::ceil(std::sqrt(static_cast<float>(instance_count_))));
+		for(int i = 0; i < instance_count_; i++) {
+			int x = i % side;
+			int z = i / side;
+			glm::vec3 position((x - side / 2) * kInstanceSpacing, 0.f, (z - side / 2) * kInstanceSpacing);
+
+			instances_[i].model = glm::rotate(glm::translate(glm::mat4(1.f), position), glm::radians(static_cast<float>(i * 37 % 360)), glm::vec3(0.f, 1.f, 0.f));
+			// Cheap per instance variation, so the copies can be told apart
+			float shade = 0.75f + 0.25f * static_cast<float>(i * 2654435761u % 1024) / 1023.f;
+			instances_[i].tint = glm::vec4(glm::vec3(shade), 1.f);
+		}
+	}
 public:
 	Display *display_;
 
@@ -29,6 +59,10 @@ public:
 			{ROOT_DIR"/assets/shaders/troll_vertex.glsl", Shader::Type::Vertex},
 			{ROOT_DIR"/assets/shaders/troll_fragment.glsl", Shader::Type::Fragment}
 		});;
+		instanced_shader_ = make_unique<ShaderProgram>(std::initializer_list<std::pair<std::string_view, Shader::Type>> {
+			{ROOT_DIR"/assets/shaders/troll_instanced_vertex.glsl", Shader::Type::Vertex},
+			{ROOT_DIR"/assets/shaders/troll_fragment.glsl", Shader::Type::Fragment}
+		});
 		main_shader_->Use();
 
 		camera_ = make_unique<Camera>(0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 90.f, 1920.f / 1080.f, 1.f, 1000.f);
@@ -56,6 +90,8 @@ public:
 		glfwSetKeyCallback(display_->GetWindow(), &InputHandler::RegisterKeys);
 		glfwSetMouseButtonCallback(display_->GetWindow(), &InputHandler::RegisterButtons);
 		glfwSetCursorPosCallback(display_->GetWindow(), &InputHandler::ProcessMouseInput);
+
+		display_->AddIntSlider("Fat Orc", "Instances", &instance_count_, 1, 10000);
 	
 		display_->InitImGui();
 
@@ -109,21 +145,42 @@ public:
 	}
 
 	void Update(float delta_time) {
-		camera_->UpdateShader(main_shader_);
+		UniformBuffers *uniform_buffers = UniformBuffers::Instance();
+		uniform_buffers->SetCamera(*camera_);
+		uniform_buffers->SetDirectionalLight(sun_);
 	}
 
 	void LateUpdate(float delta_time) {
 
 	}
 
+	Camera *GetCamera() override {
+		return camera_.get();
+	}
+
+	// Circles the model at a distance where it fills most of the view
+	CameraPath GetBenchmarkPath() override {
+		return CameraPath::Orbit(glm::vec3(0.f, 4.f, 0.f), 12.f, 2.f, 10.f);
+	}
+
 	void Draw(Display *display) override {
-		main_shader_->Use();
+		if(instance_count_ > 1) {
+			if(instances_.size() != static_cast<size_t>(instance_count_)) {
+				BuildInstances();
+			}
+
+			instanced_shader_->Use();
+			fat_troll_model_->DrawInstanced(instanced_shader_, camera_->GetFrustum(), instances_.data(), instances_.size());
+			return;
+		}
+
 		glm::mat4 model = glm::mat4(1.0f);
 		model = glm::translate(model, glm::vec3(0.0f, 0.0f, 0.0f)); // translate it down so it's at the center of the scene
 		model = glm::scale(model, glm::vec3(1.0f, 1.0f, 1.0f));	// it's a bit too big for our scene, so scale it down
-		main_shader_->SetMat4Uniform("model", model);
 
-		fat_troll_model_->Draw(main_shader_);
+		render_queue_.Clear();
+		fat_troll_model_->Submit(render_queue_, *main_shader_, camera_->GetFrustum(), model, camera_->position_);
+		render_queue_.Flush();
 	}
 };
 
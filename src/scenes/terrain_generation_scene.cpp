@@ -25,8 +25,11 @@
 #include "../ui/display.h"
 #include "../utils/scene.h"
 #include "../objects/camera.h"
+#include "../objects/directional_light.h"
 
 #include "../rendering/model.h"
+#include "../rendering/render_queue.h"
+#include "../rendering/uniform_buffers.h"
 
 #include "../config.h"
 
@@ -38,6 +41,8 @@ private:
     std::unique_ptr<Camera> camera_;
     std::unique_ptr<ShaderProgram> main_shader_;
     std::unique_ptr<PerlinNoiseChunkGenerator> generator_;
+    RenderQueue render_queue_;
+    DirectionalLight sun_ {glm::vec3(-0.2f, -1.0f, -0.3f), glm::vec3(0.2f), glm::vec3(0.7f), glm::vec3(0.3f)};
 public:
     Display *display_;
 
@@ -54,10 +59,8 @@ public:
 
         generator_ = make_unique<PerlinNoiseChunkGenerator>();
 
-        camera_ = make_unique<Camera>(0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 90.f, 1920.f / 1080.f, 1.f, 1000.f);
+        camera_ = make_unique<Camera>(0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 90.f, 1920.f / 1080.f, 1.f, 5000.f);
 
-        main_shader_->SetFloatUniform("waterHeight", generator_->GetWaterHeight());
-        main_shader_->SetFloatUniform("meshHeight", generator_->GetMeshHeight());
         main_shader_->SetFloatUniform("scale", 1.0f);
     }
 
@@ -89,6 +92,9 @@ public:
         display_->AddFloatSlider("Terrain", "Noise Scale", &generator_->noise_scale_, 0, 1000);
         display_->AddFloatSlider("Terrain", "Persistence", &generator_->persistence_, 0, 1);
         display_->AddFloatSlider("Terrain", "Lacunarity", &generator_->lacunarity_, 1, 64);
+        display_->AddIntSlider("Terrain", "Render Distance", &generator_->chunk_render_distance_, 1, 16);
+        display_->AddFloatSlider("Terrain", "LOD Distance", &generator_->lod_distance_, kMinLodDistance, 1024);
+        display_->AddIntSlider("Terrain", "Triangle Budget", &generator_->triangle_budget_, 100000, 4000000);
         display_->AddButton("Terrain", "Regenerate", [this] () { generator_->GenerateAllChunks(); });
 
         display_->InitImGui();
@@ -144,21 +150,44 @@ public:
     }
 
     void Update(float deltaTime) {
-        camera_->UpdateShader(main_shader_);
+        UniformBuffers *uniform_buffers = UniformBuffers::Instance();
+        uniform_buffers->SetCamera(*camera_);
+        uniform_buffers->SetDirectionalLight(sun_);
+
+        generator_->Update(*camera_);
     }
 
     void LateUpdate(float deltaTime) {
 
     }
 
+    Camera *GetCamera() override {
+        return camera_.get();
+    }
+
+    // Flies a loop over the terrain, streaming chunks in on every leg
+    CameraPath GetBenchmarkPath() override {
+        return CameraPath({
+            {0.f, glm::vec3(0.f, 120.f, 0.f), glm::vec3(200.f, 60.f, 0.f)},
+            {10.f, glm::vec3(1500.f, 160.f, 0.f), glm::vec3(1700.f, 60.f, 200.f)},
+            {20.f, glm::vec3(1500.f, 200.f, 1500.f), glm::vec3(1300.f, 60.f, 1700.f)},
+            {30.f, glm::vec3(0.f, 120.f, 1500.f), glm::vec3(-200.f, 60.f, 1300.f)},
+            {40.f, glm::vec3(0.f, 120.f, 0.f), glm::vec3(200.f, 60.f, 0.f)}
+        });
+    }
+
     void Draw(Display *display) override {
-        main_shader_->Use();
-        glm::mat4 model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(0.0f, 0.0f, 0.0f)); // translate it down so it's at the center of the scene
-        model = glm::scale(model, glm::vec3(1.0f, 1.0f, 1.0f));	// it's a bit too big for our scene, so scale it down
-        main_shader_->SetMat4Uniform("model", model);
+        render_queue_.Clear();
+
+        // The generator binds its patch and chunk textures itself
+        DrawItem terrain;
+        terrain.sort_key = MakeSortKey(main_shader_->programId_, 0, 0, 0.f);
+        terrain.program = main_shader_.get();
+        terrain.transform = render_queue_.AddTransform(glm::mat4(1.0f));
+        terrain.draw = [this] () { generator_->RenderChunks(main_shader_); };
+        render_queue_.Submit(std::move(terrain));
 
-        generator_->RenderChunk(0, 0);
+        render_queue_.Flush();
     }
 };
 #endif // TERRAIN_GENERATION_SCENE
\ No newline at end of file
@@ -0,0 +1,167 @@
+#include "chunk_mesh_builder.h"
+#include "terrain_lod.h"
+#include "../math/batched_noise.h"
+#include "../math/packing.h"
+
+#include <algorithm>
+#include <cmath>
+
+std::vector<float> GenerateNoiseSum(const TerrainParameters &params, int x_offset, int z_offset)
+{
+    int bordered_width = params.chunk_width + 2;
+    int bordered_height = params.chunk_height + 2;
+
+    std::vector<float> noise_values(bordered_width * bordered_height);
+    FractalNoiseParameters noise_params {params.octaves, params.noise_scale, params.persistence, params.lacunarity};
+
+    int x_start = x_offset * (params.chunk_width - 1) - 1;
+    int z_start = z_offset * (params.chunk_height - 1) - 1;
+
+    for(int z = 0; z < bordered_height; z++) {
+        float *row = &noise_values[z * bordered_width];
+        FractalNoiseRow(noise_params, x_start, z_start + z, bordered_width, row);
+    }
+
+    return noise_values;
+}
+
+void UpdateNoiseOctaves(const TerrainParameters &params, int octaves, int x_offset, int z_offset, std::vector<float> &noise_sum)
+{
+    if(octaves == params.octaves) {
+        return;
+    }
+
+    int bordered_width = params.chunk_width + 2;
+    int bordered_height = params.chunk_height + 2;
+
+    // Adding continues the sum in the order a full rebuild would, removing
+    // subtracts the dropped octaves again
+    FractalNoiseParameters noise_params {std::max(octaves, params.octaves), params.noise_scale, params.persistence, params.lacunarity};
+    int first_octave = std::min(octaves, params.octaves);
+    float weight = params.octaves > octaves ? 1.f : -1.f;
+
+    int x_start = x_offset * (params.chunk_width - 1) - 1;
+    int z_start = z_offset * (params.chunk_height - 1) - 1;
+
+    for(int z = 0; z < bordered_height; z++) {
+        float *row = &noise_sum[z * bordered_width];
+        AccumulateFractalNoiseRow(noise_params, first_octave, weight, x_start, z_start + z, bordered_width, row);
+    }
+}
+
+std::vector<float> GenerateHeights(const TerrainParameters &params, const std::vector<float> &noise_sum)
+{
+    std::vector<float> heights(noise_sum.size());
+    FractalNoiseParameters noise_params {params.octaves, params.noise_scale, params.persistence, params.lacunarity};
+
+    float maximum_height = FractalNoiseMaximum(noise_params);
+    float water_level = params.water_height * 0.5f;
+
+    for(size_t i = 0; i < noise_sum.size(); i++) {
+        float noise = (noise_sum[i] + 1) / maximum_height;
+        float eased_noise = std::pow(noise * 1.1f, 3.f);
+        heights[i] = std::fmax(eased_noise, water_level);
+    }
+
+    return heights;
+}
+
+std::vector<glm::vec3> GenerateNormals(const TerrainParameters &params, const std::vector<float> &bordered_heights)
+{
+    int chunk_width = params.chunk_width;
+    int chunk_height = params.chunk_height;
+    int bordered_width = chunk_width + 2;
+
+    std::vector<glm::vec3> normals(chunk_width * chunk_height);
+
+    // Central differences of the height field, (-dh/dx, 1, -dh/dz) scaled by
+    // two. Rows are processed in separate passes over contiguous arrays so the
+    // compiler vectorizes them.
+    std::vector<float> slope_x(chunk_width), slope_z(chunk_width), inverse_length(chunk_width);
+
+    for(int z = 0; z < chunk_height; z++) {
+        const float *above = &bordered_heights[z * bordered_width + 1];
+        const float *row = &bordered_heights[(z + 1) * bordered_width + 1];
+        const float *below = &bordered_heights[(z + 2) * bordered_width + 1];
+
+        for(int x = 0; x < chunk_width; x++) {
+            slope_x[x] = (row[x - 1] - row[x + 1]) * params.mesh_height;
+            slope_z[x] = (above[x] - below[x]) * params.mesh_height;
+        }
+
+        for(int x = 0; x < chunk_width; x++) {
+            inverse_length[x] = 1.f / std::sqrt(slope_x[x] * slope_x[x] + 4.f + slope_z[x] * slope_z[x]);
+        }
+
+        glm::vec3 *normal_row = &normals[z * chunk_width];
+        for(int x = 0; x < chunk_width; x++) {
+            normal_row[x] = glm::vec3(slope_x[x], 2.f, slope_z[x]) * inverse_length[x];
+        }
+    }
+
+    return normals;
+}
+
+std::vector<float> RemoveBorder(const TerrainParameters &params, const std::vector<float> &bordered_heights)
+{
+    int chunk_width = params.chunk_width;
+    int chunk_height = params.chunk_height;
+    int bordered_width = chunk_width + 2;
+
+    std::vector<float> heights(chunk_width * chunk_height);
+
+    for(int z = 0; z < chunk_height; z++) {
+        const float *row = &bordered_heights[(z + 1) * bordered_width + 1];
+        std::copy(row, row + chunk_width, &heights[z * chunk_width]);
+    }
+
+    return heights;
+}
+
+void PackVertices(const std::vector<float> &heights, const std::vector<glm::vec3> &normals, TerrainVertex *vertices)
+{
+    for(size_t i = 0; i < heights.size(); i++) {
+        glm::vec2 octahedral = OctahedralEncode(normals[i]);
+        vertices[i].height = PackUnorm16(heights[i] / kTerrainHeightRange);
+        vertices[i].normal[0] = PackSnorm8(octahedral.x);
+        vertices[i].normal[1] = PackSnorm8(octahedral.y);
+    }
+}
+
+ChunkMesh BuildChunkMesh(const TerrainParameters &params, int x_chunk, int z_chunk,
+                         const ChunkCache *previous, TerrainVertex *staging)
+{
+    ChunkMesh mesh;
+
+    auto cache = std::make_shared<ChunkCache>();
+    cache->params = params;
+
+    // Octave count changes only add or remove layers, everything else but the
+    // shaping and mesh height parameters invalidates the noise
+    bool noise_reusable = previous &&
+        previous->params.noise_scale == params.noise_scale &&
+        previous->params.persistence == params.persistence &&
+        previous->params.lacunarity == params.lacunarity &&
+        previous->params.chunk_width == params.chunk_width &&
+        previous->params.chunk_height == params.chunk_height;
+
+    if(noise_reusable) {
+        cache->noise_sum = previous->noise_sum;
+        UpdateNoiseOctaves(params, previous->params.octaves, x_chunk, z_chunk, cache->noise_sum);
+    } else {
+        cache->noise_sum = GenerateNoiseSum(params, x_chunk, z_chunk);
+    }
+
+    std::vector<float> bordered_heights = GenerateHeights(params, cache->noise_sum);
+    std::vector<glm::vec3> normals = GenerateNormals(params, bordered_heights);
+    std::vector<float> heights = RemoveBorder(params, bordered_heights);
+    if(!staging) {
+        mesh.vertices.resize(heights.size());
+        staging = mesh.vertices.data();
+    }
+    PackVertices(heights, normals, staging);
+    mesh.height_bounds = TerrainLod::BuildHeightBounds(params.chunk_width - 1, heights);
+    mesh.cache = std::move(cache);
+
+    return mesh;
+}
@@ -0,0 +1,71 @@
+#ifndef CHUNK_MESH_BUILDER_H
+#define CHUNK_MESH_BUILDER_H
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// CPU stages of a terrain chunk, free of GL so they run on any thread and in
+// tools without a context.
+
+// Snapshot of the generator settings taken when chunk jobs are scheduled, so
+// the UI can keep editing the sliders while workers are still running.
+struct TerrainParameters {
+    int octaves;
+    float mesh_height;
+    float noise_scale;
+    float persistence;
+    float lacunarity;
+    float water_height;
+    int chunk_width;
+    int chunk_height;
+
+    bool operator==(const TerrainParameters &other) const = default;
+};
+
+// Shaped heights are in units of the mesh height and stored as unorm16 of
+// this range, so the vertical scale is a shader uniform. The fractal sum never
+// exceeds its maximum amplitude, which is at least 1, so normalized noise
+// stays below 2 and GenerateHeights' (noise * 1.1)^3 below 2.2^3.
+constexpr float kTerrainHeightRange = 2.2f * 2.2f * 2.2f;
+
+// Compact chunk vertex, fetched by the vertex shader through a buffer texture.
+// x/z are implicit grid coordinates, the normal is octahedral encoded.
+struct TerrainVertex {
+    uint16_t height;
+    int8_t normal[2];
+};
+static_assert(sizeof(TerrainVertex) == 4, "TerrainVertex has to stay tightly packed");
+
+// Intermediate results a chunk keeps so parameter changes only rerun the
+// stages that depend on them. Never modified once a job has published it.
+struct ChunkCache {
+    TerrainParameters params;
+    // Fractal noise sum of params.octaves octaves before normalization, with a one sample border
+    std::vector<float> noise_sum;
+};
+
+struct ChunkMesh {
+    // Empty when the vertices were packed into caller provided memory
+    std::vector<TerrainVertex> vertices;
+    std::vector<glm::vec2> height_bounds;
+    std::shared_ptr<const ChunkCache> cache;
+};
+
+// Noise and shaped heights carry a one sample border around the chunk, so
+// normals at the chunk edges see the neighbouring samples
+std::vector<float> GenerateNoiseSum(const TerrainParameters &params, int x_offset, int z_offset);
+// Adds or removes octaves of a noise sum of the given octave count until it has params.octaves
+void UpdateNoiseOctaves(const TerrainParameters &params, int octaves, int x_offset, int z_offset, std::vector<float> &noise_sum);
+std::vector<float> GenerateHeights(const TerrainParameters &params, const std::vector<float> &noise_sum);
+std::vector<glm::vec3> GenerateNormals(const TerrainParameters &params, const std::vector<float> &bordered_heights);
+std::vector<float> RemoveBorder(const TerrainParameters &params, const std::vector<float> &bordered_heights);
+void PackVertices(const std::vector<float> &heights, const std::vector<glm::vec3> &normals, TerrainVertex *vertices);
+// Reuses the noise of previous where the parameters allow it, previous may be null.
+// Vertices are packed into staging if it is set, it needs room for the whole chunk.
+ChunkMesh BuildChunkMesh(const TerrainParameters &params, int x_chunk, int z_chunk,
+                         const ChunkCache *previous = nullptr, TerrainVertex *staging = nullptr);
+
+#endif // CHUNK_MESH_BUILDER_H
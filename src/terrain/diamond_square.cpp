@@ -0,0 +1,279 @@
+#include "diamond_square.h"
+#include "../math/batched_noise.h"
+#include "../utils/thread_pool.h"
+
+#include <algorithm>
+#include <limits>
+#include <mutex>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define STEEL_DIAMOND_SQUARE_X86 1
+#include <immintrin.h>
+#endif
+
+namespace {
+// Samples every pool job covers at least, so small passes don't drown in scheduling
+constexpr int kSamplesPerJob = 16384;
+
+// splitmix64 of the sample index, mapped to [-1, 1)
+inline float SampleRandom(uint64_t seed, uint64_t index)
+{
+    uint64_t hash = seed + (index + 1) * 0x9E3779B97F4A7C15ull;
+    hash = (hash ^ (hash >> 30)) * 0xBF58476D1CE4E5B9ull;
+    hash = (hash ^ (hash >> 27)) * 0x94D049BB133111EBull;
+    hash ^= hash >> 31;
+
+    return static_cast<float>(hash >> 40) * (2.f / 16777216.f) - 1.f;
+}
+
+struct PassContext {
+    float *heights;
+    int size;
+    int half;
+    int step;
+    float offset_scale;
+    uint64_t seed;
+    // Rows use the AVX2 kernels, which give the same heights bit for bit
+    bool vectorized;
+};
+
+#ifdef STEEL_DIAMOND_SQUARE_X86
+
+// AVX2: 8 samples of a row per iteration. Samples are step apart, so they are
+// gathered into lanes and written back one by one. AVX2 has no 64-bit
+// multiply, splitmix64 is built from 32-bit ones on 4 lanes at a time.
+
+__attribute__((target("avx2")))
+inline __m256i Multiply64(__m256i a, uint64_t b)
+{
+    __m256i b_low = _mm256_set1_epi64x(static_cast<long long>(b));
+    __m256i b_high = _mm256_set1_epi64x(static_cast<long long>(b >> 32));
+    __m256i cross = _mm256_add_epi64(_mm256_mul_epu32(_mm256_srli_epi64(a, 32), b_low), _mm256_mul_epu32(a, b_high));
+    return _mm256_add_epi64(_mm256_mul_epu32(a, b_low), _mm256_slli_epi64(cross, 32));
+}
+
+// Top 24 bits of the splitmix64 hash of 4 indices, in the low half of every lane
+__attribute__((target("avx2")))
+inline __m256i SampleHash4(uint64_t seed, __m256i index)
+{
+    __m256i hash = _mm256_add_epi64(_mm256_set1_epi64x(static_cast<long long>(seed)),
+                                    Multiply64(_mm256_add_epi64(index, _mm256_set1_epi64x(1)), 0x9E3779B97F4A7C15ull));
+    hash = Multiply64(_mm256_xor_si256(hash, _mm256_srli_epi64(hash, 30)), 0xBF58476D1CE4E5B9ull);
+    hash = Multiply64(_mm256_xor_si256(hash, _mm256_srli_epi64(hash, 27)), 0x94D049BB133111EBull);
+    hash = _mm256_xor_si256(hash, _mm256_srli_epi64(hash, 31));
+    return _mm256_srli_epi64(hash, 40);
+}
+
+// SampleRandom of the indices first_index + i * stride, i in [0, 8)
+__attribute__((target("avx2")))
+inline __m256 SampleRandom8(uint64_t seed, uint64_t first_index, int stride)
+{
+    __m256i lanes = _mm256_setr_epi64x(0, stride, 2ll * stride, 3ll * stride);
+    __m256i first = _mm256_set1_epi64x(static_cast<long long>(first_index));
+    __m256i second = _mm256_set1_epi64x(static_cast<long long>(first_index + 4ull * stride));
+    __m256i low_halves = _mm256_setr_epi32(0, 2, 4, 6, 0, 2, 4, 6);
+
+    __m128i low = _mm256_castsi256_si128(_mm256_permutevar8x32_epi32(SampleHash4(seed, _mm256_add_epi64(first, lanes)), low_halves));
+    __m128i high = _mm256_castsi256_si128(_mm256_permutevar8x32_epi32(SampleHash4(seed, _mm256_add_epi64(second, lanes)), low_halves));
+    __m256 bits = _mm256_cvtepi32_ps(_mm256_inserti128_si256(_mm256_castsi128_si256(low), high, 1));
+
+    return _mm256_sub_ps(_mm256_mul_ps(bits, _mm256_set1_ps(2.f / 16777216.f)), _mm256_set1_ps(1.f));
+}
+
+__attribute__((target("avx2")))
+inline void StoreStrided8(float *row, int x, int step, __m256 values)
+{
+    alignas(32) float lanes[8];
+    _mm256_store_ps(lanes, values);
+    for(int i = 0; i < 8; i++) {
+        row[x + i * step] = lanes[i];
+    }
+}
+
+// Returns the first x left to the scalar loop
+__attribute__((target("avx2")))
+int DiamondRowAVX2(const PassContext &pass, const float *above, const float *below, float *row, uint64_t row_start, int x)
+{
+    int half = pass.half;
+    int step = pass.step;
+    __m256i lanes = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32(step));
+    __m256 offset_scale = _mm256_set1_ps(pass.offset_scale);
+
+    for(; x + 7 * step < pass.size; x += 8 * step) {
+        __m256i left = _mm256_add_epi32(_mm256_set1_epi32(x - half), lanes);
+        __m256i right = _mm256_add_epi32(_mm256_set1_epi32(x + half), lanes);
+
+        __m256 corner_sum = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(
+            _mm256_i32gather_ps(above, left, 4), _mm256_i32gather_ps(above, right, 4)),
+            _mm256_i32gather_ps(below, left, 4)), _mm256_i32gather_ps(below, right, 4));
+        __m256 offset = _mm256_mul_ps(SampleRandom8(pass.seed, row_start + x, step), offset_scale);
+        StoreStrided8(row, x, step, _mm256_add_ps(_mm256_mul_ps(corner_sum, _mm256_set1_ps(0.25f)), offset));
+    }
+    return x;
+}
+
+// Interior samples only, returns the first x left to the scalar loop
+__attribute__((target("avx2")))
+int SquareRowAVX2(const PassContext &pass, const float *above, const float *below, float *row, uint64_t row_start, int x)
+{
+    int half = pass.half;
+    int step = pass.step;
+    __m256i lanes = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32(step));
+    __m256 offset_scale = _mm256_set1_ps(pass.offset_scale);
+
+    for(; x + 7 * step < pass.size - 1; x += 8 * step) {
+        __m256i center = _mm256_add_epi32(_mm256_set1_epi32(x), lanes);
+        __m256i left = _mm256_sub_epi32(center, _mm256_set1_epi32(half));
+        __m256i right = _mm256_add_epi32(center, _mm256_set1_epi32(half));
+
+        __m256 neighbour_sum = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(
+            _mm256_i32gather_ps(row, left, 4), _mm256_i32gather_ps(row, right, 4)),
+            _mm256_i32gather_ps(above, center, 4)), _mm256_i32gather_ps(below, center, 4));
+        __m256 offset = _mm256_mul_ps(SampleRandom8(pass.seed, row_start + x, step), offset_scale);
+        StoreStrided8(row, x, step, _mm256_add_ps(_mm256_mul_ps(neighbour_sum, _mm256_set1_ps(0.25f)), offset));
+    }
+    return x;
+}
+
+#endif // STEEL_DIAMOND_SQUARE_X86
+
+// Centers of the squares of side step get the average of their corners
+void DiamondRow(const PassContext &pass, int z)
+{
+    int half = pass.half;
+    const float *above = pass.heights + (z - half) * pass.size;
+    const float *below = pass.heights + (z + half) * pass.size;
+    float *row = pass.heights + z * pass.size;
+    uint64_t row_start = static_cast<uint64_t>(z) * pass.size;
+
+    int x = half;
+#ifdef STEEL_DIAMOND_SQUARE_X86
+    if(pass.vectorized) {
+        x = DiamondRowAVX2(pass, above, below, row, row_start, x);
+    }
+#endif
+
+    for(; x < pass.size; x += pass.step) {
+        float corner_sum = above[x - half] + above[x + half] + below[x - half] + below[x + half];
+        row[x] = corner_sum * 0.25f + SampleRandom(pass.seed, row_start + x) * pass.offset_scale;
+    }
+}
+
+// Edge samples lack the neighbours outside the map and average the remaining three
+float SquareEdgeSample(const PassContext &pass, int x, int z)
+{
+    const float *heights = pass.heights;
+    int size = pass.size;
+    int half = pass.half;
+
+    float sum = 0.f;
+    int count = 0;
+
+    if(x - half >= 0) { sum += heights[(x - half) + z * size]; count++; }
+    if(x + half < size) { sum += heights[(x + half) + z * size]; count++; }
+    if(z - half >= 0) { sum += heights[x + (z - half) * size]; count++; }
+    if(z + half < size) { sum += heights[x + (z + half) * size]; count++; }
+
+    return sum / count + SampleRandom(pass.seed, static_cast<uint64_t>(z) * size + x) * pass.offset_scale;
+}
+
+// Midpoints of the square edges get the average of their four diamond neighbours
+void SquareRow(const PassContext &pass, int z)
+{
+    int size = pass.size;
+    int half = pass.half;
+    int x_start = (z + half) % pass.step;
+    float *row = pass.heights + z * size;
+
+    if(z == 0 || z == size - 1) {
+        for(int x = x_start; x < size; x += pass.step) {
+            row[x] = SquareEdgeSample(pass, x, z);
+        }
+        return;
+    }
+
+    const float *above = pass.heights + (z - half) * size;
+    const float *below = pass.heights + (z + half) * size;
+    uint64_t row_start = static_cast<uint64_t>(z) * size;
+
+    int x = x_start;
+    if(x == 0) {
+        row[0] = SquareEdgeSample(pass, 0, z);
+        x += pass.step;
+    }
+
+#ifdef STEEL_DIAMOND_SQUARE_X86
+    if(pass.vectorized) {
+        x = SquareRowAVX2(pass, above, below, row, row_start, x);
+    }
+#endif
+
+    for(; x < size - 1; x += pass.step) {
+        float neighbour_sum = row[x - half] + row[x + half] + above[x] + below[x];
+        row[x] = neighbour_sum * 0.25f + SampleRandom(pass.seed, row_start + x) * pass.offset_scale;
+    }
+
+    if(x == size - 1) {
+        row[x] = SquareEdgeSample(pass, x, z);
+    }
+}
+
+// Calls row_function for the rows first_row, first_row + row_step, ... below size in parallel
+template <typename RowFunction>
+void ForEachRow(const PassContext &pass, int first_row, int row_step, int samples_per_row, RowFunction row_function)
+{
+    int row_count = (pass.size - 1 - first_row) / row_step + 1;
+    int grain = std::max(1, kSamplesPerJob / std::max(1, samples_per_row));
+
+    ThreadPool::Instance()->ParallelFor(row_count, grain, [&] (int begin, int end) {
+        for(int i = begin; i < end; i++) {
+            row_function(pass, first_row + i * row_step);
+        }
+    });
+}
+} // namespace
+
+DiamondSquareHeightmap GenerateDiamondSquare(const DiamondSquareParameters &params)
+{
+    DiamondSquareHeightmap heightmap;
+    int size = (1 << params.detail) + 1;
+    heightmap.size = size;
+    heightmap.heights.assign(static_cast<size_t>(size) * size, 0.f);
+
+    float *heights = heightmap.heights.data();
+    int last = size - 1;
+    for(int corner : {0, last, last * size, last + last * size}) {
+        heights[corner] = SampleRandom(params.seed, corner) * params.height;
+    }
+
+    // AVX2 is part of the AVX-512 backend as well
+    bool vectorized = GetNoiseBackend() >= NoiseBackend::AVX2;
+    PassContext pass {heights, size, 0, size - 1, params.height * params.roughness, params.seed, vectorized};
+
+    while(pass.step > 1) {
+        pass.half = pass.step / 2;
+        int cells_per_row = (size - 1) / pass.step + 1;
+
+        // Diamond centers only read corners and square midpoints only read
+        // corners and centers, so the rows of a pass are independent
+        ForEachRow(pass, pass.half, pass.step, cells_per_row, DiamondRow);
+        ForEachRow(pass, 0, pass.half, cells_per_row, SquareRow);
+
+        pass.step /= 2;
+        pass.offset_scale *= 0.5f;
+    }
+
+    std::mutex bounds_mutex;
+    heightmap.min_height = std::numeric_limits<float>::infinity();
+    heightmap.max_height = -std::numeric_limits<float>::infinity();
+
+    ThreadPool::Instance()->ParallelFor(size, std::max(1, kSamplesPerJob / size), [&] (int begin, int end) {
+        auto [min_height, max_height] = std::minmax_element(heights + begin * size, heights + end * size);
+
+        std::lock_guard<std::mutex> lock(bounds_mutex);
+        heightmap.min_height = std::min(heightmap.min_height, *min_height);
+        heightmap.max_height = std::max(heightmap.max_height, *max_height);
+    });
+
+    return heightmap;
+}
@@ -0,0 +1,34 @@
+#ifndef DIAMOND_SQUARE_H
+#define DIAMOND_SQUARE_H
+
+#include <cstdint>
+#include <vector>
+
+struct DiamondSquareParameters {
+    // The heightmap has 2^detail + 1 samples per side
+    int detail = 8;
+    // Corners and random offsets are uniform in [-height, height]
+    float height = 20.f;
+    // Scale of the offsets of the first pass, halved every pass after it
+    float roughness = 20.f;
+    uint64_t seed = 0;
+};
+
+// Row-major heights, sample (x, z) is at x + z * size
+struct DiamondSquareHeightmap {
+    int size = 0;
+    std::vector<float> heights;
+    float min_height = 0.f;
+    float max_height = 0.f;
+
+    float GetHeight(int x, int z) const { return heights[x + z * size]; };
+};
+
+// Every sample's random offset is a hash of the seed and its index, so the
+// passes run in parallel on the thread pool and the result only depends on
+// the parameters. Rows run 8 samples at a time with AVX2 when the noise
+// backend allows it, with the same result as the scalar loops. Safe to run on
+// any thread.
+DiamondSquareHeightmap GenerateDiamondSquare(const DiamondSquareParameters &params);
+
+#endif // DIAMOND_SQUARE_H
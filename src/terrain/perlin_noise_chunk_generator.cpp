@@ -1,178 +1,527 @@
 #include "perlin_noise_chunk_generator.h"
-#include "../math/noise.h"
+#include "../rendering/gl_state_cache.h"
+#include "../utils/profiler.h"
+#include "../utils/thread_pool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+
+namespace {
+// Drops the items whose box is outside the frustum, items and bounds line up
+template <typename T>
+void RemoveCulled(const Frustum &frustum, const std::vector<Aabb> &bounds, std::vector<uint8_t> &visible, std::vector<T> &items)
+{
+    visible.resize(bounds.size());
+    CullAabbs(frustum, bounds.data(), bounds.size(), visible.data());
+
+    size_t kept = 0;
+    for(size_t i = 0; i < items.size(); i++) {
+        if(visible[i]) {
+            items[kept++] = items[i];
+        }
+    }
+    items.resize(kept);
+}
+}
 
 PerlinNoiseChunkGenerator::PerlinNoiseChunkGenerator()
 {
-    chunks_ = std::vector<uint32_t>(x_map_chunks_ * z_map_chunks_);
+    max_pending_chunks_ = ThreadPool::Instance()->GetThreadCount() * 2;
+}
+
+PerlinNoiseChunkGenerator::~PerlinNoiseChunkGenerator()
+{
+    // Outstanding jobs may still write into the mapped upload ring
+    ThreadPool::Instance()->WaitIdle();
 
-    GenerateAllChunks();
+    for(auto &[coord, chunk] : resident_chunks_) {
+        chunk_pool_.push_back(chunk);
+    }
+
+    GlStateCache *state = GlStateCache::Instance();
+    for(TerrainChunk &chunk : chunk_pool_) {
+        state->ForgetTexture(chunk.texture);
+        glDeleteTextures(1, &chunk.texture);
+        glDeleteBuffers(1, &chunk.vbo);
+    }
+
+    state->ForgetVertexArray(lod_patch_.vao);
+    glDeleteVertexArrays(1, &lod_patch_.vao);
+    glDeleteBuffers(1, &lod_patch_.ebo);
+}
+
+TerrainParameters PerlinNoiseChunkGenerator::GetParameters()
+{
+    return TerrainParameters {
+        octaves_, mesh_height_, noise_scale_, persistence_, lacunarity_,
+        water_height_, chunk_width_, chunk_height_
+    };
 }
 
 void PerlinNoiseChunkGenerator::GenerateAllChunks()
 {
-    for(int z = 0; z < z_map_chunks_; z++) {
-        for(int x = 0; x < x_map_chunks_; x++) {
-            GenerateMapChunk(chunks_[x + z * x_map_chunks_], x, z);
-        }
+    for(auto &[coord, chunk] : resident_chunks_) {
+        chunk.cache.reset();
     }
+
+    StartGeneration();
 }
 
-void PerlinNoiseChunkGenerator::GenerateMapChunk(uint32_t &vao, int x_offset, int z_offset)
+void PerlinNoiseChunkGenerator::StartGeneration()
 {
-    std::vector<int> indices;
-    std::vector<float> noise_map;
-    std::vector<float> vertices;
-    std::vector<float> normals;
+    generation_++;
+    finished_chunks_->generation.store(generation_, std::memory_order_relaxed);
+    pending_chunks_.clear();
+}
 
-    indices = CalculateIndices();
-    noise_map = GenerateNoiseMap(x_offset, z_offset);
-    vertices = GenerateVertices(noise_map);
-    normals = GenerateNormals(indices, vertices);
+bool PerlinNoiseChunkGenerator::IsChunkWanted(const ChunkCoord &coord, int margin)
+{
+    if(!streaming_) {
+        return coord.x >= 0 && coord.x < x_map_chunks_ && coord.z >= 0 && coord.z < z_map_chunks_;
+    }
 
-    uint32_t vbo[2], ebo;
+    int dx = coord.x - grid_pos_x_;
+    int dz = coord.z - grid_pos_z_;
+    int radius = chunk_render_distance_ + margin;
+    return dx * dx + dz * dz <= radius * radius;
+}
 
-    glGenBuffers(2, vbo);
-    glGenBuffers(1, &ebo);
-    glGenVertexArrays(1, &vao);
+void PerlinNoiseChunkGenerator::Update(const Camera &camera)
+{
+    STEEL_PROFILE_SCOPE("Terrain Update");
+    int chunk_size_x = chunk_width_ - 1;
+    int chunk_size_z = chunk_height_ - 1;
+
+    if(!upload_ring_.IsCreated()) {
+        // Room for every job in flight while the previous frames' copies are still being fenced
+        size_t chunk_bytes = chunk_width_ * chunk_height_ * sizeof(TerrainVertex);
+        upload_ring_.Create(chunk_bytes * max_pending_chunks_ * 2);
+    }
 
-    glBindVertexArray(vao);
-    glBindBuffer(GL_ARRAY_BUFFER, vbo[0]);
-    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), &vertices[0], GL_STATIC_DRAW);
+    // Changed parameters start a new generation, the chunk caches decide how much of it is rebuilt
+    TerrainParameters params = GetParameters();
+    auto now = std::chrono::steady_clock::now();
+    if(!(params == edited_params_)) {
+        edited_params_ = params;
+        params_edited_at_ = now;
+    } else if(!(params == applied_params_) && now - params_edited_at_ >= kParameterDebounce) {
+        applied_params_ = params;
+        StartGeneration();
+    }
 
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(int), &indices[0], GL_STATIC_DRAW);
+    grid_pos_x_ = static_cast<int>(std::floor(camera.position_.x / chunk_size_x));
+    grid_pos_z_ = static_cast<int>(std::floor(camera.position_.z / chunk_size_z));
 
-    // Vertex Position Attributes
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
+    // Evict with one chunk of hysteresis, so flying along a border doesn't thrash
+    for(auto it = resident_chunks_.begin(); it != resident_chunks_.end();) {
+        if(IsChunkWanted(it->first, 1)) {
+            ++it;
+            continue;
+        }
+        ReleaseChunk(it->second);
+        it = resident_chunks_.erase(it);
+    }
 
-    //
-    glBindBuffer(GL_ARRAY_BUFFER, vbo[1]);
-    glBufferData(GL_ARRAY_BUFFER, normals.size() * sizeof(float), &normals[0], GL_STATIC_DRAW);
+    for(auto it = pending_chunks_.begin(); it != pending_chunks_.end();) {
+        it = IsChunkWanted(it->first, 1) ? std::next(it) : pending_chunks_.erase(it);
+    }
 
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*) 0);
-    glEnableVertexAttribArray(1);
-}
+    UploadFinishedChunks();
 
-std::vector<int> PerlinNoiseChunkGenerator::CalculateIndices()
-{
-    std::vector<int> indices;
-    
-    for (int z = 0; z < chunk_height_; z++)
-        for (int x = 0; x < chunk_width_; x++) {
-            int pos = x + z * chunk_width_;
-            
-            if (x == chunk_width_ - 1 || z == chunk_height_ - 1) {
-                // Don't create indices for right or top edge
+    struct ChunkRequest {
+        ChunkCoord coord;
+        float priority;
+    };
+    std::vector<ChunkRequest> requests;
+
+    glm::vec2 camera_xz(camera.position_.x, camera.position_.z);
+    glm::vec2 front_xz(camera.front_.x, camera.front_.z);
+    if(glm::length(front_xz) > 0.001f) {
+        front_xz = glm::normalize(front_xz);
+    }
+
+    int min_x = streaming_ ? grid_pos_x_ - chunk_render_distance_ : 0;
+    int max_x = streaming_ ? grid_pos_x_ + chunk_render_distance_ : x_map_chunks_ - 1;
+    int min_z = streaming_ ? grid_pos_z_ - chunk_render_distance_ : 0;
+    int max_z = streaming_ ? grid_pos_z_ + chunk_render_distance_ : z_map_chunks_ - 1;
+
+    wanted_chunk_count_ = 0;
+    finished_chunk_count_ = 0;
+
+    for(int z = min_z; z <= max_z; z++) {
+        for(int x = min_x; x <= max_x; x++) {
+            ChunkCoord coord {x, z};
+            if(!IsChunkWanted(coord, 0)) {
                 continue;
-            } else {
-                // Top left triangle of square
-                indices.push_back(pos + chunk_width_);
-                indices.push_back(pos);
-                indices.push_back(pos + chunk_width_ + 1);
-                // Bottom right triangle of square
-                indices.push_back(pos + 1);
-                indices.push_back(pos + 1 + chunk_width_);
-                indices.push_back(pos);
             }
+            wanted_chunk_count_++;
+
+            auto resident = resident_chunks_.find(coord);
+            if(resident != resident_chunks_.end() && resident->second.generation == generation_) {
+                finished_chunk_count_++;
+                continue;
+            }
+
+            if(pending_chunks_.count(coord)) {
+                continue;
+            }
+
+            glm::vec2 center((x + 0.5f) * chunk_size_x, (z + 0.5f) * chunk_size_z);
+            glm::vec2 to_chunk = center - camera_xz;
+            float distance = glm::length(to_chunk);
+
+            // Chunks roughly in front of the camera and the one below it come first
+            bool in_view = distance < chunk_size_x || glm::dot(to_chunk, front_xz) > 0.5f * distance;
+            float priority = in_view ? distance : distance + 2.f * chunk_render_distance_ * chunk_size_x;
+
+            requests.push_back({coord, priority});
         }
+    }
 
-    return indices;
+    std::sort(requests.begin(), requests.end(), [] (const ChunkRequest &a, const ChunkRequest &b) {
+        return a.priority < b.priority;
+    });
+
+    for(const ChunkRequest &request : requests) {
+        if(jobs_in_flight_ >= max_pending_chunks_ || !RequestChunk(request.coord)) {
+            break;
+        }
+    }
+
+    SelectLodNodes(camera);
 }
 
-std::vector<float> PerlinNoiseChunkGenerator::GenerateNoiseMap(int x_offset, int z_offset)
+void PerlinNoiseChunkGenerator::SelectLodNodes(const Camera &camera)
 {
-    std::vector<float> noise_values;
-    std::vector<float> normalized_noise_values; 
-    std::vector<int> p = GetPermutationVector();
+    Frustum frustum = camera.GetFrustum();
+
+    // Chunks outside the view don't take part in the selection at all
+    visible_chunks_.clear();
+    cull_bounds_.clear();
+    for(const auto &[coord, chunk] : resident_chunks_) {
+        glm::vec2 chunk_origin(coord.x * (chunk_width_ - 1.f), coord.z * (chunk_height_ - 1.f));
+        visible_chunks_.push_back({coord, &chunk});
+        cull_bounds_.push_back(lod_.GetChunkBounds(chunk_origin, chunk.height_bounds, mesh_height_));
+    }
+    RemoveCulled(frustum, cull_bounds_, cull_visible_, visible_chunks_);
+
+    std::vector<TerrainLodNode> nodes;
 
-    float amplitude = 1.0f;
-    float frequency = 1.0f;
-    float maximum_height = 0.f;
+    for(int attempt = 0; attempt < 3; attempt++) {
+        lod_.SetRanges(lod_distance_ * lod_budget_scale_);
+        lod_nodes_.clear();
+        cull_bounds_.clear();
 
-    for(int i = 0; i < octaves_; i++) {
-        maximum_height += amplitude;
-        amplitude *= persistence_;
+        for(const auto &[coord, chunk] : visible_chunks_) {
+            glm::vec2 chunk_origin(coord.x * (chunk_width_ - 1.f), coord.z * (chunk_height_ - 1.f));
+
+            nodes.clear();
+            lod_.SelectNodes(camera.position_, chunk_origin, chunk->height_bounds, mesh_height_, nodes);
+
+            for(const TerrainLodNode &node : nodes) {
+                lod_nodes_.push_back({chunk->texture, coord, node});
+                cull_bounds_.push_back(lod_.GetNodeBounds(chunk_origin, chunk->height_bounds, mesh_height_, node));
+            }
+        }
+
+        // Only the nodes left after culling count against the budget
+        RemoveCulled(frustum, cull_bounds_, cull_visible_, lod_nodes_);
+        rendered_triangles_ = 0;
+        for(const LodDrawNode &draw_node : lod_nodes_) {
+            rendered_triangles_ += TerrainLod::NodeTriangles(draw_node.node.quadrant_mask);
+        }
+
+        if(rendered_triangles_ <= triangle_budget_ || lod_distance_ * lod_budget_scale_ <= kMinLodDistance) {
+            break;
+        }
+
+        // Triangle count grows roughly with the square of the LOD distance
+        lod_budget_scale_ *= std::max(0.5f, std::sqrt(static_cast<float>(triangle_budget_) / rendered_triangles_));
     }
 
-    for(int z = 0; z < chunk_height_; z++) {
-        for(int x = 0; x < chunk_width_; x++) {
-            amplitude = 1.f;
-            frequency = 1.f;
+    // Win the distance back slowly once there is room, so it doesn't oscillate around the budget
+    if(rendered_triangles_ < triangle_budget_ * 0.8f) {
+        lod_budget_scale_ = std::min(1.f, lod_budget_scale_ * 1.02f);
+    }
+}
 
-            float height = 0.f;
+bool PerlinNoiseChunkGenerator::RequestChunk(const ChunkCoord &coord)
+{
+    TerrainParameters params = applied_params_;
+
+    // Without a persistent mapping the job packs into its own memory and the
+    // upload goes through the ring on the context thread instead
+    UploadAllocation staging;
+    if(upload_ring_.IsPersistent()) {
+        staging = upload_ring_.Allocate(params.chunk_width * params.chunk_height * sizeof(TerrainVertex));
+        if(!staging.IsValid()) {
+            return false;
+        }
+    }
 
-            for(int i = 0; i < octaves_; i++) {
-                float x_sample = (x + x_offset * (chunk_width_ - 1)) / noise_scale_ * frequency;
-                float z_sample = (z + z_offset * (chunk_height_ - 1)) / noise_scale_ * frequency;
+    pending_chunks_[coord] = generation_;
+    jobs_in_flight_++;
 
-                float perlin_value = PerlinNoise(x_sample, z_sample, p);
-                height += perlin_value * amplitude;
+    uint64_t generation = generation_;
+    std::shared_ptr<FinishedChunkQueue> finished_chunks = finished_chunks_;
 
-                amplitude *= persistence_;
-                frequency *= lacunarity_;
-            }
+    // A resident chunk is rebuilt from its cached stages
+    std::shared_ptr<const ChunkCache> previous;
+    auto resident = resident_chunks_.find(coord);
+    if(resident != resident_chunks_.end()) {
+        previous = resident->second.cache;
+    }
 
-            noise_values.push_back(height);
+    ThreadPool::Instance()->Submit([params, generation, finished_chunks, coord, previous, staging] () {
+        STEEL_PROFILE_SCOPE("Build Chunk");
+        ChunkMeshData data;
+        data.x_chunk = coord.x;
+        data.z_chunk = coord.z;
+        // Outdated before it started, then it is only reported back so its budget and staging are returned
+        if(finished_chunks->generation.load(std::memory_order_relaxed) == generation) {
+            TerrainVertex *vertices = static_cast<TerrainVertex *>(staging.pointer);
+            data.mesh = BuildChunkMesh(params, coord.x, coord.z, previous.get(), vertices);
         }
+        data.generation = generation;
+        data.staging = staging;
+
+        std::lock_guard<std::mutex> lock(finished_chunks->mutex);
+        finished_chunks->chunks.push_back(std::move(data));
+    });
+
+    return true;
+}
+
+PerlinNoiseChunkGenerator::TerrainChunk PerlinNoiseChunkGenerator::AcquireChunk()
+{
+    if(!chunk_pool_.empty()) {
+        TerrainChunk chunk = chunk_pool_.back();
+        chunk_pool_.pop_back();
+        return chunk;
     }
 
-    for(int z = 0; z < chunk_height_; z++) {
-        for(int x = 0; x < chunk_width_; x++) {
-            normalized_noise_values.push_back((noise_values[x + z * chunk_width_] + 1) / maximum_height); 
+    TerrainChunk chunk;
+    glGenBuffers(1, &chunk.vbo);
+    glGenTextures(1, &chunk.texture);
+
+    // Each texel is one packed TerrainVertex
+    glBindBuffer(GL_TEXTURE_BUFFER, chunk.vbo);
+    GlStateCache::Instance()->BindTexture(0, GL_TEXTURE_BUFFER, chunk.texture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_R32UI, chunk.vbo);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+    return chunk;
+}
+
+void PerlinNoiseChunkGenerator::ReleaseChunk(TerrainChunk &chunk)
+{
+    chunk.cache.reset();
+
+    if(static_cast<int>(chunk_pool_.size()) < max_pooled_chunks_) {
+        chunk.generation = 0;
+        chunk_pool_.push_back(chunk);
+        return;
+    }
+
+    GlStateCache::Instance()->ForgetTexture(chunk.texture);
+    glDeleteTextures(1, &chunk.texture);
+    glDeleteBuffers(1, &chunk.vbo);
+}
+
+void PerlinNoiseChunkGenerator::CreateLodPatch()
+{
+    std::vector<uint16_t> indices = CalculatePatchIndices();
+
+    // Attributeless, the vao only holds the element buffer
+    glGenVertexArrays(1, &lod_patch_.vao);
+    glGenBuffers(1, &lod_patch_.ebo);
+
+    GlStateCache::Instance()->BindVertexArray(lod_patch_.vao);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, lod_patch_.ebo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(uint16_t), indices.data(), GL_STATIC_DRAW);
+
+    lod_patch_.quadrant_index_count = static_cast<int>(indices.size()) / 4;
+}
+
+void PerlinNoiseChunkGenerator::UploadFinishedChunks(int max_uploads)
+{
+    STEEL_PROFILE_SCOPE("Upload Chunks");
+    STEEL_PROFILE_GPU_SCOPE("Upload Chunks");
+    std::vector<ChunkMeshData> ready;
+    {
+        std::lock_guard<std::mutex> lock(finished_chunks_->mutex);
+        std::vector<ChunkMeshData> &queue = finished_chunks_->chunks;
+
+        // Outdated results are always taken, they only return their budget and staging
+        auto current = [this] (const ChunkMeshData &data) { return data.generation == generation_; };
+        auto first_current = std::stable_partition(queue.begin(), queue.end(), [&] (const ChunkMeshData &data) { return !current(data); });
+        auto last = first_current + std::min<ptrdiff_t>(max_uploads, queue.end() - first_current);
+        ready.assign(std::make_move_iterator(queue.begin()), std::make_move_iterator(last));
+        queue.erase(queue.begin(), last);
+    }
+
+    jobs_in_flight_ -= static_cast<int>(ready.size());
+
+    for(const ChunkMeshData &data : ready) {
+        ChunkCoord coord {data.x_chunk, data.z_chunk};
+
+        // Results of an outdated regeneration or of an evicted chunk are dropped
+        auto pending = pending_chunks_.find(coord);
+        if(pending == pending_chunks_.end() || pending->second != data.generation) {
+            if(data.staging.IsValid()) {
+                upload_ring_.Release(data.staging);
+            }
+            continue;
         }
+        pending_chunks_.erase(pending);
+
+        auto [resident, inserted] = resident_chunks_.try_emplace(coord);
+        if(inserted) {
+            resident->second = AcquireChunk();
+        }
+
+        UploadChunk(resident->second, data);
     }
 
-    return normalized_noise_values;
+    upload_ring_.EndFrame();
 }
 
-std::vector<float> PerlinNoiseChunkGenerator::GenerateVertices(const std::vector<float> &noise_map)
+void PerlinNoiseChunkGenerator::UploadChunk(TerrainChunk &chunk, const ChunkMeshData &data)
 {
-    std::vector<float> v;
-    
-    for (int z = 0; z < chunk_height_; z++) {
-        for (int x = 0; x < chunk_width_; x++) {
-            v.push_back(x);
+    UploadAllocation staging = data.staging;
+    size_t size = staging.IsValid() ? staging.size : data.mesh.vertices.size() * sizeof(TerrainVertex);
 
-            float eased_noise = std::pow(noise_map[x + z * chunk_width_] * 1.1, 3);
-            v.push_back(std::fmax(eased_noise * mesh_height_, water_height_ * 0.5 * mesh_height_));
-            v.push_back(z);
+    if(!staging.IsValid()) {
+        staging = upload_ring_.Allocate(size);
+        if(staging.IsValid()) {
+            upload_ring_.Write(staging, data.mesh.vertices.data());
         }
     }
-    return v;
+
+    if(!staging.IsValid()) {
+        // Ring is full, orphan the old storage instead of waiting for frames still drawing from it
+        glBindBuffer(GL_TEXTURE_BUFFER, chunk.vbo);
+        glBufferData(GL_TEXTURE_BUFFER, size, data.mesh.vertices.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+        chunk.buffer_size = size;
+    } else {
+        if(size != chunk.buffer_size) {
+            glBindBuffer(GL_TEXTURE_BUFFER, chunk.vbo);
+            glBufferData(GL_TEXTURE_BUFFER, size, nullptr, GL_STATIC_DRAW);
+            glBindBuffer(GL_TEXTURE_BUFFER, 0);
+            chunk.buffer_size = size;
+        }
+
+        // The copy is ordered after the draws still reading the old contents on
+        // the GPU, so neither side has to wait
+        upload_ring_.CopyToBuffer(staging, chunk.vbo, 0);
+        upload_ring_.Release(staging);
+    }
+
+    chunk.generation = data.generation;
+    chunk.height_bounds = data.mesh.height_bounds;
+    chunk.cache = data.mesh.cache;
 }
 
-std::vector<float> PerlinNoiseChunkGenerator::GenerateNormals(const std::vector<int> &indices, const std::vector<float> &vertices)
+std::vector<uint16_t> PerlinNoiseChunkGenerator::CalculatePatchIndices()
 {
-    int pos;
-    glm::vec3 normal;
-    std::vector<float> normals;
-    std::vector<glm::vec3> verts;
+    std::vector<uint16_t> indices;
+    int patch_width = kLodPatchSize + 1;
+    int half_size = kLodPatchSize / 2;
+
+    indices.reserve(kLodPatchSize * kLodPatchSize * 6);
 
-    for(int i = 0; i < indices.size(); i += 3) {
-        for(int j = 0; j < 3; j++) {
-            pos = indices[i + j] * 3;
-            verts.push_back(glm::vec3(vertices[pos], vertices[pos + 1], vertices[pos + 2]));
+    // One contiguous range per quadrant, in TerrainLodNode::quadrant_mask bit order
+    for(int quadrant = 0; quadrant < 4; quadrant++) {
+        int x_start = (quadrant & 1) * half_size;
+        int z_start = (quadrant >> 1) * half_size;
+
+        for(int z = z_start; z < z_start + half_size; z++) {
+            for(int x = x_start; x < x_start + half_size; x++) {
+                int pos = x + z * patch_width;
+
+                // Top left triangle of square
+                indices.push_back(pos + patch_width);
+                indices.push_back(pos);
+                indices.push_back(pos + patch_width + 1);
+                // Bottom right triangle of square
+                indices.push_back(pos + 1);
+                indices.push_back(pos + 1 + patch_width);
+                indices.push_back(pos);
+            }
         }
+    }
+
+    return indices;
+}
 
-        glm::vec3 U = verts[i + 1] - verts[i]; // 
-        glm::vec3 V = verts[i + 2] - verts[i];
+void PerlinNoiseChunkGenerator::SetChunkUniforms(std::unique_ptr<ShaderProgram> &shader)
+{
+    if(!lod_patch_.vao) {
+        CreateLodPatch();
+    }
 
-        normal = glm::normalize(-glm::cross(U, V));
-        normals.push_back(normal.x);
-        normals.push_back(normal.y);
-        normals.push_back(normal.z);
+    shader->SetFloatUniform("heightScale", kTerrainHeightRange * mesh_height_);
+    shader->SetFloatUniform("meshHeight", mesh_height_);
+    shader->SetFloatUniform("waterHeight", water_height_);
+    shader->SetIntUniform("chunkWidth", chunk_width_);
+    shader->SetIntUniform("patchWidth", kLodPatchSize + 1);
+    shader->SetSamplerUniform(shader->GetUniformLocation("heightmap"), 0);
+
+    if(node_uniforms_.program != shader->GetGeneration()) {
+        node_uniforms_.program = shader->GetGeneration();
+        node_uniforms_.chunk_offset = shader->GetUniformLocation("chunkOffset");
+        node_uniforms_.node_origin = shader->GetUniformLocation("nodeOrigin");
+        node_uniforms_.node_step = shader->GetUniformLocation("nodeStep");
+        node_uniforms_.morph_constants = shader->GetUniformLocation("morphConstants");
     }
 
-    return normals;
+    GlStateCache::Instance()->BindVertexArray(lod_patch_.vao);
 }
 
-void PerlinNoiseChunkGenerator::RenderChunk(int x_chunk, int z_chunk)
+void PerlinNoiseChunkGenerator::DrawNode(std::unique_ptr<ShaderProgram> &shader, const LodDrawNode &draw_node)
 {
-    
-    glBindVertexArray(chunks_[x_chunk + z_chunk * x_map_chunks_]);
-    glDrawElements(GL_TRIANGLES, chunk_width_ * chunk_height_ * 6, GL_UNSIGNED_INT, 0);
-    glBindVertexArray(0);
+    const TerrainLodNode &node = draw_node.node;
+
+    shader->SetVec2Uniform(node_uniforms_.chunk_offset, draw_node.coord.x * (chunk_width_ - 1.f), draw_node.coord.z * (chunk_height_ - 1.f));
+    shader->SetVec2Uniform(node_uniforms_.node_origin, static_cast<float>(node.x), static_cast<float>(node.z));
+    shader->SetFloatUniform(node_uniforms_.node_step, static_cast<float>(node.size) / kLodPatchSize);
+    shader->SetVec2Uniform(node_uniforms_.morph_constants, lod_.GetMorphConstants(node.level));
+
+    GlStateCache::Instance()->BindTexture(0, GL_TEXTURE_BUFFER, draw_node.texture);
+
+    if(node.quadrant_mask == 0xF) {
+        glDrawElements(GL_TRIANGLES, lod_patch_.quadrant_index_count * 4, GL_UNSIGNED_SHORT, 0);
+        return;
+    }
+
+    for(int quadrant = 0; quadrant < 4; quadrant++) {
+        if(node.quadrant_mask & (1 << quadrant)) {
+            size_t offset = quadrant * lod_patch_.quadrant_index_count * sizeof(uint16_t);
+            glDrawElements(GL_TRIANGLES, lod_patch_.quadrant_index_count, GL_UNSIGNED_SHORT, (void*)offset);
+        }
+    }
 }
 
+void PerlinNoiseChunkGenerator::RenderChunk(std::unique_ptr<ShaderProgram> &shader, int x_chunk, int z_chunk)
+{
+    ChunkCoord coord {x_chunk, z_chunk};
+
+    SetChunkUniforms(shader);
+    for(const LodDrawNode &draw_node : lod_nodes_) {
+        if(draw_node.coord == coord) {
+            DrawNode(shader, draw_node);
+        }
+    }
+}
 
+void PerlinNoiseChunkGenerator::RenderChunks(std::unique_ptr<ShaderProgram> &shader)
+{
+    STEEL_PROFILE_SCOPE("Render Terrain");
+    STEEL_PROFILE_GPU_SCOPE("Terrain");
+    SetChunkUniforms(shader);
+    for(const LodDrawNode &draw_node : lod_nodes_) {
+        DrawNode(shader, draw_node);
+    }
+}
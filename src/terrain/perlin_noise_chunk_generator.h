@@ -1,28 +1,84 @@
-
 #ifndef PERLIN_NOISE_CHUNK_GENERATOR_H
 #define PERLIN_NOISE_CHUNK_GENERATOR_H
 
 #include "../rendering/mesh.h"
+#include "../rendering/upload_ring.h"
+#include "../objects/camera.h"
+#include "chunk_mesh_builder.h"
+#include "terrain_lod.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
 #include <vector>
 
+struct ChunkCoord {
+    int x;
+    int z;
+
+    bool operator==(const ChunkCoord &other) const { return x == other.x && z == other.z; }
+};
+
+struct ChunkCoordHash {
+    size_t operator()(const ChunkCoord &coord) const {
+        return std::hash<uint64_t>()((static_cast<uint64_t>(static_cast<uint32_t>(coord.x)) << 32) | static_cast<uint32_t>(coord.z));
+    }
+};
+
+// CPU side result of a chunk job, waiting to be uploaded on the context thread.
+struct ChunkMeshData {
+    int x_chunk;
+    int z_chunk;
+    uint64_t generation;
+    // Vertices went straight into this staging region when it is valid,
+    // otherwise they are in mesh.vertices
+    UploadAllocation staging;
+    ChunkMesh mesh;
+};
+
 class PerlinNoiseChunkGenerator {
 public:
     PerlinNoiseChunkGenerator();
-    std::vector<int> CalculateIndices();
-    std::vector<float> GenerateNoiseMap(int xOffset, int zOffset);
-    std::vector<float> GenerateVertices(const std::vector<float> &noiseMap);
-    std::vector<float> GenerateNormals(const std::vector<int> &indices, const std::vector<float> &vertices);
-    
+    ~PerlinNoiseChunkGenerator();
+
+    // CPU stages, safe to run on any thread
+    static std::vector<uint16_t> CalculatePatchIndices();
+
+    // Rebuilds every wanted chunk from scratch with the current parameters.
+    // Chunks of the previous generation stay renderable until their replacement
+    // is uploaded. Parameter changes are picked up by Update without this, and
+    // only rerun the stages they affect.
+    void GenerateAllChunks();
+
+    // Streams chunks around the camera (or the fixed map when streaming is off):
+    // evicts distant chunks, requests missing or outdated ones nearest and in-view first and
+    // uploads finished ones, then picks the LOD nodes to draw this frame.
+    // Has to be called on the context thread every frame.
+    void Update(const Camera &camera);
+    void UploadFinishedChunks(int max_uploads = 4);
+
+    void SetStreaming(bool streaming) { streaming_ = streaming; };
+    bool IsStreaming() { return streaming_; };
 
-    void GenerateMapChunk(uint32_t &VAO, int xOffset, int zOffset);
+    void RenderChunk(std::unique_ptr<ShaderProgram> &shader, int x_chunk, int z_chunk);
+    void RenderChunks(std::unique_ptr<ShaderProgram> &shader);
 
-    void RenderChunk(int xChunk, int zChunk);
+    int GetChunkCount() { return wanted_chunk_count_; };
+    int GetFinishedChunkCount() { return finished_chunk_count_; };
+    bool IsGenerationComplete() { return finished_chunk_count_ == wanted_chunk_count_; };
+    float GetProgress() { return wanted_chunk_count_ ? static_cast<float>(finished_chunk_count_) / wanted_chunk_count_ : 1.f; };
+    int GetResidentChunkCount() { return static_cast<int>(resident_chunks_.size()); };
+    int GetRenderedTriangleCount() { return rendered_triangles_; };
 
     int GetChunkWidth() {return chunk_width_; };
     int GetChunkHeight() {return chunk_height_; };
     float GetWaterHeight() { return water_height_; };
     float GetMeshHeight() { return mesh_height_; };
-    void GenerateAllChunks();
+    TerrainParameters GetParameters();
 
     // Noise parameters
     int octaves_ = 8;
@@ -31,23 +87,121 @@ public:
     float persistence_ = 0.5;
     float lacunarity_ = 2;
 
+    // Radius in chunks around the camera that is kept resident while streaming
+    int chunk_render_distance_ = 3;
+
+    // Distance up to which terrain is drawn at full resolution, every LOD level doubles it
+    float lod_distance_ = 192;
+    // Triangles drawn per frame at most, the LOD distance shrinks to stay below it
+    int triangle_budget_ = 1000000;
+
 private:
+    struct TerrainChunk {
+        uint32_t vbo = 0;
+        // Buffer texture over the vbo, the vertex shader fetches heights and normals from it
+        uint32_t texture = 0;
+        uint64_t generation = 0;
+        size_t buffer_size = 0;
+        std::vector<glm::vec2> height_bounds;
+        std::shared_ptr<const ChunkCache> cache;
+    };
+
+    // Grid every LOD node is drawn with, its indices are ordered by quadrant so
+    // partially covered nodes can draw a subrange. Vertices come from gl_VertexID.
+    struct LodPatch {
+        uint32_t vao = 0;
+        uint32_t ebo = 0;
+        int quadrant_index_count = 0;
+    };
+
+    // Uniforms set for every node, resolved once per shader program
+    struct NodeUniforms {
+        // ShaderProgram generation they were resolved for
+        uint64_t program = 0;
+        GLint chunk_offset = -1;
+        GLint node_origin = -1;
+        GLint node_step = -1;
+        GLint morph_constants = -1;
+    };
+
+    struct LodDrawNode {
+        uint32_t texture;
+        ChunkCoord coord;
+        TerrainLodNode node;
+    };
 
+    // Shared with the jobs so they never touch the generator itself
+    struct FinishedChunkQueue {
+        std::mutex mutex;
+        std::vector<ChunkMeshData> chunks;
+        // Live generation, jobs of an older one skip the build
+        std::atomic<uint64_t> generation {1};
+    };
 
     // Map parameters
     float water_height_ = 0.1f;
-    int chunk_render_distance_ = 3;
     int x_map_chunks_ = 1;
     int z_map_chunks_ = 1;
-    int chunk_width_ = 256;
-    int chunk_height_ = 256;
+    // 2^n + 1 vertices, so the LOD quadtree divides chunks evenly
+    int chunk_width_ = 257;
+    int chunk_height_ = 257;
+
+    // Chunk the camera is currently in
     int grid_pos_x_ = 0;
     int grid_pos_z_ = 0;
-    float origin_x_ = (chunk_width_ * x_map_chunks_) / 2 - chunk_width_ / 2;
-    float origin_z_ = (chunk_height_ * z_map_chunks_) / 2 - chunk_height_ / 2;
 
-    std::vector<uint32_t> chunks_;
+    bool streaming_ = true;
+    // Pool jobs in flight at once, kept low so requests follow the camera
+    int max_pending_chunks_ = 8;
+    // Submitted jobs whose result hasn't been picked up yet, outdated ones included
+    int jobs_in_flight_ = 0;
+    // Released chunk buffers kept around for reuse
+    int max_pooled_chunks_ = 8;
+
+    // Jobs pack their vertices into this ring, uploads are GPU side copies out of it
+    UploadRing upload_ring_;
+
+    std::unordered_map<ChunkCoord, TerrainChunk, ChunkCoordHash> resident_chunks_;
+    // Requested chunks and the generation they were requested with
+    std::unordered_map<ChunkCoord, uint64_t, ChunkCoordHash> pending_chunks_;
+    std::vector<TerrainChunk> chunk_pool_;
+
+    TerrainLod lod_ {chunk_width_ - 1};
+    LodPatch lod_patch_;
+    NodeUniforms node_uniforms_;
+    std::vector<LodDrawNode> lod_nodes_;
+    // Frustum culling scratch, kept around so selection doesn't allocate every frame
+    std::vector<std::pair<ChunkCoord, const TerrainChunk *>> visible_chunks_;
+    std::vector<Aabb> cull_bounds_;
+    std::vector<uint8_t> cull_visible_;
+    // Shrinks the LOD distance while the triangle budget is exceeded
+    float lod_budget_scale_ = 1.f;
+    int rendered_triangles_ = 0;
+
+    std::shared_ptr<FinishedChunkQueue> finished_chunks_ = std::make_shared<FinishedChunkQueue>();
+    uint64_t generation_ = 1;
+    // Parameters of the current generation
+    TerrainParameters applied_params_ = GetParameters();
+    // Edited parameters are applied once they stopped changing for a moment,
+    // so dragging a slider doesn't start a generation every frame
+    static constexpr std::chrono::milliseconds kParameterDebounce {150};
+    TerrainParameters edited_params_ = applied_params_;
+    std::chrono::steady_clock::time_point params_edited_at_;
+    int wanted_chunk_count_ = 0;
+    int finished_chunk_count_ = 0;
 
+    // Outstanding jobs still finish, their results no longer match a request and are dropped
+    void StartGeneration();
+    bool IsChunkWanted(const ChunkCoord &coord, int margin);
+    // Fails while the upload ring has no room for the chunk
+    bool RequestChunk(const ChunkCoord &coord);
+    void ReleaseChunk(TerrainChunk &chunk);
+    TerrainChunk AcquireChunk();
+    void UploadChunk(TerrainChunk &chunk, const ChunkMeshData &data);
+    void SelectLodNodes(const Camera &camera);
+    void CreateLodPatch();
+    void SetChunkUniforms(std::unique_ptr<ShaderProgram> &shader);
+    void DrawNode(std::unique_ptr<ShaderProgram> &shader, const LodDrawNode &draw_node);
 };
 
-#endif // PERLIN_NOISE_CHUNK_GENERATOR_H
\ No newline at end of file
+#endif // PERLIN_NOISE_CHUNK_GENERATOR_H
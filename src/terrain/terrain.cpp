@@ -12,8 +12,8 @@ DiamondSquareTerrain::DiamondSquareTerrain(int n, float worldScale, Shader sh)
     this->terrainSize = pow(2, n) + 1;
     this->worldScale = worldScale;
 
-    gen = std::mt19937(rd());
-    dis = std::uniform_real_distribution(-height, height);
+    params.detail = n;
+    params.seed = (static_cast<uint64_t>(rd()) << 32) | rd();
 
     generateTerrain();
 
@@ -30,99 +30,10 @@ DiamondSquareTerrain::DiamondSquareTerrain(int n, float worldScale, Shader sh)
 // Using Diamond-Square Algorithm
 void DiamondSquareTerrain::initTerrain()
 {
-    min = INFINITY;
-    max = -INFINITY;
+    heightMap = GenerateDiamondSquare(params);
 
-    heightMap = std::vector<std::vector<float>>(terrainSize);
-
-    for(int i = 0; i < terrainSize; i++) {
-        heightMap[i] = std::vector<float>(terrainSize);
-    }
-
-    for(int x = 0; x < terrainSize; x++) {
-        for(int z = 0; z < terrainSize; z++) {
-            heightMap[x][z] = 0.f;
-        }
-    }
-    
-    // Init Corners
-    heightMap[0][0] = dis(gen);
-    heightMap[terrainSize - 1][0] = dis(gen);
-    heightMap[0][terrainSize - 1] = dis(gen);
-    heightMap[terrainSize - 1][terrainSize - 1] = dis(gen);
-
-    diamondSquare(terrainSize);
-}
-
-void DiamondSquareTerrain::diamondSquare(int size) {
-    int step = size;
-
-    while(step > 1) {
-        int half = step / 2;
-
-        diamondStep(half, step);
-        squareStep(half, step);
-
-        step /= 2;
-        height /= 2;
-
-    }
-}
-
-void DiamondSquareTerrain::diamondStep(int half, int step) {
-    for(int x = half; x < terrainSize; x += step) {
-        for(int z = half; z < terrainSize; z += step) {
-            float cornerSum = 0.f;
-            cornerSum += heightMap[x - half][z - half];
-            cornerSum += heightMap[x + half][z - half];
-            cornerSum += heightMap[x - half][z + half];
-            cornerSum += heightMap[x + half][z + half];
-
-            cornerSum /= 4;
-            cornerSum += dis(gen) * height;
-            heightMap[x][z] = cornerSum;
-            
-            if(cornerSum > max) max = cornerSum;
-            if(cornerSum < min) min = cornerSum;
-        }
-    }
-    
-}
-
-void DiamondSquareTerrain::squareStep(int half, int step)
-{
-    for (int x = 0; x < terrainSize; x += half) {
-	    for (int z = (x + half) % step; z < terrainSize; z += step) {
-            float cornerSum = 0.f;
-            int count = 0;
-
-		    if (x - half >= 0) {
-		    	cornerSum += heightMap[x - half][z];
-		    	count++;
-		    }
-		    
-            if (x + half < terrainSize) {
-		    	cornerSum += heightMap[x + half][z];
-		    	count++;
-		    }
-		    
-            if (z - half >= 0) {
-		    	cornerSum += heightMap[x][z - half];
-		    	count++;
-		    }
-		    
-            if (z + half < terrainSize) {
-		    	cornerSum += heightMap[x][z + half];
-		    	count++;
-		    }
-
-            cornerSum /= count;
-            cornerSum += dis(gen) * height;
-            heightMap[x][z] = cornerSum;
-            if(cornerSum > max) max = cornerSum;
-            if(cornerSum < min) min = cornerSum;
-        }
-    }
+    min = heightMap.min_height;
+    max = heightMap.max_height;
 }
 
 void DiamondSquareTerrain::generateTerrain()
@@ -143,10 +54,10 @@ void DiamondSquareTerrain::fillMesh()
             glm::vec3 normal(1.f);
             Vertex v;
             if (x > 0 && x < terrainSize - 1 && z > 0 && z < terrainSize - 1) {
-                float left = heightMap[x - 1][z];
-                float right = heightMap[x + 1][z];
-                float up = heightMap[x][z + 1];
-                float down = heightMap[x][z - 1];
+                float left = heightMap.GetHeight(x - 1, z);
+                float right = heightMap.GetHeight(x + 1, z);
+                float up = heightMap.GetHeight(x, z + 1);
+                float down = heightMap.GetHeight(x, z - 1);
 
                 float gradient_x = (right - left) / 2.0f;
                 float gradient_z = (up - down) / 2.0f;
@@ -190,7 +101,7 @@ void DiamondSquareTerrain::Render()
 
 float DiamondSquareTerrain::getHeight(int x, int z)
 {
-    return heightMap[x][z];
+    return heightMap.GetHeight(x, z);
 }
 
 float DiamondSquareTerrain::getWorldScale()
@@ -6,6 +6,7 @@
 
 #include "../utils/shader.h"
 #include "../rendering/mesh.h"
+#include "diamond_square.h"
 
 class BaseTerrain {
 public:
@@ -31,7 +32,6 @@ public:
     void Render();
     float getHeight(int x, int y);
     float getWorldScale();
-    void diamondSquare(int size);
     void generateTerrain();
     void fillMesh();
     void updateHeight(float scale);
@@ -39,19 +39,14 @@ public:
 private:    
     int terrainSize = 0;
     float worldScale = 1.0f;
-    std::vector<std::vector<float>> heightMap;
-    float height = 20.0f;
+    DiamondSquareParameters params;
+    DiamondSquareHeightmap heightMap;
 
     std::random_device rd;
-    std::mt19937 gen;
-    std::uniform_real_distribution<float> dis;
 
     int maxLocation = -1;
     int minLocation = -1;
 
-    void diamondStep(int half, int step);
-    void squareStep(int half, int step);
-
 };
 
 #endif
\ No newline at end of file
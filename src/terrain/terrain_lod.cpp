@@ -0,0 +1,191 @@
+#include "terrain_lod.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+TerrainLod::TerrainLod(int chunk_size)
+    : chunk_size_(chunk_size), level_count_(LevelCount(chunk_size))
+{
+    int offset = 0;
+    for(int level = 0; level < level_count_; level++) {
+        level_offsets_.push_back(offset);
+        int nodes = chunk_size_ / (kLodPatchSize << level);
+        offset += nodes * nodes;
+    }
+
+    SetRanges(4.f * kLodPatchSize);
+}
+
+int TerrainLod::LevelCount(int chunk_size)
+{
+    int levels = 1;
+    while((kLodPatchSize << levels) <= chunk_size) {
+        levels++;
+    }
+    return levels;
+}
+
+std::vector<glm::vec2> TerrainLod::BuildHeightBounds(int chunk_size, const std::vector<float> &heights)
+{
+    int width = chunk_size + 1;
+    int levels = LevelCount(chunk_size);
+    std::vector<glm::vec2> bounds;
+
+    // Finest level straight from the heightmap, borders included
+    int nodes = chunk_size / kLodPatchSize;
+    for(int z = 0; z < nodes; z++) {
+        for(int x = 0; x < nodes; x++) {
+            glm::vec2 node_bounds(std::numeric_limits<float>::max(), std::numeric_limits<float>::lowest());
+
+            for(int row = z * kLodPatchSize; row <= (z + 1) * kLodPatchSize; row++) {
+                for(int column = x * kLodPatchSize; column <= (x + 1) * kLodPatchSize; column++) {
+                    float height = heights[column + row * width];
+                    node_bounds.x = std::min(node_bounds.x, height);
+                    node_bounds.y = std::max(node_bounds.y, height);
+                }
+            }
+            bounds.push_back(node_bounds);
+        }
+    }
+
+    // Coarser levels merge their four children
+    int child_offset = 0;
+    for(int level = 1; level < levels; level++) {
+        int child_nodes = nodes;
+        nodes /= 2;
+
+        for(int z = 0; z < nodes; z++) {
+            for(int x = 0; x < nodes; x++) {
+                glm::vec2 node_bounds(std::numeric_limits<float>::max(), std::numeric_limits<float>::lowest());
+
+                for(int child = 0; child < 4; child++) {
+                    int child_x = x * 2 + (child & 1);
+                    int child_z = z * 2 + (child >> 1);
+                    glm::vec2 child_bounds = bounds[child_offset + child_x + child_z * child_nodes];
+                    node_bounds.x = std::min(node_bounds.x, child_bounds.x);
+                    node_bounds.y = std::max(node_bounds.y, child_bounds.y);
+                }
+                bounds.push_back(node_bounds);
+            }
+        }
+        child_offset += child_nodes * child_nodes;
+    }
+
+    return bounds;
+}
+
+void TerrainLod::SetRanges(float lod_distance)
+{
+    lod_distance = std::max(lod_distance, kMinLodDistance);
+    ranges_.resize(level_count_);
+    for(int level = 0; level < level_count_; level++) {
+        ranges_[level] = lod_distance * static_cast<float>(1 << level);
+    }
+}
+
+glm::vec2 TerrainLod::GetMorphConstants(int level) const
+{
+    // The root level has nothing coarser to morph into
+    if(level >= level_count_ - 1) {
+        return glm::vec2(1.f, 0.f);
+    }
+
+    float end = ranges_[level];
+    float start = end - (end - (level > 0 ? ranges_[level - 1] : 0.f)) * kLodMorphRatio;
+    return glm::vec2(end / (end - start), 1.f / (end - start));
+}
+
+int TerrainLod::SelectNodes(const glm::vec3 &camera_position, const glm::vec2 &chunk_origin,
+                            const std::vector<glm::vec2> &height_bounds, float height_scale,
+                            std::vector<TerrainLodNode> &nodes) const
+{
+    SelectionContext context {camera_position, chunk_origin, &height_bounds, height_scale, &nodes, 0};
+
+    // Resident chunks are always drawn, past the last range at root resolution
+    if(!SelectNode(context, level_count_ - 1, 0, 0)) {
+        AddNode(context, level_count_ - 1, 0, 0, 0xF);
+    }
+
+    return context.triangles;
+}
+
+bool TerrainLod::SelectNode(SelectionContext &context, int level, int x, int z) const
+{
+    float distance = DistanceToNode(context, level, x, z);
+
+    // Out of range, the parent covers this area
+    if(distance > ranges_[level]) {
+        return false;
+    }
+
+    if(level == 0 || distance > ranges_[level - 1]) {
+        AddNode(context, level, x, z, 0xF);
+        return true;
+    }
+
+    uint8_t quadrant_mask = 0;
+    for(int child = 0; child < 4; child++) {
+        if(!SelectNode(context, level - 1, x * 2 + (child & 1), z * 2 + (child >> 1))) {
+            quadrant_mask |= 1 << child;
+        }
+    }
+
+    if(quadrant_mask) {
+        AddNode(context, level, x, z, quadrant_mask);
+    }
+    return true;
+}
+
+void TerrainLod::AddNode(SelectionContext &context, int level, int x, int z, uint8_t quadrant_mask) const
+{
+    int size = kLodPatchSize << level;
+    context.nodes->push_back({x * size, z * size, size, level, quadrant_mask});
+    context.triangles += NodeTriangles(quadrant_mask);
+}
+
+int TerrainLod::NodeTriangles(uint8_t quadrant_mask)
+{
+    int quadrant_triangles = kLodPatchSize * kLodPatchSize / 2;
+    int triangles = 0;
+    for(int quadrant = 0; quadrant < 4; quadrant++) {
+        if(quadrant_mask & (1 << quadrant)) {
+            triangles += quadrant_triangles;
+        }
+    }
+    return triangles;
+}
+
+Aabb TerrainLod::GetNodeBounds(const glm::vec2 &chunk_origin, const std::vector<glm::vec2> &height_bounds,
+                               float height_scale, const TerrainLodNode &node) const
+{
+    int nodes = chunk_size_ / node.size;
+    int index = level_offsets_[node.level] + node.x / node.size + (node.z / node.size) * nodes;
+    glm::vec2 node_heights = height_bounds[index] * height_scale;
+
+    Aabb bounds;
+    bounds.min = glm::vec3(chunk_origin.x + node.x, node_heights.x, chunk_origin.y + node.z);
+    bounds.max = glm::vec3(bounds.min.x + node.size, node_heights.y, bounds.min.z + node.size);
+    return bounds;
+}
+
+Aabb TerrainLod::GetChunkBounds(const glm::vec2 &chunk_origin, const std::vector<glm::vec2> &height_bounds,
+                                float height_scale) const
+{
+    TerrainLodNode root {0, 0, kLodPatchSize << (level_count_ - 1), level_count_ - 1, 0xF};
+    return GetNodeBounds(chunk_origin, height_bounds, height_scale, root);
+}
+
+float TerrainLod::DistanceToNode(const SelectionContext &context, int level, int x, int z) const
+{
+    int size = kLodPatchSize << level;
+    int nodes = chunk_size_ / size;
+    glm::vec2 height_bounds = (*context.height_bounds)[level_offsets_[level] + x + z * nodes] * context.height_scale;
+
+    glm::vec3 box_min(context.chunk_origin.x + x * size, height_bounds.x, context.chunk_origin.y + z * size);
+    glm::vec3 box_max = box_min + glm::vec3(size, 0.f, size);
+    box_max.y = height_bounds.y;
+
+    glm::vec3 closest = glm::clamp(context.camera_position, box_min, box_max);
+    return glm::length(context.camera_position - closest);
+}
@@ -0,0 +1,89 @@
+#ifndef TERRAIN_LOD_H
+#define TERRAIN_LOD_H
+
+#include <glm/glm.hpp>
+
+#include "../math/frustum.h"
+
+#include <cstdint>
+#include <vector>
+
+// Quads along one side of the patch mesh every LOD node is drawn with
+constexpr int kLodPatchSize = 32;
+// Part of a level's range, from its end, in which vertices morph into the next coarser grid
+constexpr float kLodMorphRatio = 0.3f;
+// Shorter level ranges let vertices reach a coarser neighbour before their morph is complete
+constexpr float kMinLodDistance = 3.f * kLodPatchSize;
+
+// Node picked for drawing, position and size in grid units relative to its chunk
+struct TerrainLodNode {
+    int x;
+    int z;
+    int size;
+    int level;
+    // Patch quadrants to draw (bit cx + 2 * cz), quadrants covered by finer nodes are left out
+    uint8_t quadrant_mask;
+};
+
+// Continuous distance-dependent LOD (CDLOD) on a quadtree per chunk. Every node
+// is drawn with the same patch of kLodPatchSize quads; level 0 nodes sample
+// the heightmap at full resolution and every level above doubles node size and
+// grid step. Vertices morph into the next coarser grid before the range of
+// their level ends, so neighbouring levels meet without cracks.
+class TerrainLod {
+public:
+    // chunk_size is the number of quads along a chunk side, a power of two multiple of the patch
+    explicit TerrainLod(int chunk_size);
+
+    static int LevelCount(int chunk_size);
+
+    // Min/max height of every quadtree node, finest level first. Safe to run on any thread.
+    static std::vector<glm::vec2> BuildHeightBounds(int chunk_size, const std::vector<float> &heights);
+
+    // Level 0 ends at lod_distance, every level above reaches twice as far
+    void SetRanges(float lod_distance);
+
+    // Appends the nodes of one chunk and returns the number of triangles they draw
+    int SelectNodes(const glm::vec3 &camera_position, const glm::vec2 &chunk_origin,
+                    const std::vector<glm::vec2> &height_bounds, float height_scale,
+                    std::vector<TerrainLodNode> &nodes) const;
+
+    // World space box of a node selected for the chunk at chunk_origin
+    Aabb GetNodeBounds(const glm::vec2 &chunk_origin, const std::vector<glm::vec2> &height_bounds,
+                       float height_scale, const TerrainLodNode &node) const;
+    // Box of the whole chunk, the bounds of its root node
+    Aabb GetChunkBounds(const glm::vec2 &chunk_origin, const std::vector<glm::vec2> &height_bounds,
+                        float height_scale) const;
+    // Triangles a node draws with the quadrants of its mask
+    static int NodeTriangles(uint8_t quadrant_mask);
+
+    // (end / (end - start), 1 / (end - start)) of the distances over which vertices
+    // of a level morph into the next coarser grid, the shader's morph factor is
+    // 1 - clamp(x - distance * y, 0, 1)
+    glm::vec2 GetMorphConstants(int level) const;
+
+    int GetLevelCount() const { return level_count_; };
+    int GetChunkSize() const { return chunk_size_; };
+
+private:
+    int chunk_size_;
+    int level_count_;
+    std::vector<float> ranges_;
+    // Start of every level in the height bounds
+    std::vector<int> level_offsets_;
+
+    struct SelectionContext {
+        glm::vec3 camera_position;
+        glm::vec2 chunk_origin;
+        const std::vector<glm::vec2> *height_bounds;
+        float height_scale;
+        std::vector<TerrainLodNode> *nodes;
+        int triangles;
+    };
+
+    bool SelectNode(SelectionContext &context, int level, int x, int z) const;
+    void AddNode(SelectionContext &context, int level, int x, int z, uint8_t quadrant_mask) const;
+    float DistanceToNode(const SelectionContext &context, int level, int x, int z) const;
+};
+
+#endif // TERRAIN_LOD_H
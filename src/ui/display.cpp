@@ -1,4 +1,5 @@
 #include "display.h"
+#include "../utils/profiler.h"
 
 #include <iostream>
 #include <sstream>
@@ -6,12 +7,22 @@
 #include <filesystem>
 namespace fs = std::filesystem;
 
-Display::Display(uint64_t width, uint64_t height, const char *title) {
+Display::Display(uint64_t width, uint64_t height, const char *title, bool headless) : headless_(headless) {
     
     last_time_ = glfwGetTime();
 
     // Setup glfw window
-    if (!glfwInit())
+    bool initialized = glfwInit();
+#ifdef GLFW_PLATFORM_NULL
+    if (!initialized && headless_)
+    {
+        // No display server, e.g. a build machine: render with Mesa's OSMesa software rasterizer
+        glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_NULL);
+        initialized = glfwInit();
+        glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_OSMESA_CONTEXT_API);
+    }
+#endif
+    if (!initialized)
     {
         std::cerr << "Failed to init GLFW" << std::endl; 
         exit(-1);
@@ -20,6 +31,10 @@ Display::Display(uint64_t width, uint64_t height, const char *title) {
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 1);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    if (headless_)
+    {
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    }
 
     window_ = glfwCreateWindow(width, height, title, NULL, NULL);
 
@@ -38,11 +53,16 @@ Display::Display(uint64_t width, uint64_t height, const char *title) {
 
     glfwSwapInterval(0);
 
-    if (gl3wInit()) {
+    // gl3w's own loader only knows GLX/WGL, GLFW also resolves OSMesa and EGL contexts
+    if (gl3wInit2(reinterpret_cast<GL3WGetProcAddressProc>(glfwGetProcAddress))) {
         std::cerr << "Failed to init gl3w" << std::endl;
         exit(-1);
     }
 
+    if (headless_) {
+        CreateOffscreenFramebuffer(width, height);
+    }
+
     // Setup Dear ImGui context
     IMGUI_CHECKVERSION();
     ImGui::CreateContext();
@@ -64,7 +84,59 @@ Display::Display(uint64_t width, uint64_t height, const char *title) {
 
 Display::~Display()
 {
-    
+    for(GLsync fence : frame_fences_) {
+        if(fence) {
+            glDeleteSync(fence);
+        }
+    }
+    if(offscreen_framebuffer_) {
+        glDeleteFramebuffers(1, &offscreen_framebuffer_);
+        glDeleteRenderbuffers(1, &offscreen_color_);
+        glDeleteRenderbuffers(1, &offscreen_depth_);
+    }
+}
+
+void Display::CreateOffscreenFramebuffer(GLsizei width, GLsizei height)
+{
+    // Pixels of a hidden window's default framebuffer may fail the ownership test and never be shaded
+    glGenRenderbuffers(1, &offscreen_color_);
+    glBindRenderbuffer(GL_RENDERBUFFER, offscreen_color_);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+
+    glGenRenderbuffers(1, &offscreen_depth_);
+    glBindRenderbuffer(GL_RENDERBUFFER, offscreen_depth_);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glGenFramebuffers(1, &offscreen_framebuffer_);
+    glBindFramebuffer(GL_FRAMEBUFFER, offscreen_framebuffer_);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, offscreen_color_);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, offscreen_depth_);
+
+    if(glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        std::cerr << "Offscreen framebuffer is incomplete" << std::endl;
+        exit(-1);
+    }
+
+    // Stays bound, nothing else in the engine switches framebuffers
+    glViewport(0, 0, width, height);
+}
+
+void Display::Present()
+{
+    if(!headless_) {
+        glfwSwapBuffers(window_);
+        return;
+    }
+
+    // Without a swap chain nothing throttles the CPU, wait for the frame kHeadlessFramesInFlight back instead
+    GLsync &fence = frame_fences_[frame_fence_index_];
+    if(fence) {
+        glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+        glDeleteSync(fence);
+    }
+    fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    frame_fence_index_ = (frame_fence_index_ + 1) % kHeadlessFramesInFlight;
 }
 
 bool Display::IsClosed()
@@ -94,6 +166,11 @@ void Display::Close()
 
 void Display::DrawImGuis()
 {
+    // Nobody looks at a headless frame, the UI would only skew the timings
+    if(headless_) {
+        return;
+    }
+
     ImGui_ImplOpenGL3_NewFrame();
     ImGui_ImplGlfw_NewFrame();
     ImGui::NewFrame();
@@ -111,12 +188,16 @@ void Display::DrawImGuis()
                 if(ImGui::Button(button->name_.c_str())) {
                     button->callback_();
                 }
+            } else if(ImGuiCustomWidget *custom_widget = dynamic_cast<ImGuiCustomWidget *>(widget)) {
+                custom_widget->draw_();
             }
         }
         ImGui::End();   
         
     }
 
+    STEEL_PROFILE_SCOPE("ImGui Render");
+    STEEL_PROFILE_GPU_SCOPE("ImGui");
     ImGui::Render();
     ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
 }
@@ -158,6 +239,14 @@ void Display::AddButton(std::string ui_name, std::string button_text, ImGuiButto
     im_gui_windows_[ui_name].push_back(button);
 }
 
+void Display::AddCustomWidget(std::string ui_name, std::string widget_name, ImGuiDrawCallback draw)
+{
+    ImGuiCustomWidget *custom_widget = new ImGuiCustomWidget();
+    custom_widget->name_ = widget_name;
+    custom_widget->draw_ = draw;
+    im_gui_windows_[ui_name].push_back(custom_widget);
+}
+
 void Display::UpdateDeltaTime()
 {
     double current_time = glfwGetTime();
@@ -9,6 +9,7 @@
 #include "../../dependencies/imgui/backends/imgui_impl_glfw.h"
 #include "../../dependencies/imgui/backends/imgui_impl_opengl3.h"
 
+#include <array>
 #include <functional>
 
 #include <unordered_map>
@@ -16,6 +17,7 @@
 #include <string>
 
 using ImGuiButtonCallback = std::function<void()>;
+using ImGuiDrawCallback = std::function<void()>;
 
 struct ImGuiWidget {
     std::string name_;
@@ -58,16 +60,32 @@ struct ImGuiButton : public ImGuiWidget {
     }
 };
 
+// Draws arbitrary ImGui content into its window
+struct ImGuiCustomWidget : public ImGuiWidget {
+    ImGuiDrawCallback draw_;
+
+    void PrintName() const override {
+
+    }
+};
+
 
 class Display {
 public:
-    Display(uint64_t width, uint64_t height, const char *title);
+    // A headless display renders into an offscreen framebuffer behind a hidden
+    // window, or GLFW's null platform with OSMesa when there is no display server
+    Display(uint64_t width, uint64_t height, const char *title, bool headless = false);
     ~Display();
     bool IsClosed();
     void Update(bool draw, bool pollevents);
     void Clear(GLfloat r, GLfloat g, GLfloat b);
     bool ShouldClose();
     void Close();
+    bool IsHeadless() const { return headless_; };
+
+    // Swaps the window, or in headless mode waits until at most
+    // kHeadlessFramesInFlight frames are queued on the GPU
+    void Present();
     // void AddButton (Button b);
     // void CheckButtons(double x, double y);
 
@@ -75,6 +93,7 @@ public:
     void AddIntSlider(std::string ui_name, std::string value_name, int *value, int min, int max);
     void AddFloatSlider(std::string ui_name, std::string value_name, float *value, float min, float max);
     void AddButton(std::string ui_name, std::string button_text, ImGuiButtonCallback callback);
+    void AddCustomWidget(std::string ui_name, std::string widget_name, ImGuiDrawCallback draw);
 
     void InitImGui();
     void ShutdownImGui();
@@ -89,12 +108,23 @@ public:
     float last_time_ = 0.0f;
 
 private:
+    static constexpr int kHeadlessFramesInFlight = 2;
+
     ImGuiIO io_;
 
     GLFWwindow *window_;
     // std::vector<Button> buttons;
     bool is_display_closed_;
 
+    bool headless_ = false;
+    GLuint offscreen_framebuffer_ = 0;
+    GLuint offscreen_color_ = 0;
+    GLuint offscreen_depth_ = 0;
+    std::array<GLsync, kHeadlessFramesInFlight> frame_fences_ {};
+    int frame_fence_index_ = 0;
+
+    void CreateOffscreenFramebuffer(GLsizei width, GLsizei height);
+
     std::unordered_map<std::string, std::list<ImGuiWidget*>> im_gui_windows_;
 };
 
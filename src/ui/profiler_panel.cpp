@@ -0,0 +1,135 @@
+#include "profiler_panel.h"
+
+#include "imgui.h"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+namespace {
+const float kRowHeight = 18.f;
+const float kLabelWidth = 90.f;
+
+// Stable color per scope name, so a scope keeps its color across frames
+ImU32 ScopeColor(const char *name)
+{
+    uint32_t hash = 2166136261u;
+    for(const char *c = name; *c; c++) {
+        hash = (hash ^ static_cast<uint8_t>(*c)) * 16777619u;
+    }
+    float hue = (hash % 360) / 360.f;
+    float r, g, b;
+    ImGui::ColorConvertHSVtoRGB(hue, 0.55f, 0.85f, r, g, b);
+    return ImGui::GetColorU32(ImVec4(r, g, b, 1.f));
+}
+
+float ToMs(uint64_t ns)
+{
+    return static_cast<float>(ns) / 1000000.f;
+}
+
+// One labelled row with its events stacked by depth, returns the height used
+float DrawTimelineRow(ImDrawList *draw_list, ImVec2 origin, float width, const char *label,
+                      const std::vector<const ProfileEvent *> &events, uint64_t begin_ns, uint64_t end_ns)
+{
+    uint32_t max_depth = 0;
+    for(const ProfileEvent *event : events) {
+        max_depth = std::max(max_depth, event->depth);
+    }
+    float height = (max_depth + 1) * kRowHeight;
+
+    draw_list->AddText(ImVec2(origin.x, origin.y + 2.f), ImGui::GetColorU32(ImGuiCol_Text), label);
+
+    float timeline_x = origin.x + kLabelWidth;
+    float timeline_width = width - kLabelWidth;
+    double ns_to_px = timeline_width / static_cast<double>(std::max<uint64_t>(end_ns - begin_ns, 1));
+
+    ImVec2 mouse = ImGui::GetIO().MousePos;
+    for(const ProfileEvent *event : events) {
+        // GPU events can run past the end of the frame that issued them
+        uint64_t event_begin = std::clamp(event->begin_ns, begin_ns, end_ns);
+        uint64_t event_end = std::clamp(event->end_ns, begin_ns, end_ns);
+
+        ImVec2 min(timeline_x + static_cast<float>((event_begin - begin_ns) * ns_to_px), origin.y + event->depth * kRowHeight);
+        ImVec2 max(timeline_x + static_cast<float>((event_end - begin_ns) * ns_to_px), min.y + kRowHeight - 1.f);
+        max.x = std::max(max.x, min.x + 1.f);
+
+        draw_list->AddRectFilled(min, max, ScopeColor(event->name));
+        if(max.x - min.x > ImGui::CalcTextSize(event->name).x + 4.f) {
+            draw_list->AddText(ImVec2(min.x + 2.f, min.y + 2.f), IM_COL32(0, 0, 0, 255), event->name);
+        }
+
+        if(mouse.x >= min.x && mouse.x < max.x && mouse.y >= min.y && mouse.y < max.y) {
+            ImGui::SetTooltip("%s\n%.3f ms", event->name, ToMs(event->end_ns - event->begin_ns));
+        }
+    }
+
+    return height + 4.f;
+}
+}
+
+void DrawProfilerPanel(Profiler &profiler)
+{
+    ImGui::Checkbox("Pause", &profiler.paused_);
+
+    const std::deque<ProfileFrame> &frames = profiler.GetFrames();
+    if(frames.empty()) {
+        ImGui::Text("No frames recorded");
+        return;
+    }
+
+    std::vector<float> frame_times;
+    frame_times.reserve(frames.size());
+    float total_ms = 0.f;
+    float max_ms = 0.f;
+    for(const ProfileFrame &frame : frames) {
+        float ms = ToMs(frame.end_ns - frame.begin_ns);
+        frame_times.push_back(ms);
+        total_ms += ms;
+        max_ms = std::max(max_ms, ms);
+    }
+
+    ImGui::PlotLines("Frame ms", frame_times.data(), static_cast<int>(frame_times.size()), 0, nullptr, 0.f, max_ms * 1.1f, ImVec2(0.f, 60.f));
+    ImGui::Text("avg %.2f ms  max %.2f ms  dropped events %llu", total_ms / frame_times.size(), max_ms,
+                static_cast<unsigned long long>(profiler.GetDroppedEventCount()));
+
+    // GPU events trail the CPU by a few frames, show the newest frame that has them
+    const ProfileFrame *frame = &frames.back();
+    for(auto it = frames.rbegin(); it != frames.rend(); it++) {
+        if(it->gpu_resolved) {
+            frame = &*it;
+            break;
+        }
+    }
+    ImGui::Text("Frame %llu, %.2f ms", static_cast<unsigned long long>(frame->index), ToMs(frame->end_ns - frame->begin_ns));
+
+    std::vector<std::string> thread_names = profiler.GetThreadNames();
+    std::vector<std::vector<const ProfileEvent *>> thread_events(thread_names.size());
+    for(const ProfileEvent &event : frame->cpu_events) {
+        if(event.thread < thread_events.size()) {
+            thread_events[event.thread].push_back(&event);
+        }
+    }
+    std::vector<const ProfileEvent *> gpu_events;
+    for(const ProfileEvent &event : frame->gpu_events) {
+        gpu_events.push_back(&event);
+    }
+
+    ImDrawList *draw_list = ImGui::GetWindowDrawList();
+    ImVec2 origin = ImGui::GetCursorScreenPos();
+    float width = std::max(ImGui::GetContentRegionAvail().x, kLabelWidth + 100.f);
+    float y = origin.y;
+
+    for(size_t i = 0; i < thread_names.size(); i++) {
+        if(thread_events[i].empty()) {
+            continue;
+        }
+        y += DrawTimelineRow(draw_list, ImVec2(origin.x, y), width, thread_names[i].c_str(), thread_events[i], frame->begin_ns, frame->end_ns);
+    }
+    if(!gpu_events.empty()) {
+        y += DrawTimelineRow(draw_list, ImVec2(origin.x, y), width, "GPU", gpu_events, frame->begin_ns, frame->end_ns);
+    }
+
+    // Reserve the space drawn into so the window scrolls and sizes correctly
+    ImGui::Dummy(ImVec2(width, y - origin.y));
+}
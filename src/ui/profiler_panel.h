@@ -0,0 +1,11 @@
+#ifndef PROFILER_PANEL_H
+#define PROFILER_PANEL_H
+
+#include "../utils/profiler.h"
+
+// Frame time graph and a timeline of the latest frame with GPU results, one
+// row per thread plus one for the GPU, scopes stacked by depth. Draws into the
+// current ImGui window.
+void DrawProfilerPanel(Profiler &profiler);
+
+#endif // PROFILER_PANEL_H
@@ -0,0 +1,72 @@
+#include "frame_timing_log.h"
+
+#include <algorithm>
+#include <iostream>
+#include <numeric>
+
+namespace {
+void PrintStatistics(const char *label, std::vector<float> times)
+{
+    if(times.empty()) {
+        std::fprintf(stderr, "  %-4s no samples\n", label);
+        return;
+    }
+
+    std::sort(times.begin(), times.end());
+    auto percentile = [&times] (float p) { return times[static_cast<size_t>(p * (times.size() - 1) + .5f)]; };
+    float average = std::accumulate(times.begin(), times.end(), 0.f) / times.size();
+
+    std::fprintf(stderr, "  %-4s avg %7.3f  p50 %7.3f  p95 %7.3f  p99 %7.3f  max %7.3f ms\n",
+                label, average, percentile(.5f), percentile(.95f), percentile(.99f), times.back());
+}
+}
+
+FrameTimingLog::FrameTimingLog(const std::filesystem::path &path)
+{
+    file_ = path.empty() ? stdout : std::fopen(path.string().c_str(), "w");
+    if(!file_) {
+        std::cout << "Failed to open frame timing log: " << path.string() << std::endl;
+        return;
+    }
+    std::fprintf(file_, "frame,cpu_ms,gpu_ms\n");
+}
+
+FrameTimingLog::~FrameTimingLog()
+{
+    if(file_ && file_ != stdout) {
+        std::fclose(file_);
+    }
+}
+
+void FrameTimingLog::Record(const ProfileFrame &frame)
+{
+    float cpu_ms = (frame.end_ns - frame.begin_ns) / 1000000.f;
+    cpu_ms_.push_back(cpu_ms);
+
+    float gpu_ms = 0.f;
+    for(const ProfileEvent &event : frame.gpu_events) {
+        if(event.depth == 0) {
+            gpu_ms += (std::max(event.end_ns, event.begin_ns) - event.begin_ns) / 1000000.f;
+        }
+    }
+    if(frame.gpu_resolved) {
+        gpu_ms_.push_back(gpu_ms);
+    }
+
+    if(!file_) {
+        return;
+    }
+    // Frames whose queries were not ready in time leave the GPU column empty
+    if(frame.gpu_resolved) {
+        std::fprintf(file_, "%llu,%.4f,%.4f\n", static_cast<unsigned long long>(frame.index), cpu_ms, gpu_ms);
+    } else {
+        std::fprintf(file_, "%llu,%.4f,\n", static_cast<unsigned long long>(frame.index), cpu_ms);
+    }
+}
+
+void FrameTimingLog::PrintSummary() const
+{
+    std::fprintf(stderr, "%zu frames\n", cpu_ms_.size());
+    PrintStatistics("CPU", cpu_ms_);
+    PrintStatistics("GPU", gpu_ms_);
+}
@@ -0,0 +1,33 @@
+#ifndef FRAME_TIMING_LOG_H
+#define FRAME_TIMING_LOG_H
+
+#include "profiler.h"
+
+#include <cstdio>
+#include <filesystem>
+#include <vector>
+
+// Per-frame CPU and GPU times of profiler frames as CSV, plus a percentile
+// summary. GPU time is the sum of the frame's top level GPU scopes.
+class FrameTimingLog {
+public:
+    // An empty path writes the CSV to stdout
+    explicit FrameTimingLog(const std::filesystem::path &path);
+    ~FrameTimingLog();
+
+    FrameTimingLog(FrameTimingLog &other) = delete;
+
+    void operator=(const FrameTimingLog &) = delete;
+
+    void Record(const ProfileFrame &frame);
+
+    // Prints frame count, average and percentiles to stderr, apart from the CSV
+    void PrintSummary() const;
+
+private:
+    std::FILE *file_ = nullptr;
+    std::vector<float> cpu_ms_;
+    std::vector<float> gpu_ms_;
+};
+
+#endif // FRAME_TIMING_LOG_H
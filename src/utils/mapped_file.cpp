@@ -0,0 +1,107 @@
+#include "mapped_file.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::~MappedFile()
+{
+    Close();
+}
+
+#ifdef _WIN32
+
+bool MappedFile::Open(const std::string &path)
+{
+    Close();
+
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if(file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+
+    LARGE_INTEGER size;
+    if(!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+        CloseHandle(file);
+        return false;
+    }
+
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if(!mapping) {
+        CloseHandle(file);
+        return false;
+    }
+
+    void *data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if(!data) {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        return false;
+    }
+
+    file_ = file;
+    mapping_ = mapping;
+    data_ = static_cast<const uint8_t *>(data);
+    size_ = static_cast<size_t>(size.QuadPart);
+    return true;
+}
+
+void MappedFile::Close()
+{
+    if(data_) UnmapViewOfFile(data_);
+    if(mapping_) CloseHandle(mapping_);
+    if(file_) CloseHandle(file_);
+
+    data_ = nullptr;
+    mapping_ = nullptr;
+    file_ = nullptr;
+    size_ = 0;
+}
+
+#else
+
+bool MappedFile::Open(const std::string &path)
+{
+    Close();
+
+    int file = open(path.c_str(), O_RDONLY);
+    if(file < 0) {
+        return false;
+    }
+
+    struct stat status;
+    if(fstat(file, &status) != 0 || status.st_size == 0) {
+        close(file);
+        return false;
+    }
+
+    void *data = mmap(nullptr, status.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+    // The mapping stays valid after the descriptor is closed
+    close(file);
+    if(data == MAP_FAILED) {
+        return false;
+    }
+
+    data_ = static_cast<const uint8_t *>(data);
+    size_ = static_cast<size_t>(status.st_size);
+    return true;
+}
+
+void MappedFile::Close()
+{
+    if(data_) {
+        munmap(const_cast<uint8_t *>(data_), size_);
+    }
+
+    data_ = nullptr;
+    size_ = 0;
+}
+
+#endif
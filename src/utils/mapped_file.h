@@ -0,0 +1,34 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Read-only memory mapping of a whole file
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile();
+
+    MappedFile(const MappedFile &) = delete;
+    void operator=(const MappedFile &) = delete;
+
+    // Fails for missing and empty files
+    bool Open(const std::string &path);
+    void Close();
+
+    bool IsOpen() const { return data_ != nullptr; };
+    const uint8_t *GetData() const { return data_; };
+    size_t GetSize() const { return size_; };
+
+private:
+    const uint8_t *data_ = nullptr;
+    size_t size_ = 0;
+#ifdef _WIN32
+    void *file_ = nullptr;
+    void *mapping_ = nullptr;
+#endif
+};
+
+#endif // MAPPED_FILE_H
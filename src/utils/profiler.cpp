@@ -0,0 +1,290 @@
+#include "profiler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+
+Profiler *Profiler::profiler_ = nullptr;
+
+namespace {
+const std::chrono::steady_clock::time_point kProfilerEpoch = std::chrono::steady_clock::now();
+
+// Open CPU scopes on this thread
+thread_local uint32_t scope_depth = 0;
+}
+
+Profiler::Profiler() = default;
+
+Profiler::~Profiler()
+{
+    if(!gpu_available_) {
+        return;
+    }
+
+    for(GpuFrame &gpu_frame : gpu_frames_) {
+        for(const GpuScope &scope : gpu_frame.scopes) {
+            free_queries_.push_back(scope.begin_query);
+            free_queries_.push_back(scope.end_query);
+        }
+    }
+    if(!free_queries_.empty()) {
+        glDeleteQueries(static_cast<GLsizei>(free_queries_.size()), free_queries_.data());
+    }
+}
+
+Profiler *Profiler::Instance()
+{
+    // Pool workers name their threads through it while the main thread starts up
+    static std::once_flag created;
+    std::call_once(created, [] () { profiler_ = new Profiler(); });
+    return profiler_;
+}
+
+uint64_t Profiler::Now() const
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - kProfilerEpoch).count();
+}
+
+Profiler::ThreadRing &Profiler::GetThreadRing()
+{
+    thread_local ThreadRing *thread_ring = nullptr;
+    if(!thread_ring) {
+        std::lock_guard<std::mutex> lock(threads_mutex_);
+        thread_rings_.push_back(std::make_unique<ThreadRing>());
+        thread_ring = thread_rings_.back().get();
+        thread_ring->index = static_cast<uint32_t>(thread_names_.size());
+        thread_names_.push_back("Thread " + std::to_string(thread_ring->index));
+    }
+    return *thread_ring;
+}
+
+void Profiler::SetThreadName(const std::string &name)
+{
+    ThreadRing &thread_ring = GetThreadRing();
+    std::lock_guard<std::mutex> lock(threads_mutex_);
+    thread_names_[thread_ring.index] = name;
+}
+
+std::vector<std::string> Profiler::GetThreadNames()
+{
+    std::lock_guard<std::mutex> lock(threads_mutex_);
+    return thread_names_;
+}
+
+uint64_t Profiler::GetDroppedEventCount()
+{
+    std::lock_guard<std::mutex> lock(threads_mutex_);
+    uint64_t dropped = 0;
+    for(const std::unique_ptr<ThreadRing> &thread_ring : thread_rings_) {
+        dropped += thread_ring->dropped.load(std::memory_order_relaxed);
+    }
+    return dropped;
+}
+
+void Profiler::RecordCpuEvent(const char *name, uint64_t begin_ns, uint64_t end_ns, uint32_t depth)
+{
+    ThreadRing &thread_ring = GetThreadRing();
+
+    uint64_t write = thread_ring.write.load(std::memory_order_relaxed);
+    if(write - thread_ring.read.load(std::memory_order_acquire) >= kThreadRingCapacity) {
+        thread_ring.dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    thread_ring.events[write % kThreadRingCapacity] = {name, begin_ns, end_ns, thread_ring.index, depth};
+    thread_ring.write.store(write + 1, std::memory_order_release);
+}
+
+void Profiler::DrainThreadRings(std::vector<ProfileEvent> &events)
+{
+    // The lock only guards the list of rings, threads keep recording meanwhile
+    std::lock_guard<std::mutex> lock(threads_mutex_);
+    for(const std::unique_ptr<ThreadRing> &thread_ring : thread_rings_) {
+        uint64_t read = thread_ring->read.load(std::memory_order_relaxed);
+        uint64_t write = thread_ring->write.load(std::memory_order_acquire);
+        for(; read < write; read++) {
+            events.push_back(thread_ring->events[read % kThreadRingCapacity]);
+        }
+        thread_ring->read.store(write, std::memory_order_release);
+    }
+}
+
+void Profiler::BeginFrame()
+{
+    uint64_t now = Now();
+
+    if(frame_running_) {
+        current_frame_.end_ns = now;
+        DrainThreadRings(current_frame_.cpu_events);
+        pending_frames_.push_back(std::move(current_frame_));
+    } else {
+        // Timestamp queries are core since 3.3, the first frame runs with a current context
+        gpu_available_ = glQueryCounter && glGetInteger64v && glGetQueryObjectui64v;
+    }
+
+    current_frame_ = ProfileFrame {};
+    current_frame_.index = next_frame_index_++;
+    current_frame_.begin_ns = now;
+    frame_running_ = true;
+
+    if(gpu_available_) {
+        // The slot was last used kGpuFrameLatency frames ago, its queries have most likely finished
+        GpuFrame &gpu_frame = gpu_frames_[current_frame_.index % kGpuFrameLatency];
+        ResolveGpuFrame(gpu_frame);
+
+        GLint64 gpu_now = 0;
+        glGetInteger64v(GL_TIMESTAMP, &gpu_now);
+        gpu_frame.frame_index = current_frame_.index;
+        gpu_frame.gpu_sync_ns = gpu_now;
+        gpu_frame.cpu_sync_ns = Now();
+        gpu_depth_ = 0;
+    }
+
+    // Every slot older than the one just resolved is done with
+    while(!pending_frames_.empty() && (!gpu_available_ || pending_frames_.front().index + kGpuFrameLatency <= current_frame_.index)) {
+        FinishFrame(pending_frames_.front());
+        pending_frames_.pop_front();
+    }
+}
+
+void Profiler::Flush()
+{
+    if(!frame_running_) {
+        return;
+    }
+
+    current_frame_.end_ns = Now();
+    DrainThreadRings(current_frame_.cpu_events);
+    pending_frames_.push_back(std::move(current_frame_));
+    current_frame_ = ProfileFrame {};
+    frame_running_ = false;
+
+    if(gpu_available_) {
+        for(const ProfileFrame &frame : pending_frames_) {
+            ResolveGpuFrame(gpu_frames_[frame.index % kGpuFrameLatency], true);
+        }
+    }
+
+    while(!pending_frames_.empty()) {
+        FinishFrame(pending_frames_.front());
+        pending_frames_.pop_front();
+    }
+}
+
+void Profiler::SetFrameListener(ProfileFrameListener listener)
+{
+    frame_listener_ = std::move(listener);
+}
+
+void Profiler::FinishFrame(ProfileFrame &frame)
+{
+    if(frame_listener_) {
+        frame_listener_(frame);
+    }
+
+    if(!paused_) {
+        frames_.push_back(std::move(frame));
+        if(frames_.size() > kFrameHistory) {
+            frames_.pop_front();
+        }
+    }
+}
+
+void Profiler::ResolveGpuFrame(GpuFrame &gpu_frame, bool wait)
+{
+    if(gpu_frame.scopes.empty()) {
+        return;
+    }
+
+    // Queries finish in order, the last issued one being available covers the rest.
+    // When waiting, reading GL_QUERY_RESULT below blocks until they are.
+    GLuint available = GL_TRUE;
+    if(!wait) {
+        glGetQueryObjectuiv(gpu_frame.last_query, GL_QUERY_RESULT_AVAILABLE, &available);
+    }
+
+    ProfileFrame *frame = nullptr;
+    for(auto it = pending_frames_.rbegin(); it != pending_frames_.rend(); it++) {
+        if(it->index == gpu_frame.frame_index) {
+            frame = &*it;
+            break;
+        }
+    }
+
+    if(!available) {
+        // Waiting would stall the pipeline, the frame goes without GPU events
+        dropped_gpu_frames_++;
+    } else if(frame) {
+        auto to_cpu_time = [&gpu_frame] (GLuint64 timestamp) {
+            int64_t cpu_time = static_cast<int64_t>(gpu_frame.cpu_sync_ns) + (static_cast<int64_t>(timestamp) - gpu_frame.gpu_sync_ns);
+            return static_cast<uint64_t>(std::max<int64_t>(0, cpu_time));
+        };
+
+        for(const GpuScope &scope : gpu_frame.scopes) {
+            GLuint64 begin = 0;
+            GLuint64 end = 0;
+            glGetQueryObjectui64v(scope.begin_query, GL_QUERY_RESULT, &begin);
+            glGetQueryObjectui64v(scope.end_query, GL_QUERY_RESULT, &end);
+            frame->gpu_events.push_back({scope.name, to_cpu_time(begin), to_cpu_time(end), kGpuThread, scope.depth});
+        }
+        frame->gpu_resolved = true;
+    }
+
+    for(const GpuScope &scope : gpu_frame.scopes) {
+        free_queries_.push_back(scope.begin_query);
+        free_queries_.push_back(scope.end_query);
+    }
+    gpu_frame.scopes.clear();
+}
+
+GLuint Profiler::AcquireQuery()
+{
+    if(free_queries_.empty()) {
+        GLuint query = 0;
+        glGenQueries(1, &query);
+        return query;
+    }
+
+    GLuint query = free_queries_.back();
+    free_queries_.pop_back();
+    return query;
+}
+
+int Profiler::BeginGpuScope(const char *name)
+{
+    if(!gpu_available_ || !frame_running_) {
+        return -1;
+    }
+
+    GpuFrame &gpu_frame = gpu_frames_[current_frame_.index % kGpuFrameLatency];
+    GpuScope scope {name, AcquireQuery(), AcquireQuery(), gpu_depth_++};
+    glQueryCounter(scope.begin_query, GL_TIMESTAMP);
+    gpu_frame.last_query = scope.begin_query;
+
+    gpu_frame.scopes.push_back(scope);
+    return static_cast<int>(gpu_frame.scopes.size() - 1);
+}
+
+void Profiler::EndGpuScope(int scope)
+{
+    if(scope < 0) {
+        return;
+    }
+
+    GpuFrame &gpu_frame = gpu_frames_[current_frame_.index % kGpuFrameLatency];
+    glQueryCounter(gpu_frame.scopes[scope].end_query, GL_TIMESTAMP);
+    gpu_frame.last_query = gpu_frame.scopes[scope].end_query;
+    gpu_depth_--;
+}
+
+ProfileScope::ProfileScope(const char *name) : name_(name), depth_(scope_depth++)
+{
+    begin_ns_ = Profiler::Instance()->Now();
+}
+
+ProfileScope::~ProfileScope()
+{
+    scope_depth--;
+    Profiler *profiler = Profiler::Instance();
+    profiler->RecordCpuEvent(name_, begin_ns_, profiler->Now(), depth_);
+}
@@ -0,0 +1,191 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <GL/gl3w.h>
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Closed scope on the profiler's clock. Names have to outlive the profiler,
+// scopes are meant to be named with string literals.
+struct ProfileEvent {
+    const char *name;
+    uint64_t begin_ns;
+    uint64_t end_ns;
+    // Index into the profiler's thread names, kGpuThread for GPU scopes
+    uint32_t thread;
+    // Number of enclosing scopes on the same thread
+    uint32_t depth;
+};
+
+// Events that closed between two BeginFrame calls. GPU events arrive a few
+// frames later, once their queries have results.
+struct ProfileFrame {
+    uint64_t index = 0;
+    uint64_t begin_ns = 0;
+    uint64_t end_ns = 0;
+    std::vector<ProfileEvent> cpu_events;
+    std::vector<ProfileEvent> gpu_events;
+    bool gpu_resolved = false;
+};
+
+using ProfileFrameListener = std::function<void(const ProfileFrame &)>;
+
+// Hierarchical frame profiler. CPU scopes can be opened on any thread; every
+// thread writes its closed scopes into its own single producer ring that the
+// context thread drains once per frame, so recording never takes a lock. GPU
+// scopes are timestamp queries that are read back kGpuFrameLatency frames
+// later, so the CPU never waits on them.
+// Frames, GPU scopes and the frame history belong to the context thread.
+class Profiler {
+private:
+    static Profiler *profiler_;
+
+public:
+    static constexpr uint32_t kGpuThread = UINT32_MAX;
+    static constexpr size_t kFrameHistory = 240;
+    static constexpr int kGpuFrameLatency = 3;
+
+    Profiler();
+    ~Profiler();
+
+    Profiler(Profiler &other) = delete;
+
+    void operator=(const Profiler &) = delete;
+
+    static Profiler *Instance();
+
+    // Nanoseconds since the profiler was created
+    uint64_t Now() const;
+
+    // Names the calling thread in the timeline
+    void SetThreadName(const std::string &name);
+    std::vector<std::string> GetThreadNames();
+
+    // Closes the running frame and starts the next one, call at the top of the main loop
+    void BeginFrame();
+    // Closes the running frame and finishes every pending one, waiting for
+    // the GPU. Meant for shutdown, the next BeginFrame starts over.
+    void Flush();
+
+    void RecordCpuEvent(const char *name, uint64_t begin_ns, uint64_t end_ns, uint32_t depth);
+
+    // Returns a handle for EndGpuScope, or -1 while GPU profiling is unavailable
+    int BeginGpuScope(const char *name);
+    void EndGpuScope(int scope);
+
+    // Called on the context thread for every finished frame, once its GPU
+    // events are in or kGpuFrameLatency frames have passed. Runs while paused.
+    void SetFrameListener(ProfileFrameListener listener);
+
+    // Finished frames, oldest first
+    const std::deque<ProfileFrame> &GetFrames() const { return frames_; };
+    // Events the full thread rings had to drop so far
+    uint64_t GetDroppedEventCount();
+
+    // Frames keep being drained but stop entering the history
+    bool paused_ = false;
+
+private:
+    static constexpr size_t kThreadRingCapacity = 8192;
+
+    // Written only by its thread, read only by the context thread
+    struct ThreadRing {
+        uint32_t index = 0;
+        std::array<ProfileEvent, kThreadRingCapacity> events;
+        std::atomic<uint64_t> write {0};
+        std::atomic<uint64_t> read {0};
+        std::atomic<uint64_t> dropped {0};
+    };
+
+    struct GpuScope {
+        const char *name;
+        GLuint begin_query;
+        GLuint end_query;
+        uint32_t depth;
+    };
+
+    // Scopes of one frame, together with a GPU/CPU clock pair taken at its start
+    struct GpuFrame {
+        uint64_t frame_index = 0;
+        int64_t gpu_sync_ns = 0;
+        uint64_t cpu_sync_ns = 0;
+        std::vector<GpuScope> scopes;
+        // Query issued last, scopes are ordered by begin so nested ones end before their parent
+        GLuint last_query = 0;
+    };
+
+    std::mutex threads_mutex_;
+    std::vector<std::unique_ptr<ThreadRing>> thread_rings_;
+    std::vector<std::string> thread_names_;
+
+    std::deque<ProfileFrame> frames_;
+    // Closed frames still waiting for their GPU events
+    std::deque<ProfileFrame> pending_frames_;
+    ProfileFrame current_frame_;
+    bool frame_running_ = false;
+    uint64_t next_frame_index_ = 0;
+
+    bool gpu_available_ = false;
+    std::array<GpuFrame, kGpuFrameLatency> gpu_frames_;
+    std::vector<GLuint> free_queries_;
+    uint32_t gpu_depth_ = 0;
+    uint64_t dropped_gpu_frames_ = 0;
+
+    ProfileFrameListener frame_listener_;
+
+    ThreadRing &GetThreadRing();
+    void DrainThreadRings(std::vector<ProfileEvent> &events);
+    void ResolveGpuFrame(GpuFrame &gpu_frame, bool wait = false);
+    void FinishFrame(ProfileFrame &frame);
+    GLuint AcquireQuery();
+};
+
+// Records the lifetime of the scope as a CPU event of the calling thread
+class ProfileScope {
+public:
+    explicit ProfileScope(const char *name);
+    ~ProfileScope();
+
+    ProfileScope(const ProfileScope &) = delete;
+    void operator=(const ProfileScope &) = delete;
+
+private:
+    const char *name_;
+    uint64_t begin_ns_;
+    uint32_t depth_;
+};
+
+// Brackets the GL commands issued during the scope with timestamp queries
+class GpuProfileScope {
+public:
+    explicit GpuProfileScope(const char *name) : scope_(Profiler::Instance()->BeginGpuScope(name)) {};
+    ~GpuProfileScope() { Profiler::Instance()->EndGpuScope(scope_); };
+
+    GpuProfileScope(const GpuProfileScope &) = delete;
+    void operator=(const GpuProfileScope &) = delete;
+
+private:
+    int scope_;
+};
+
+#define STEEL_PROFILE_CONCAT_INNER(a, b) a##b
+#define STEEL_PROFILE_CONCAT(a, b) STEEL_PROFILE_CONCAT_INNER(a, b)
+
+// Define STEEL_DISABLE_PROFILER to compile the scopes out
+#ifndef STEEL_DISABLE_PROFILER
+#define STEEL_PROFILE_SCOPE(name) ProfileScope STEEL_PROFILE_CONCAT(profile_scope_, __LINE__)(name)
+#define STEEL_PROFILE_GPU_SCOPE(name) GpuProfileScope STEEL_PROFILE_CONCAT(gpu_profile_scope_, __LINE__)(name)
+#else
+#define STEEL_PROFILE_SCOPE(name)
+#define STEEL_PROFILE_GPU_SCOPE(name)
+#endif
+
+#endif // PROFILER_H
@@ -7,6 +7,7 @@
 #include <iostream>
 
 #include "../ui/display.h"
+#include "../objects/camera_path.h"
 
 class Scene {
 public:
@@ -22,6 +23,10 @@ public:
     virtual void Update(float delta_time) {};
     virtual void LateUpdate(float delta_time) {};
     virtual void Draw(Display *window) {};
+
+    // Camera a scripted path drives in headless runs
+    virtual Camera *GetCamera() { return nullptr; };
+    virtual CameraPath GetBenchmarkPath() { return CameraPath(); };
 };
 
 #endif // SCENE_H
\ No newline at end of file
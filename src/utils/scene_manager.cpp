@@ -1,4 +1,5 @@
 #include "scene_manager.h"
+#include "profiler.h"
 
 SceneManager *SceneManager::scene_manager = nullptr;
 
@@ -22,6 +23,7 @@ void SceneManager::ProcessInput()
 
 void SceneManager::Update(float delta_time)
 {
+    STEEL_PROFILE_SCOPE("Update");
     if(curr_scene_) {
         curr_scene_->Update(delta_time);
     }
@@ -29,6 +31,7 @@ void SceneManager::Update(float delta_time)
 
 void SceneManager::LateUpdate(float delta_time)
 {
+    STEEL_PROFILE_SCOPE("Late Update");
     if(curr_scene_) {
         curr_scene_->LateUpdate(delta_time);
     }
@@ -36,6 +39,8 @@ void SceneManager::LateUpdate(float delta_time)
 
 void SceneManager::Draw(Display *display)
 {
+    STEEL_PROFILE_SCOPE("Draw");
+    STEEL_PROFILE_GPU_SCOPE("Draw");
     if(curr_scene_) {
         curr_scene_->Draw(display);
     }
@@ -34,6 +34,7 @@ public:
     void Add(std::string scene_name, std::shared_ptr<Scene> scene);
     void SwitchTo(std::string scene_name);
     void Remove(std::string scene_name);
+    std::shared_ptr<Scene> GetCurrentScene() { return curr_scene_; };
 
 private:
     std::unordered_map<std::string, std::shared_ptr<Scene>> scenes_;
@@ -1,11 +1,13 @@
 #include "shader.h"
 
+#include <algorithm>
 #include <array>
 #include <cassert>
+#include <cstdio>
+#include <cstring>
 #include <exception>
 #include <fstream>
 #include <iostream>
-#include <regex>
 #include <sstream>
 #include <string>
 #include <string_view>
@@ -14,6 +16,58 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+namespace {
+constexpr char kProgramBinaryMagic[4] = {'S', 'P', 'R', 'G'};
+// Bumped whenever the file layout or what goes into the key changes
+constexpr std::uint32_t kProgramBinaryVersion = 1;
+
+// Handed out to every created program, unlike GL ids they are never reused. Context thread only.
+std::uint64_t next_program_generation = 1;
+
+ShaderProgramHooks program_hooks;
+
+void ForgetProgram(GLuint program)
+{
+    if(program_hooks.forget_program)
+    {
+        program_hooks.forget_program(program);
+    }
+}
+
+struct ProgramBinaryHeader {
+    char magic[4];
+    std::uint32_t version;
+    std::uint64_t key;
+    std::uint32_t format;
+    std::uint32_t length;
+};
+
+// FNV-1a
+std::uint64_t HashBytes(const void *data, size_t size, std::uint64_t hash = 0xcbf29ce484222325ull)
+{
+    const auto *bytes = static_cast<const unsigned char *>(data);
+    for(size_t i = 0; i < size; i++)
+    {
+        hash = (hash ^ bytes[i]) * 0x100000001b3ull;
+    }
+    return hash;
+}
+
+std::uint64_t HashString(std::string_view value, std::uint64_t hash)
+{
+    // The length goes in too, so neighbouring strings can't trade characters
+    std::uint64_t length = value.size();
+    return HashBytes(value.data(), value.size(), HashBytes(&length, sizeof(length), hash));
+}
+
+bool SupportsProgramBinaries()
+{
+    GLint format_count {0};
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &format_count);
+    return format_count > 0;
+}
+}
+
 Shader::Shader(const std::string &shader_source_code, Type type) : shaderId_ {glCreateShader(ToUnderlying(type))}
 {
     const char *source_code_ptr = shader_source_code.c_str();
@@ -22,7 +76,16 @@ Shader::Shader(const std::string &shader_source_code, Type type) : shaderId_ {gl
     CheckShaderCompilation(shaderId_, ShaderTypename(type));
 }
 
-void CheckShaderCompilation(std::uint32_t shader_id, std::string_view shader_type)
+Shader::Shader(const ShaderSource &shader_source, Type type) : shaderId_ {glCreateShader(ToUnderlying(type))}
+{
+    const char *source_code_ptr = shader_source.code.c_str();
+    glShaderSource(shaderId_, 1, &source_code_ptr, nullptr);
+    glCompileShader(shaderId_);
+    CheckShaderCompilation(shaderId_, ShaderTypename(type), shader_source.files);
+}
+
+void CheckShaderCompilation(std::uint32_t shader_id, std::string_view shader_type,
+    const std::vector<std::filesystem::path> &source_files)
 {
     int compilation_successful = 0;
     glGetShaderiv(shader_id, GL_COMPILE_STATUS, &compilation_successful);
@@ -33,6 +96,10 @@ void CheckShaderCompilation(std::uint32_t shader_id, std::string_view shader_typ
         glGetShaderInfoLog(shader_id, static_cast<GLsizei>(error_log.size()), nullptr, error_log.data());
         std::stringstream stream;
         stream << shader_type << " Shader compilation error:\n" << error_log.data() << "\n";
+        for(size_t i = 0; i < source_files.size(); i++)
+        {
+            stream << "Source string " << i << ": " << source_files[i].string() << "\n";
+        }
         throw std::runtime_error(stream.str());
     }
 }
@@ -70,60 +137,258 @@ const std::string &Shader::ShaderTypename(Shader::Type type)
     return shader_types.at(type);
 }
 
+void ShaderProgram::SetHooks(const ShaderProgramHooks &hooks)
+{
+    program_hooks = hooks;
+}
+
 ShaderProgram::ShaderProgram(std::initializer_list<std::pair<std::string_view, Shader::Type>> initializer) :
-    programId_ {glCreateProgram()}
+    programId_ {glCreateProgram()}, generation_ {next_program_generation++}
 {
-    std::vector<Shader> shaders;
-    shaders.reserve(initializer.size());
+    std::vector<ShaderSource> sources;
+    sources.reserve(initializer.size());
     for(const auto &[filepath, shader_type] : initializer)
     {
-        shaders.emplace_back(LoadShaderFromFile(filepath, shader_type));
-        glAttachShader(programId_, shaders.back().ShaderId());
+        sources.emplace_back(LoadShaderSource(filepath));
     }
 
-    glLinkProgram(programId_);
-    CheckShaderProgramLinkStatus(programId_, initializer);
+    bool binaries_supported = SupportsProgramBinaries();
+    std::uint64_t binary_key = ProgramBinaryKey(initializer, sources);
+    std::filesystem::path binary_path = ProgramBinaryCachePath(initializer);
 
-    for(const auto &shader : shaders)
+    if(!binaries_supported || !LoadProgramBinary(binary_path, binary_key))
     {
-        glDetachShader(programId_, shader.ShaderId());
+        std::vector<Shader> shaders;
+        shaders.reserve(initializer.size());
+        size_t source_index = 0;
+        for(const auto &[filepath, shader_type] : initializer)
+        {
+            shaders.emplace_back(sources[source_index++], shader_type);
+            glAttachShader(programId_, shaders.back().ShaderId());
+        }
+
+        if(binaries_supported)
+        {
+            glProgramParameteri(programId_, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+        }
+        glLinkProgram(programId_);
+        CheckShaderProgramLinkStatus(programId_, initializer);
+
+        for(const auto &shader : shaders)
+        {
+            glDetachShader(programId_, shader.ShaderId());
+        }
+
+        if(binaries_supported)
+        {
+            SaveProgramBinary(binary_path, binary_key);
+        }
     }
+
+    RetrieveUniforms();
+    BindUniformBlocks();
 }
 
-Shader LoadShaderFromFile(std::string_view filepath, Shader::Type type)
+std::uint64_t ShaderProgram::ProgramBinaryKey(std::initializer_list<std::pair<std::string_view, Shader::Type>> shader_data,
+    const std::vector<ShaderSource> &sources)
+{
+    std::uint64_t hash = HashBytes(&kProgramBinaryVersion, sizeof(kProgramBinaryVersion));
+
+    // Binaries are only valid for the driver that produced them
+    for(GLenum driver_string : {GL_VENDOR, GL_RENDERER, GL_VERSION})
+    {
+        const char *value = reinterpret_cast<const char *>(glGetString(driver_string));
+        hash = HashString(value ? value : "", hash);
+    }
+
+    size_t source_index = 0;
+    for(const auto &[filepath, shader_type] : shader_data)
+    {
+        GLenum type = ToUnderlying(shader_type);
+        hash = HashBytes(&type, sizeof(type), hash);
+        hash = HashString(sources[source_index++].code, hash);
+    }
+    return hash;
+}
+
+std::filesystem::path ShaderProgram::ProgramBinaryCachePath(
+    std::initializer_list<std::pair<std::string_view, Shader::Type>> shader_data)
+{
+    // One file per combination of shader files, so edits overwrite it instead of piling up
+    std::uint64_t path_hash = HashBytes(nullptr, 0);
+    for(const auto &[filepath, shader_type] : shader_data)
+    {
+        path_hash = HashString(filepath, path_hash);
+    }
+
+    std::filesystem::path first_shader {shader_data.begin()->first};
+    std::array<char, 17> path_hash_hex {};
+    std::snprintf(path_hash_hex.data(), path_hash_hex.size(), "%016llx", static_cast<unsigned long long>(path_hash));
+    return first_shader.parent_path() / (first_shader.stem().string() + "." + path_hash_hex.data() + ".programcache");
+}
+
+bool ShaderProgram::LoadProgramBinary(const std::filesystem::path &binary_path, std::uint64_t key)
 {
-    std::ifstream shader_file {filepath.data()};
-    if(!shader_file.is_open())
+    std::ifstream file {binary_path, std::ios::binary};
+    if(!file.is_open())
+    {
+        return false;
+    }
+
+    ProgramBinaryHeader header {};
+    file.read(reinterpret_cast<char *>(&header), sizeof(header));
+    if(!file || std::memcmp(header.magic, kProgramBinaryMagic, sizeof(kProgramBinaryMagic)) != 0 ||
+        header.version != kProgramBinaryVersion || header.key != key || header.length == 0)
+    {
+        return false;
+    }
+
+    std::vector<char> binary(header.length);
+    file.read(binary.data(), static_cast<std::streamsize>(binary.size()));
+    if(!file)
+    {
+        return false;
+    }
+
+    glProgramBinary(programId_, header.format, binary.data(), static_cast<GLsizei>(binary.size()));
+
+    GLint linked {0};
+    glGetProgramiv(programId_, GL_LINK_STATUS, &linked);
+    if(!linked)
+    {
+        // Drivers may reject binaries of their older versions, start over with a fresh program
+        ForgetProgram(programId_);
+        glDeleteProgram(programId_);
+        programId_ = glCreateProgram();
+        generation_ = next_program_generation++;
+        return false;
+    }
+    return true;
+}
+
+void ShaderProgram::SaveProgramBinary(const std::filesystem::path &binary_path, std::uint64_t key)
+{
+    GLint length {0};
+    glGetProgramiv(programId_, GL_PROGRAM_BINARY_LENGTH, &length);
+    if(length <= 0)
+    {
+        return;
+    }
+
+    std::vector<char> binary(static_cast<size_t>(length));
+    GLenum format {0};
+    glGetProgramBinary(programId_, length, &length, &format, binary.data());
+
+    ProgramBinaryHeader header {};
+    std::memcpy(header.magic, kProgramBinaryMagic, sizeof(kProgramBinaryMagic));
+    header.version = kProgramBinaryVersion;
+    header.key = key;
+    header.format = format;
+    header.length = static_cast<std::uint32_t>(length);
+
+    // Written under a temporary name first, so a crash never leaves a truncated binary behind
+    std::filesystem::path temporary_path {binary_path};
+    temporary_path += ".tmp";
+    {
+        std::ofstream file {temporary_path, std::ios::binary | std::ios::trunc};
+        if(!file.is_open())
+        {
+            return;
+        }
+        file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        file.write(binary.data(), length);
+        if(!file.good())
+        {
+            file.close();
+            std::filesystem::remove(temporary_path);
+            return;
+        }
+    }
+
+    std::error_code error;
+    std::filesystem::rename(temporary_path, binary_path, error);
+    if(error)
     {
-        std::stringstream error_log_stream;
-        error_log_stream << "File " << filepath << " could not be opened";
-        throw std::runtime_error(error_log_stream.str());
+        std::filesystem::remove(temporary_path, error);
     }
+}
+
+void ShaderProgram::RetrieveUniforms()
+{
+    uniform_locations_.clear();
+
+    GLint uniform_count {0};
+    GLint max_name_length {0};
+    glGetProgramiv(programId_, GL_ACTIVE_UNIFORMS, &uniform_count);
+    glGetProgramiv(programId_, GL_ACTIVE_UNIFORM_MAX_LENGTH, &max_name_length);
+
+    std::vector<char> name_buffer(std::max(max_name_length, 1));
+    for(GLint i = 0; i < uniform_count; i++)
+    {
+        GLsizei name_length {0};
+        GLint size {0};
+        GLenum type {0};
+        glGetActiveUniform(programId_, static_cast<GLuint>(i), static_cast<GLsizei>(name_buffer.size()), &name_length,
+            &size, &type, name_buffer.data());
+
+        std::string name {name_buffer.data(), static_cast<size_t>(name_length)};
+        GLint location = glGetUniformLocation(programId_, name.c_str());
+        // Members of uniform blocks have no location
+        if(location < 0)
+        {
+            continue;
+        }
 
-    std::stringstream source_code_stream;
-    source_code_stream << shader_file.rdbuf();
-    return Shader {ProcessShaderInclude(source_code_stream.str(), std::filesystem::path{filepath}), type};
+        // Arrays are reported as "name[0]", make them reachable by their plain name too
+        if(name.size() > 3 && name.compare(name.size() - 3, 3, "[0]") == 0)
+        {
+            uniform_locations_.emplace(name.substr(0, name.size() - 3), location);
+        }
+        uniform_locations_.emplace(std::move(name), location);
+    }
 }
 
-std::string ProcessShaderInclude(std::string shader_source, std::filesystem::path shader_path)
+void ShaderProgram::BindUniformBlocks()
 {
-    std::string_view pattern = "#include ";
-    auto include_position = shader_source.find(pattern);
-    if(include_position != std::string::npos)
+    if(!program_hooks.uniform_block_binding)
+    {
+        return;
+    }
+
+    GLint block_count {0};
+    GLint max_name_length {0};
+    glGetProgramiv(programId_, GL_ACTIVE_UNIFORM_BLOCKS, &block_count);
+    glGetProgramiv(programId_, GL_ACTIVE_UNIFORM_BLOCK_MAX_NAME_LENGTH, &max_name_length);
+
+    std::vector<char> name_buffer(std::max(max_name_length, 1));
+    for(GLint i = 0; i < block_count; i++)
     {
-        auto file_name_start_pos = include_position + pattern.size();
-        auto end = shader_source.find('\n', file_name_start_pos);
-        std::string filename = shader_source.substr(file_name_start_pos, end - file_name_start_pos - 1);
-        std::filesystem::path include_path {shader_path.parent_path()};
-        include_path.append(filename);
-        std::ifstream shader_file {include_path};
-        std::stringstream source_code_stream;
-        source_code_stream << shader_file.rdbuf();
-        auto include_pattern = shader_source.substr(include_position, end - include_position);
-        return std::regex_replace(shader_source, std::regex(include_pattern), source_code_stream.str());
+        GLsizei name_length {0};
+        glGetActiveUniformBlockName(programId_, static_cast<GLuint>(i), static_cast<GLsizei>(name_buffer.size()),
+            &name_length, name_buffer.data());
+
+        GLuint binding {0};
+        if(program_hooks.uniform_block_binding(std::string_view {name_buffer.data(), static_cast<size_t>(name_length)}, binding))
+        {
+            glUniformBlockBinding(programId_, static_cast<GLuint>(i), binding);
+        }
     }
+}
+
+GLint ShaderProgram::GetUniformLocation(std::string_view uniform_name) const
+{
+    auto location = uniform_locations_.find(uniform_name);
+    return location != uniform_locations_.end() ? location->second : -1;
+}
 
-    return shader_source;
+Shader LoadShaderFromFile(std::string_view filepath, Shader::Type type)
+{
+    return Shader {LoadShaderSource(filepath), type};
+}
+
+ShaderSource LoadShaderSource(std::string_view filepath)
+{
+    return PreprocessShader(std::filesystem::path {filepath});
 }
 
 void CheckShaderProgramLinkStatus(std::uint32_t shader_program_id,
@@ -147,96 +412,166 @@ void CheckShaderProgramLinkStatus(std::uint32_t shader_program_id,
 }
 
 
-ShaderProgram::ShaderProgram(ShaderProgram &&other) noexcept : programId_ {other.programId_}
+ShaderProgram::ShaderProgram(ShaderProgram &&other) noexcept :
+    programId_ {other.programId_}, generation_ {other.generation_},
+    uniform_locations_ {std::move(other.uniform_locations_)}, sampler_units_ {std::move(other.sampler_units_)}
 {
     other.programId_ = 0;
+    other.generation_ = 0;
 }
 
 ShaderProgram &ShaderProgram::operator=(ShaderProgram &&other) noexcept
 {
     std::swap(programId_, other.programId_);
+    std::swap(generation_, other.generation_);
+    std::swap(uniform_locations_, other.uniform_locations_);
+    std::swap(sampler_units_, other.sampler_units_);
     return *this;
 }
 
 ShaderProgram::~ShaderProgram()
 {
+    ForgetProgram(programId_);
     glDeleteProgram(programId_);
 }
 
 void ShaderProgram::Use()
 {
-    glUseProgram(programId_);
+    if(program_hooks.use_program)
+    {
+        program_hooks.use_program(programId_);
+    }
+    else
+    {
+        glUseProgram(programId_);
+    }
 }
 
-void ShaderProgram::SetBoolUniform(const std::string &uniform_name, bool value)
+void ShaderProgram::SetSamplerUniform(GLint location, GLint unit)
 {
-    GLint location = glGetUniformLocation(programId_, uniform_name.c_str());
+    if(location < 0)
+    {
+        return;
+    }
+
+    auto [sampler, inserted] = sampler_units_.try_emplace(location, unit);
+    if(!inserted && sampler->second == unit)
+    {
+        return;
+    }
+    sampler->second = unit;
+    glProgramUniform1i(programId_, location, unit);
+}
+
+void ShaderProgram::SetBoolUniform(std::string_view uniform_name, bool value)
+{
+    GLint location = GetUniformLocation(uniform_name);
     glProgramUniform1i(programId_, location, static_cast<int>(value));
 }
 
-void ShaderProgram::SetIntUniform(const std::string &uniform_name, int value)
+void ShaderProgram::SetIntUniform(std::string_view uniform_name, int value)
 {
-    GLint location = glGetUniformLocation(programId_, uniform_name.c_str());
+    GLint location = GetUniformLocation(uniform_name);
     glProgramUniform1i(programId_, location, value);
 }
 
-void ShaderProgram::SetIntArrayUniform(const std::string &uniform_name, const int *value, GLsizei count)
+void ShaderProgram::SetIntArrayUniform(std::string_view uniform_name, const int *value, GLsizei count)
 {
-    GLint location = glGetUniformLocation(programId_, uniform_name.c_str());
+    GLint location = GetUniformLocation(uniform_name);
     glProgramUniform1iv(programId_, location, count, value);
 }
 
-void ShaderProgram::SetFloatUniform(const std::string &uniform_name, float value)
+void ShaderProgram::SetFloatUniform(std::string_view uniform_name, float value)
 {
-    GLint location = glGetUniformLocation(programId_, uniform_name.c_str());
+    GLint location = GetUniformLocation(uniform_name);
     glProgramUniform1f(programId_, location, value);
 }
 
-void ShaderProgram::SetFloatArrayUniform(const std::string &uniform_name, const float *value, GLsizei count)
+void ShaderProgram::SetFloatArrayUniform(std::string_view uniform_name, const float *value, GLsizei count)
 {
-    GLint location = glGetUniformLocation(programId_, uniform_name.c_str());
+    GLint location = GetUniformLocation(uniform_name);
     glProgramUniform1fv(programId_, location, count, value);
 }
 
-void ShaderProgram::SetVec2Uniform(const std::string &uniform_name, float x, float y)
+void ShaderProgram::SetVec2Uniform(std::string_view uniform_name, float x, float y)
 {
-    GLint location = glGetUniformLocation(programId_, uniform_name.c_str());
+    GLint location = GetUniformLocation(uniform_name);
     glProgramUniform2f(programId_, location, x, y);
 }
 
-void ShaderProgram::SetVec2Uniform(const std::string &uniform_name, const glm::vec2 &vector)
+void ShaderProgram::SetVec2Uniform(std::string_view uniform_name, const glm::vec2 &vector)
 {
-    GLint location = glGetUniformLocation(programId_, uniform_name.c_str());
+    GLint location = GetUniformLocation(uniform_name);
     glProgramUniform2fv(programId_, location, 1, glm::value_ptr(vector));
 }
 
-void ShaderProgram::SetVec2ArrayUniform(const std::string &uniform_name, const std::vector<glm::vec2> &value,
+void ShaderProgram::SetVec2ArrayUniform(std::string_view uniform_name, const std::vector<glm::vec2> &value,
     GLsizei count)
 {
-    GLint location = glGetUniformLocation(programId_, uniform_name.c_str());
+    GLint location = GetUniformLocation(uniform_name);
     glProgramUniform2fv(programId_, location, count, glm::value_ptr(value.front()));
 }
 
-void ShaderProgram::SetVec3Uniform(const std::string &uniform_name, float x, float y, float z)
+void ShaderProgram::SetVec3Uniform(std::string_view uniform_name, float x, float y, float z)
 {
-    GLint location = glGetUniformLocation(programId_, uniform_name.c_str());
+    GLint location = GetUniformLocation(uniform_name);
     glProgramUniform3f(programId_, location, x, y, z);
 }
 
-void ShaderProgram::SetVec3Uniform(const std::string &uniform_name, const glm::vec3 &vector)
+void ShaderProgram::SetVec3Uniform(std::string_view uniform_name, const glm::vec3 &vector)
+{
+    GLint location = GetUniformLocation(uniform_name);
+    glProgramUniform3fv(programId_, location, 1, glm::value_ptr(vector));
+}
+
+void ShaderProgram::SetVec4Uniform(std::string_view uniform_name, const glm::vec4 &vector)
+{
+    GLint location = GetUniformLocation(uniform_name);
+    glProgramUniform4fv(programId_, location, 1, glm::value_ptr(vector));
+}
+
+void ShaderProgram::SetMat4Uniform(std::string_view uniform_name, const glm::mat4 &matrix)
+{
+    GLint location = GetUniformLocation(uniform_name);
+    glProgramUniformMatrix4fv(programId_, location, 1, GL_FALSE, glm::value_ptr(matrix));
+}
+
+void ShaderProgram::SetBoolUniform(GLint location, bool value)
+{
+    glProgramUniform1i(programId_, location, static_cast<int>(value));
+}
+
+void ShaderProgram::SetIntUniform(GLint location, int value)
+{
+    glProgramUniform1i(programId_, location, value);
+}
+
+void ShaderProgram::SetFloatUniform(GLint location, float value)
+{
+    glProgramUniform1f(programId_, location, value);
+}
+
+void ShaderProgram::SetVec2Uniform(GLint location, float x, float y)
+{
+    glProgramUniform2f(programId_, location, x, y);
+}
+
+void ShaderProgram::SetVec2Uniform(GLint location, const glm::vec2 &vector)
+{
+    glProgramUniform2fv(programId_, location, 1, glm::value_ptr(vector));
+}
+
+void ShaderProgram::SetVec3Uniform(GLint location, const glm::vec3 &vector)
 {
-    GLint location = glGetUniformLocation(programId_, uniform_name.c_str());
     glProgramUniform3fv(programId_, location, 1, glm::value_ptr(vector));
 }
 
-void ShaderProgram::SetVec4Uniform(const std::string &uniform_name, const glm::vec4 &vector)
+void ShaderProgram::SetVec4Uniform(GLint location, const glm::vec4 &vector)
 {
-    GLint location = glGetUniformLocation(programId_, uniform_name.c_str());
     glProgramUniform4fv(programId_, location, 1, glm::value_ptr(vector));
 }
 
-void ShaderProgram::SetMat4Uniform(const std::string &uniform_name, const glm::mat4 &matrix)
+void ShaderProgram::SetMat4Uniform(GLint location, const glm::mat4 &matrix)
 {
-    GLint location = glGetUniformLocation(programId_, uniform_name.c_str());
     glProgramUniformMatrix4fv(programId_, location, 1, GL_FALSE, glm::value_ptr(matrix));
 }
\ No newline at end of file
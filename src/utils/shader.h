@@ -7,6 +7,8 @@
 #include <GL/gl3w.h>
 #include <GLFW/glfw3.h>
 
+#include "shader_preprocessor.h"
+
 #include <cstdint>
 #include <filesystem>
 #include <string>
@@ -29,6 +31,7 @@ public:
     };
 
     Shader(const std::string &shader_source_code, Type type);
+    Shader(const ShaderSource &shader_source, Type type);
     Shader(const Shader &) = delete;
     Shader(Shader &&shader) noexcept;
     Shader &operator=(const Shader &) = delete;
@@ -43,9 +46,24 @@ private:
     static const std::string &ShaderTypename(Type type);
 };
 
+// Lets the renderer track bound programs and bind shared uniform blocks
+// without utils depending on it. Unset hooks fall back to plain GL calls and
+// leave blocks at their default binding.
+struct ShaderProgramHooks
+{
+    void (*use_program)(GLuint program) = nullptr;
+    // Called before a program is deleted
+    void (*forget_program)(GLuint program) = nullptr;
+    // Binding point of a block name, false for blocks that aren't shared
+    bool (*uniform_block_binding)(std::string_view block_name, GLuint &binding) = nullptr;
+};
+
 class ShaderProgram
 {
 public:
+    // Has to be set before the first program is created
+    static void SetHooks(const ShaderProgramHooks &hooks);
+
     ShaderProgram() = default;
     explicit ShaderProgram(std::initializer_list<std::pair<std::string_view, Shader::Type>> initializer);
     ShaderProgram(const ShaderProgram &) = delete;
@@ -55,32 +73,80 @@ public:
     ~ShaderProgram();
 
     void Use();
-    void SetBoolUniform(const std::string &uniform_name, bool value);
-    void SetIntUniform(const std::string &uniform_name, int value);
-    void SetIntArrayUniform(const std::string &uniform_name, const int *value, GLsizei count);
-    void SetFloatUniform(const std::string &uniform_name, float value);
-    void SetFloatArrayUniform(const std::string &uniform_name, const float *value, GLsizei count);
-    void SetVec2Uniform(const std::string &uniform_name, float x, float y);
-    void SetVec2Uniform(const std::string &uniform_name, const glm::vec2 &vector);
-    void SetVec2ArrayUniform(const std::string &uniform_name, const std::vector<glm::vec2> &value, GLsizei count);
-    void SetVec3Uniform(const std::string &uniform_name, float x, float y, float z);
-    void SetVec3Uniform(const std::string &uniform_name, const glm::vec3 &vector);
-    void SetVec4Uniform(const std::string &uniform_name, const glm::vec4 &vector);
-    void SetMat4Uniform(const std::string &uniform_name, const glm::mat4 &transform);
+
+    // Locations of all active uniforms are looked up once at link time, -1 for
+    // names the program doesn't use. Resolve them up front on hot paths.
+    GLint GetUniformLocation(std::string_view uniform_name) const;
+
+    void SetBoolUniform(std::string_view uniform_name, bool value);
+    void SetIntUniform(std::string_view uniform_name, int value);
+    void SetIntArrayUniform(std::string_view uniform_name, const int *value, GLsizei count);
+    void SetFloatUniform(std::string_view uniform_name, float value);
+    void SetFloatArrayUniform(std::string_view uniform_name, const float *value, GLsizei count);
+    void SetVec2Uniform(std::string_view uniform_name, float x, float y);
+    void SetVec2Uniform(std::string_view uniform_name, const glm::vec2 &vector);
+    void SetVec2ArrayUniform(std::string_view uniform_name, const std::vector<glm::vec2> &value, GLsizei count);
+    void SetVec3Uniform(std::string_view uniform_name, float x, float y, float z);
+    void SetVec3Uniform(std::string_view uniform_name, const glm::vec3 &vector);
+    void SetVec4Uniform(std::string_view uniform_name, const glm::vec4 &vector);
+    void SetMat4Uniform(std::string_view uniform_name, const glm::mat4 &transform);
+
+    void SetBoolUniform(GLint location, bool value);
+    void SetIntUniform(GLint location, int value);
+    void SetFloatUniform(GLint location, float value);
+    void SetVec2Uniform(GLint location, float x, float y);
+    void SetVec2Uniform(GLint location, const glm::vec2 &vector);
+    void SetVec3Uniform(GLint location, const glm::vec3 &vector);
+    void SetVec4Uniform(GLint location, const glm::vec4 &vector);
+    void SetMat4Uniform(GLint location, const glm::mat4 &transform);
+
+    // Skips the upload when the sampler already reads from unit
+    void SetSamplerUniform(GLint location, GLint unit);
+
     std::uint32_t programId_ {0};
 
+    // Changes whenever the object gets a new GL program. Unlike programId_ it
+    // is never reused, so caches keyed on it can't mix up programs.
+    std::uint64_t GetGeneration() const { return generation_; }
+
 private:
-    std::unordered_map<std::string, std::uint32_t> uniform_locations_ {};
+    std::uint64_t generation_ {0};
+
+    // Transparent, so lookups by string_view don't allocate
+    struct UniformNameHash
+    {
+        using is_transparent = void;
+        size_t operator()(std::string_view name) const { return std::hash<std::string_view> {}(name); }
+    };
+
+    std::unordered_map<std::string, GLint, UniformNameHash, std::equal_to<>> uniform_locations_ {};
+    // Texture unit last set on each sampler location
+    std::unordered_map<GLint, GLint> sampler_units_ {};
 
     void RetrieveUniforms();
+    // Binds the shared blocks the program uses to their fixed binding points
+    void BindUniformBlocks();
+
+    // Linked programs are kept on disk with glGetProgramBinary, keyed by the
+    // preprocessed sources and the driver. Binaries the driver rejects fall
+    // back to compiling.
+    static std::uint64_t ProgramBinaryKey(std::initializer_list<std::pair<std::string_view, Shader::Type>> shader_data,
+        const std::vector<ShaderSource> &sources);
+    static std::filesystem::path ProgramBinaryCachePath(
+        std::initializer_list<std::pair<std::string_view, Shader::Type>> shader_data);
+    bool LoadProgramBinary(const std::filesystem::path &binary_path, std::uint64_t key);
+    void SaveProgramBinary(const std::filesystem::path &binary_path, std::uint64_t key);
 };
 
 // Auxiliary free functions
-void CheckShaderCompilation(std::uint32_t shader_id, std::string_view shader_type);
+// Errors list the files behind the source string numbers of the #line directives
+void CheckShaderCompilation(std::uint32_t shader_id, std::string_view shader_type,
+    const std::vector<std::filesystem::path> &source_files = {});
 Shader LoadShaderFromFile(std::string_view filepath, Shader::Type type);
+// Reads a shader file and resolves its includes
+ShaderSource LoadShaderSource(std::string_view filepath);
 void CheckShaderProgramLinkStatus(std::uint32_t shader_program_id,
     std::initializer_list<std::pair<std::string_view, Shader::Type>> shader_data);
-std::string ProcessShaderInclude(std::string shader_source, std::filesystem::path shader_path);
 
 template <typename T>
 constexpr std::underlying_type_t<T> ToUnderlying(T enumerator) noexcept
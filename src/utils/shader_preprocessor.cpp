@@ -0,0 +1,300 @@
+#include "shader_preprocessor.h"
+
+#include <algorithm>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace {
+struct SourceFile
+{
+    std::filesystem::file_time_type write_time;
+    std::string contents;
+    // Macro of an #ifndef guard wrapping the whole file, empty if there is none
+    std::string guard;
+};
+
+struct Directive
+{
+    std::string_view name;
+    std::string_view argument;
+};
+
+std::string_view Trim(std::string_view text)
+{
+    size_t start = text.find_first_not_of(" \t\r");
+    if(start == std::string_view::npos)
+    {
+        return {};
+    }
+    size_t end = text.find_last_not_of(" \t\r");
+    return text.substr(start, end - start + 1);
+}
+
+// First word of a directive argument
+std::string_view FirstWord(std::string_view text)
+{
+    return text.substr(0, text.find_first_of(" \t"));
+}
+
+// Takes the line up to the next newline off the front of text
+std::string_view NextLine(std::string_view &text)
+{
+    size_t line_end = text.find('\n');
+    std::string_view line = text.substr(0, line_end);
+    text.remove_prefix(line_end == std::string_view::npos ? text.size() : line_end + 1);
+    return line;
+}
+
+// Splits "# name argument" lines, false for lines that aren't directives
+bool ParseDirective(std::string_view line, Directive &directive)
+{
+    line = Trim(line);
+    if(line.empty() || line.front() != '#')
+    {
+        return false;
+    }
+
+    line = Trim(line.substr(1));
+    size_t name_end = line.find_first_of(" \t");
+    directive.name = line.substr(0, name_end);
+    directive.argument = name_end == std::string_view::npos ? std::string_view {} : Trim(line.substr(name_end));
+    return true;
+}
+
+// Only comment lines and directives may come before and after the guard
+std::string FindIncludeGuard(std::string_view contents)
+{
+    std::string_view guard;
+    bool guard_defined = false;
+    bool guard_closed = false;
+    int depth = 0;
+
+    while(!contents.empty())
+    {
+        std::string_view line = NextLine(contents);
+
+        Directive directive;
+        if(!ParseDirective(line, directive))
+        {
+            std::string_view code = Trim(line);
+            if(depth == 0 && !code.empty() && !code.starts_with("//"))
+            {
+                return {};
+            }
+            continue;
+        }
+
+        if(guard_closed)
+        {
+            return {};
+        }
+
+        if(guard.empty())
+        {
+            if(directive.name != "ifndef")
+            {
+                return {};
+            }
+            guard = FirstWord(directive.argument);
+            depth = 1;
+        }
+        else if(!guard_defined)
+        {
+            if(directive.name != "define" || FirstWord(directive.argument) != guard)
+            {
+                return {};
+            }
+            guard_defined = true;
+        }
+        else if(directive.name == "if" || directive.name == "ifdef" || directive.name == "ifndef")
+        {
+            depth++;
+        }
+        else if(directive.name == "endif" && --depth == 0)
+        {
+            guard_closed = true;
+        }
+    }
+
+    return guard_closed ? std::string {guard} : std::string {};
+}
+
+// Files are read again only once their write time changes
+std::shared_ptr<const SourceFile> ReadSourceFile(const std::filesystem::path &path)
+{
+    static std::mutex cache_mutex;
+    static std::unordered_map<std::string, std::shared_ptr<const SourceFile>> cache;
+
+    std::error_code error;
+    std::filesystem::file_time_type write_time = std::filesystem::last_write_time(path, error);
+    if(error)
+    {
+        std::stringstream error_log_stream;
+        error_log_stream << "File " << path.string() << " could not be opened";
+        throw std::runtime_error(error_log_stream.str());
+    }
+
+    std::lock_guard<std::mutex> lock(cache_mutex);
+    auto cached = cache.find(path.string());
+    if(cached != cache.end() && cached->second->write_time == write_time)
+    {
+        return cached->second;
+    }
+
+    std::ifstream file {path, std::ios::binary};
+    if(!file.is_open())
+    {
+        std::stringstream error_log_stream;
+        error_log_stream << "File " << path.string() << " could not be opened";
+        throw std::runtime_error(error_log_stream.str());
+    }
+
+    std::stringstream contents_stream;
+    contents_stream << file.rdbuf();
+
+    auto source = std::make_shared<SourceFile>();
+    source->write_time = write_time;
+    source->contents = contents_stream.str();
+    source->guard = FindIncludeGuard(source->contents);
+
+    cache[path.string()] = source;
+    return source;
+}
+
+class Preprocessor
+{
+public:
+    ShaderSource Run(const std::filesystem::path &shader_path)
+    {
+        Append(std::filesystem::weakly_canonical(shader_path));
+        return std::move(output_);
+    }
+
+private:
+    ShaderSource output_;
+    std::vector<std::filesystem::path> include_stack_;
+    std::unordered_set<std::string> once_files_;
+    std::unordered_set<std::string> defined_guards_;
+
+    void Append(const std::filesystem::path &path)
+    {
+        std::shared_ptr<const SourceFile> file = ReadSourceFile(path);
+        if(!file->guard.empty())
+        {
+            defined_guards_.insert(file->guard);
+        }
+
+        std::string file_index = std::to_string(output_.files.size());
+        bool root = output_.files.empty();
+        output_.files.push_back(path);
+        include_stack_.push_back(path);
+
+        std::string &code = output_.code;
+        if(!root)
+        {
+            code += "#line 1 " + file_index + "\n";
+        }
+
+        std::string_view contents = file->contents;
+        int line_number = 0;
+        while(!contents.empty())
+        {
+            std::string_view line = NextLine(contents);
+            line_number++;
+
+            Directive directive;
+            if(!ParseDirective(line, directive))
+            {
+                code += line;
+                code += '\n';
+            }
+            else if(directive.name == "include")
+            {
+                // Skipped includes leave a blank line, so the numbering stays intact
+                if(Include(ResolveInclude(path, directive.argument, line_number)))
+                {
+                    code += "#line " + std::to_string(line_number + 1) + " " + file_index + "\n";
+                }
+                else
+                {
+                    code += '\n';
+                }
+            }
+            else if(directive.name == "pragma" && FirstWord(directive.argument) == "once")
+            {
+                once_files_.insert(path.string());
+                code += '\n';
+            }
+            else if(directive.name == "version" && !root)
+            {
+                // Only the root file may declare the version
+                code += '\n';
+            }
+            else
+            {
+                code += line;
+                code += '\n';
+            }
+        }
+
+        include_stack_.pop_back();
+    }
+
+    // Returns false for files that are already included and guarded
+    bool Include(const std::filesystem::path &path)
+    {
+        if(once_files_.count(path.string()))
+        {
+            return false;
+        }
+
+        std::shared_ptr<const SourceFile> file = ReadSourceFile(path);
+        if(!file->guard.empty() && defined_guards_.count(file->guard))
+        {
+            return false;
+        }
+
+        if(std::find(include_stack_.begin(), include_stack_.end(), path) != include_stack_.end())
+        {
+            std::stringstream error_log_stream;
+            error_log_stream << "Recursive shader include of " << path.string() << " from:";
+            for(const std::filesystem::path &including_path : include_stack_)
+            {
+                error_log_stream << "\n    " << including_path.string();
+            }
+            throw std::runtime_error(error_log_stream.str());
+        }
+
+        Append(path);
+        return true;
+    }
+
+    static std::filesystem::path ResolveInclude(const std::filesystem::path &including_path, std::string_view argument,
+        int line_number)
+    {
+        bool quoted = argument.size() > 2 &&
+            ((argument.front() == '"' && argument.back() == '"') || (argument.front() == '<' && argument.back() == '>'));
+        if(!quoted)
+        {
+            std::stringstream error_log_stream;
+            error_log_stream << "Malformed #include in " << including_path.string() << ":" << line_number;
+            throw std::runtime_error(error_log_stream.str());
+        }
+
+        std::filesystem::path include_path {including_path.parent_path()};
+        include_path /= std::string {argument.substr(1, argument.size() - 2)};
+        return std::filesystem::weakly_canonical(include_path);
+    }
+};
+}
+
+ShaderSource PreprocessShader(const std::filesystem::path &shader_path)
+{
+    return Preprocessor {}.Run(shader_path);
+}
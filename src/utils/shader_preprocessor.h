@@ -0,0 +1,24 @@
+#ifndef SHADER_PREPROCESSOR_H
+#define SHADER_PREPROCESSOR_H
+
+#include <filesystem>
+#include <string>
+#include <vector>
+
+// Shader code with its includes resolved
+struct ShaderSource {
+    std::string code;
+    // Files by the source string number of the #line directives, the root file is 0
+    std::vector<std::filesystem::path> files;
+};
+
+// Resolves the #include "file" directives of a shader in a single pass over
+// each line. Includes nest, are relative to the including file and are
+// skipped when they were already included under #pragma once or a classic
+// #ifndef guard. Every include is followed by a #line directive, so compile
+// errors point at the original file and line. Files are read once and kept
+// in memory until they change on disk.
+// Throws std::runtime_error on missing files and include cycles.
+ShaderSource PreprocessShader(const std::filesystem::path &shader_path);
+
+#endif // SHADER_PREPROCESSOR_H
@@ -0,0 +1,199 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+
+ThreadPool *ThreadPool::thread_pool_ = nullptr;
+ThreadPoolWorkerHook ThreadPool::worker_start_hook_;
+
+namespace {
+// Index of the worker running on this thread, -1 on threads outside the pool
+thread_local int current_worker_index = -1;
+thread_local const ThreadPool *current_worker_pool = nullptr;
+}
+
+ThreadPool::ThreadPool(unsigned thread_count)
+{
+    if(thread_count == 0) {
+        // hardware_concurrency may be 0 when it can't be determined
+        unsigned hardware_threads = std::thread::hardware_concurrency();
+        thread_count = hardware_threads > 1 ? hardware_threads - 1 : 1;
+    }
+
+    for(unsigned i = 0; i < thread_count; i++) {
+        queues_.push_back(std::make_unique<WorkQueue>());
+    }
+
+    for(unsigned i = 0; i < thread_count; i++) {
+        workers_.emplace_back([this, i] () { WorkerLoop(i); });
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(wake_mutex_);
+        stopping_ = true;
+    }
+    wake_condition_.notify_all();
+
+    for(std::thread &worker : workers_) {
+        worker.join();
+    }
+}
+
+ThreadPool *ThreadPool::Instance()
+{
+    if(!thread_pool_) thread_pool_ = new ThreadPool();
+    return thread_pool_;
+}
+
+void ThreadPool::SetWorkerStartHook(ThreadPoolWorkerHook hook)
+{
+    worker_start_hook_ = std::move(hook);
+}
+
+void ThreadPool::Submit(ThreadPoolJob job)
+{
+    unsigned queue_index;
+    if(current_worker_pool == this) {
+        queue_index = current_worker_index;
+    } else {
+        queue_index = next_queue_.fetch_add(1, std::memory_order_relaxed) % queues_.size();
+    }
+
+    unfinished_jobs_.fetch_add(1);
+    {
+        std::lock_guard<std::mutex> lock(queues_[queue_index]->mutex);
+        queues_[queue_index]->jobs.push_back(std::move(job));
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(wake_mutex_);
+        queued_jobs_.fetch_add(1);
+    }
+    wake_condition_.notify_one();
+}
+
+void ThreadPool::WaitIdle()
+{
+    std::unique_lock<std::mutex> lock(wake_mutex_);
+    idle_condition_.wait(lock, [this] () { return unfinished_jobs_.load() == 0; });
+}
+
+void ThreadPool::ParallelFor(int count, int grain, const std::function<void(int, int)> &function)
+{
+    grain = std::max(1, grain);
+    int range_count = (count + grain - 1) / grain;
+    if(range_count <= 1) {
+        if(count > 0) function(0, count);
+        return;
+    }
+
+    // Helpers may only get to run after the call returned, so they share the state
+    struct ParallelForState {
+        std::function<void(int, int)> function;
+        int count;
+        int grain;
+        std::atomic<int> next_range {0};
+        std::atomic<int> unfinished_ranges;
+        std::mutex mutex;
+        std::condition_variable finished;
+    };
+
+    auto state = std::make_shared<ParallelForState>();
+    state->function = function;
+    state->count = count;
+    state->grain = grain;
+    state->unfinished_ranges = range_count;
+
+    auto run_ranges = [] (ParallelForState &state) {
+        int range;
+        while((range = state.next_range.fetch_add(1)) * state.grain < state.count) {
+            int begin = range * state.grain;
+            state.function(begin, std::min(begin + state.grain, state.count));
+
+            if(state.unfinished_ranges.fetch_sub(1) == 1) {
+                std::lock_guard<std::mutex> lock(state.mutex);
+                state.finished.notify_all();
+            }
+        }
+    };
+
+    unsigned helper_count = std::min<unsigned>(GetThreadCount(), range_count - 1);
+    for(unsigned i = 0; i < helper_count; i++) {
+        Submit([state, run_ranges] () { run_ranges(*state); });
+    }
+
+    run_ranges(*state);
+
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->finished.wait(lock, [&state] () { return state->unfinished_ranges.load() == 0; });
+}
+
+unsigned ThreadPool::GetThreadCount() const
+{
+    return static_cast<unsigned>(workers_.size());
+}
+
+void ThreadPool::WorkerLoop(unsigned index)
+{
+    current_worker_index = static_cast<int>(index);
+    current_worker_pool = this;
+    if(worker_start_hook_) {
+        worker_start_hook_(index);
+    }
+
+    while(true) {
+        ThreadPoolJob job;
+
+        if(TryPop(index, job) || TrySteal(index, job)) {
+            queued_jobs_.fetch_sub(1);
+            job();
+
+            if(unfinished_jobs_.fetch_sub(1) == 1) {
+                std::lock_guard<std::mutex> lock(wake_mutex_);
+                idle_condition_.notify_all();
+            }
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(wake_mutex_);
+        wake_condition_.wait(lock, [this] () { return stopping_ || queued_jobs_.load() > 0; });
+
+        if(stopping_ && queued_jobs_.load() == 0) {
+            return;
+        }
+    }
+}
+
+bool ThreadPool::TryPop(unsigned index, ThreadPoolJob &job)
+{
+    WorkQueue &queue = *queues_[index];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+
+    if(queue.jobs.empty()) {
+        return false;
+    }
+
+    job = std::move(queue.jobs.back());
+    queue.jobs.pop_back();
+    return true;
+}
+
+bool ThreadPool::TrySteal(unsigned index, ThreadPoolJob &job)
+{
+    for(size_t offset = 1; offset < queues_.size(); offset++) {
+        WorkQueue &queue = *queues_[(index + offset) % queues_.size()];
+        std::unique_lock<std::mutex> lock(queue.mutex, std::try_to_lock);
+
+        if(!lock.owns_lock() || queue.jobs.empty()) {
+            continue;
+        }
+
+        job = std::move(queue.jobs.front());
+        queue.jobs.pop_front();
+        return true;
+    }
+
+    return false;
+}
@@ -0,0 +1,76 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using ThreadPoolJob = std::function<void()>;
+// Receives the index of the worker it runs on
+using ThreadPoolWorkerHook = std::function<void(unsigned)>;
+
+// Work-stealing thread pool. Every worker owns a queue; jobs submitted from a
+// worker go to its own queue and are popped LIFO, idle workers steal FIFO
+// from the others.
+class ThreadPool {
+private:
+    static ThreadPool *thread_pool_;
+    static ThreadPoolWorkerHook worker_start_hook_;
+
+public:
+    // thread_count 0 uses all hardware threads but one, which is left to the render thread
+    explicit ThreadPool(unsigned thread_count = 0);
+    ~ThreadPool();
+
+    ThreadPool(ThreadPool &other) = delete;
+
+    void operator=(const ThreadPool &) = delete;
+
+    static ThreadPool *Instance();
+
+    // Runs on every worker thread as it starts, e.g. to name it for the profiler.
+    // Only workers started after it is set call it, so set it before the first Instance().
+    static void SetWorkerStartHook(ThreadPoolWorkerHook hook);
+
+    void Submit(ThreadPoolJob job);
+
+    // Blocks until every submitted job has finished
+    void WaitIdle();
+
+    // Calls function(begin, end) for consecutive ranges of at most grain items
+    // covering [0, count), on the workers and the calling thread. Returns once
+    // every range has run, without waiting for unrelated jobs.
+    void ParallelFor(int count, int grain, const std::function<void(int, int)> &function);
+
+    unsigned GetThreadCount() const;
+
+private:
+    struct WorkQueue {
+        std::mutex mutex;
+        std::deque<ThreadPoolJob> jobs;
+    };
+
+    std::vector<std::unique_ptr<WorkQueue>> queues_;
+    std::vector<std::thread> workers_;
+
+    std::mutex wake_mutex_;
+    std::condition_variable wake_condition_;
+    std::condition_variable idle_condition_;
+
+    std::atomic<size_t> queued_jobs_ {0};
+    std::atomic<size_t> unfinished_jobs_ {0};
+    std::atomic<unsigned> next_queue_ {0};
+    bool stopping_ = false;
+
+    void WorkerLoop(unsigned index);
+    bool TryPop(unsigned index, ThreadPoolJob &job);
+    bool TrySteal(unsigned index, ThreadPoolJob &job);
+};
+
+#endif // THREAD_POOL_H
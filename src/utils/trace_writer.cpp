@@ -0,0 +1,180 @@
+#include "trace_writer.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+
+namespace {
+// Track ids in the trace, profiler thread i becomes kFirstThreadTrack + i
+const uint32_t kFrameTrack = 0;
+const uint32_t kGpuTrack = 1;
+const uint32_t kFirstThreadTrack = 2;
+
+const size_t kFlushBytes = 1 << 16;
+
+uint32_t TrackId(uint32_t thread)
+{
+    return thread == Profiler::kGpuThread ? kGpuTrack : kFirstThreadTrack + thread;
+}
+
+void AppendEscaped(std::string &buffer, const char *text)
+{
+    for(const char *c = text; *c; c++) {
+        if(*c == '"' || *c == '\\') {
+            buffer += '\\';
+            buffer += *c;
+        } else if(static_cast<unsigned char>(*c) < 0x20) {
+            char escaped[8];
+            std::snprintf(escaped, sizeof(escaped), "\\u%04x", static_cast<unsigned>(*c));
+            buffer += escaped;
+        } else {
+            buffer += *c;
+        }
+    }
+}
+}
+
+TraceWriter::TraceWriter(const std::filesystem::path &path, size_t max_queued_frames)
+    : file_(path, std::ios::binary | std::ios::trunc), ring_(std::max<size_t>(max_queued_frames, 1))
+{
+    if(!file_) {
+        std::cout << "Failed to open trace file: " << path.string() << std::endl;
+        return;
+    }
+
+    buffer_ = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    writer_ = std::thread([this] () { WriterLoop(); });
+}
+
+TraceWriter::~TraceWriter()
+{
+    if(!writer_.joinable()) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    wake_condition_.notify_one();
+    writer_.join();
+
+    // Names are written last, threads may have been renamed while recording
+    WriteThreadName(kFrameTrack, "Frames");
+    WriteThreadName(kGpuTrack, "GPU");
+    std::vector<std::string> thread_names = Profiler::Instance()->GetThreadNames();
+    for(uint32_t i = 0; i < thread_names.size(); i++) {
+        WriteThreadName(kFirstThreadTrack + i, thread_names[i]);
+    }
+
+    buffer_ += "]}\n";
+    file_.write(buffer_.data(), buffer_.size());
+    file_.close();
+
+    if(dropped_frames_ > 0) {
+        std::cout << "Trace writer fell behind and dropped " << dropped_frames_ << " frames" << std::endl;
+    }
+}
+
+void TraceWriter::Submit(const ProfileFrame &frame)
+{
+    if(!writer_.joinable()) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if(ring_count_ == ring_.size()) {
+            dropped_frames_++;
+            return;
+        }
+
+        ProfileFrame &slot = ring_[(ring_begin_ + ring_count_) % ring_.size()];
+        slot.index = frame.index;
+        slot.begin_ns = frame.begin_ns;
+        slot.end_ns = frame.end_ns;
+        slot.cpu_events.assign(frame.cpu_events.begin(), frame.cpu_events.end());
+        slot.gpu_events.assign(frame.gpu_events.begin(), frame.gpu_events.end());
+        slot.gpu_resolved = frame.gpu_resolved;
+        ring_count_++;
+    }
+    wake_condition_.notify_one();
+}
+
+uint64_t TraceWriter::GetDroppedFrameCount()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return dropped_frames_;
+}
+
+void TraceWriter::WriterLoop()
+{
+    ProfileFrame frame;
+
+    while(true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            wake_condition_.wait(lock, [this] () { return stopping_ || ring_count_ > 0; });
+
+            if(ring_count_ == 0) {
+                return;
+            }
+
+            // Swapping hands the slot the buffers of the previously written frame
+            std::swap(frame, ring_[ring_begin_]);
+            ring_begin_ = (ring_begin_ + 1) % ring_.size();
+            ring_count_--;
+        }
+
+        WriteFrame(frame);
+        if(buffer_.size() >= kFlushBytes) {
+            file_.write(buffer_.data(), buffer_.size());
+            buffer_.clear();
+        }
+    }
+}
+
+void TraceWriter::WriteFrame(const ProfileFrame &frame)
+{
+    std::string frame_name = "Frame " + std::to_string(frame.index);
+    WriteEvent(frame_name.c_str(), "frame", frame.begin_ns, frame.end_ns, kFrameTrack);
+
+    for(const ProfileEvent &event : frame.cpu_events) {
+        WriteEvent(event.name, "cpu", event.begin_ns, event.end_ns, TrackId(event.thread));
+    }
+    for(const ProfileEvent &event : frame.gpu_events) {
+        WriteEvent(event.name, "gpu", event.begin_ns, event.end_ns, kGpuTrack);
+    }
+}
+
+void TraceWriter::WriteEvent(const char *name, const char *category, uint64_t begin_ns, uint64_t end_ns, uint32_t thread)
+{
+    // Complete events, timestamps in microseconds
+    char numbers[128];
+    std::snprintf(numbers, sizeof(numbers), "\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%u}",
+                  begin_ns / 1000.0, (std::max(end_ns, begin_ns) - begin_ns) / 1000.0, thread);
+
+    BeginEvent();
+    buffer_ += "{\"cat\":\"";
+    buffer_ += category;
+    buffer_ += "\",\"name\":\"";
+    AppendEscaped(buffer_, name);
+    buffer_ += numbers;
+}
+
+void TraceWriter::WriteThreadName(uint32_t thread, const std::string &name)
+{
+    BeginEvent();
+    buffer_ += "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" + std::to_string(thread) + ",\"args\":{\"name\":\"";
+    AppendEscaped(buffer_, name.c_str());
+    buffer_ += "\"}}";
+}
+
+void TraceWriter::BeginEvent()
+{
+    if(!first_event_) {
+        buffer_ += ',';
+    }
+    first_event_ = false;
+    buffer_ += '\n';
+}
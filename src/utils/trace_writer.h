@@ -0,0 +1,60 @@
+#ifndef TRACE_WRITER_H
+#define TRACE_WRITER_H
+
+#include "profiler.h"
+
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Streams profiler frames to a Chrome Trace Event JSON file, which opens in
+// chrome://tracing and ui.perfetto.dev. Frames are copied into a fixed ring
+// and serialized on a background thread; when the writer falls more than
+// the ring behind, new frames are dropped instead of growing memory.
+class TraceWriter {
+public:
+    explicit TraceWriter(const std::filesystem::path &path, size_t max_queued_frames = 256);
+    // Writes the queued frames and the thread names, then closes the file
+    ~TraceWriter();
+
+    TraceWriter(TraceWriter &other) = delete;
+
+    void operator=(const TraceWriter &) = delete;
+
+    bool IsOpen() const { return file_.is_open(); };
+
+    // Call from the profiler's frame listener
+    void Submit(const ProfileFrame &frame);
+
+    uint64_t GetDroppedFrameCount();
+
+private:
+    std::ofstream file_;
+    std::thread writer_;
+
+    std::mutex mutex_;
+    std::condition_variable wake_condition_;
+    // Slots are reused, their event vectors keep their capacity between frames
+    std::vector<ProfileFrame> ring_;
+    size_t ring_begin_ = 0;
+    size_t ring_count_ = 0;
+    uint64_t dropped_frames_ = 0;
+    bool stopping_ = false;
+
+    // Only touched by the writer thread
+    std::string buffer_;
+    bool first_event_ = true;
+
+    void WriterLoop();
+    void WriteFrame(const ProfileFrame &frame);
+    void WriteEvent(const char *name, const char *category, uint64_t begin_ns, uint64_t end_ns, uint32_t thread);
+    void WriteThreadName(uint32_t thread, const std::string &name);
+    void BeginEvent();
+};
+
+#endif // TRACE_WRITER_H